@@ -100,8 +100,10 @@ then
       if [ ! $(grep "dtoverlay=microlynx-mipi" $CONFIG_FILE) ]
       then
          echo "# Uncomment the following line to enable Microlynx camera." | sudo tee -a $CONFIG_FILE
-         echo "# Use line-height=128 for setting line height, minimum is 16 lines." | sudo tee -a $CONFIG_FILE
+         echo "# Use line-height=128 for setting the initial line height (16 to 4096 lines, can be changed at runtime with set_fmt)." | sudo tee -a $CONFIG_FILE
          echo "#dtoverlay=microlynx-mipi,line-height=128" | sudo tee -a $CONFIG_FILE
+         echo "# Acquisition stop/start at stream-on: acq-restart=0 auto (RPi5 only), 1 always, 2 never." | sudo tee -a $CONFIG_FILE
+         echo "#dtparam=acq-restart=0" | sudo tee -a $CONFIG_FILE
       fi
 
    # Install rootfs scripts
@@ -0,0 +1,188 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * camctl-bench - register access throughput of a Dione or Microlynx camera.
+ *
+ * Reads (or reads and writes back) a register COUNT times through libcamctl,
+ * for each batch depth given, and reports registers/s, the time per register
+ * and how often the camera was not ready.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "camctl.h"
+#include "microlynx_regs.h"
+
+/* Image width, readable at any time */
+#define DIONE_REG_WIDTH     0x20001004
+
+static const struct {
+   const char *name;
+   enum camctl_type type;
+} types[] = {
+   { "dione",         CAMCTL_DIONE },
+   { "dione-gencp",   CAMCTL_DIONE_GENCP },
+   { "microlynx-i2c", CAMCTL_MICROLYNX_I2C },
+   { "microlynx",     CAMCTL_MICROLYNX },
+};
+#define NUM_TYPES (sizeof(types) / sizeof(types[0]))
+
+static double now_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: camctl-bench [-t TYPE] [-b I2C_BUS] [-a I2C_ADDR] [-d DEVICE] [-r REG]\n"
+      "                    [-n COUNT] [-D DEPTH[,DEPTH...]] [-w] [-T TIMEOUT_MS]\n"
+      "  -t TYPE     dione, dione-gencp, microlynx-i2c or microlynx (chardev, default)\n"
+      "  -b I2C_BUS  I2C bus of the I2C types (default: 9)\n"
+      "  -a I2C_ADDR camera I2C address (default: 0x5b Dione, 0x51 Microlynx)\n"
+      "  -d DEVICE   microlynx chardev (default: first /dev/microlynx-*)\n"
+      "  -r REG      register used (default: image width / firmware version)\n"
+      "  -n COUNT    registers per depth (default: 1000)\n"
+      "  -D DEPTHS   batch depths to compare (default: 1,4,16)\n"
+      "  -w          write the value read back, half reads half writes\n"
+      "  -T TIMEOUT  readiness timeout in ms (default: 300)\n");
+}
+
+static int bench(struct camctl *c, uint32_t reg, unsigned int count,
+                 unsigned int depth, int write)
+{
+   struct camctl_op ops[CAMCTL_MAX_DEPTH];
+   struct camctl_stats st;
+   unsigned int done, i, n;
+   uint32_t val;
+   double t0, t;
+   int ret;
+
+   ret = camctl_set_depth(c, depth);
+   if (ret) {
+      fprintf(stderr, "camctl-bench: depth %u out of 1..%d\n", depth, CAMCTL_MAX_DEPTH);
+      return ret;
+   }
+   ret = camctl_read_reg(c, reg, &val);
+   if (ret) {
+      fprintf(stderr, "camctl-bench: cannot read 0x%08x, status %d\n", reg, ret);
+      return ret;
+   }
+   camctl_reset_stats(c);
+
+   t0 = now_s();
+   for (done = 0; done < count; done += n) {
+      n = count - done < depth ? count - done : depth;
+      for (i = 0; i < n; i++) {
+         ops[i].addr = reg;
+         ops[i].val = val;
+         ops[i].write = write && (i & 1);
+      }
+      ret = camctl_batch(c, ops, n);
+      if (ret) {
+         fprintf(stderr, "camctl-bench: batch failed after %u registers, status %d\n",
+                 done, ret);
+         return ret;
+      }
+   }
+   t = now_s() - t0;
+
+   camctl_get_stats(c, &st);
+   printf("depth %2u: %8.0f regs/s  %7.1f us/reg  %6llu transfers  %5llu not ready  %.1f ms waited\n",
+          depth, count / t, st.us_per_op, (unsigned long long)st.transactions,
+          (unsigned long long)st.retries, st.wait_us / 1000);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   enum camctl_type type = CAMCTL_MICROLYNX;
+   const char *device = NULL;
+   char depths[64] = "1,4,16";
+   unsigned int count = 1000;
+   unsigned int timeout_ms = 0;
+   long reg = -1;
+   int i2c_bus = 9;
+   int i2c_addr = -1;
+   int write = 0;
+   struct camctl *c;
+   char *tok, *save;
+   size_t i;
+   int opt;
+   int ret;
+
+   while ((opt = getopt(argc, argv, "t:b:a:d:r:n:D:wT:h")) != -1) {
+      switch (opt) {
+      case 't':
+         for (i = 0; i < NUM_TYPES && strcmp(optarg, types[i].name); i++)
+            ;
+         if (i == NUM_TYPES) {
+            usage();
+            return 1;
+         }
+         type = types[i].type;
+         break;
+      case 'b':
+         i2c_bus = strtol(optarg, NULL, 0);
+         break;
+      case 'a':
+         i2c_addr = strtol(optarg, NULL, 0);
+         break;
+      case 'd':
+         device = optarg;
+         break;
+      case 'r':
+         reg = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         count = strtoul(optarg, NULL, 0);
+         break;
+      case 'D':
+         snprintf(depths, sizeof(depths), "%s", optarg);
+         break;
+      case 'w':
+         write = 1;
+         break;
+      case 'T':
+         timeout_ms = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   if (i2c_addr < 0)
+      i2c_addr = (type == CAMCTL_DIONE || type == CAMCTL_DIONE_GENCP) ? 0x5b : 0x51;
+   if (reg < 0)
+      reg = (type == CAMCTL_DIONE || type == CAMCTL_DIONE_GENCP) ? DIONE_REG_WIDTH : REG_FIRW_VER_R;
+
+   ret = camctl_open(&c, type, device, i2c_bus, i2c_addr);
+   if (ret) {
+      fprintf(stderr, "camctl-bench: cannot open the camera: %s\n", strerror(-ret));
+      return 1;
+   }
+   camctl_set_timeout(c, timeout_ms);
+
+   printf("%s register 0x%08lx, %u %s per depth\n", write ? "read/write" : "read",
+          reg, count, write ? "accesses" : "reads");
+   for (tok = strtok_r(depths, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+      ret = bench(c, reg, count, strtoul(tok, NULL, 0), write);
+      if (ret)
+         break;
+   }
+
+   camctl_close(c);
+   return ret ? 1 : 0;
+}
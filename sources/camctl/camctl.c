@@ -0,0 +1,712 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "camctl.h"
+#include "gencp_common.h"
+#include "microlynx_ioctl.h"
+
+#define DEFAULT_TIMEOUT_MS  GENCP_MAX_DEVICE_RESPONSE_TIME
+#define BACKOFF_MIN_US      50
+#define BACKOFF_MAX_US      2000
+
+/* Dione register protocol: [addr le32][len le16][data], answers [status le16][data] */
+#define DIONE_HDR_LEN       6
+#define DIONE_STATUS_LEN    2
+/* Dione registers whose write only stores a value (see dione_ir driver) */
+#define DIONE_REG_ACQ_SRC         0x00080108
+#define DIONE_REG_FILE_FIRST      0x10010000   /* FileSelector */
+#define DIONE_REG_FILE_OPEN_MODE  0x10010004
+#define DIONE_REG_FILE_OP_SEL     0x10010008
+#define DIONE_REG_FILE_ACCESS_OFS 0x1001001c
+#define DIONE_REG_FILE_ACCESS_LEN 0x10010020
+#define DIONE_REG_FILE_BUF        0x10011000   /* FileAccessBuffer */
+#define DIONE_REG_FILE_BUF_END    0x10012000
+/* Bytes of the I2C messages of one I2C_RDWR transfer */
+#define DIONE_SCRATCH_LEN   4096
+
+/* GenCP prefix + CCD */
+#define GENCP_HDR_LEN       SCD_DATA_OFFSET_BYTES
+#define GENCP_READ_SCD_LEN  READMEM_REQ_SCD_LENGTH_BYTES
+/* The Microlynx sends its answers in 16-byte I2C reads */
+#define MICROLYNX_RX_CHUNK  16
+
+struct camctl {
+   enum camctl_type type;
+   int      fd;
+   uint16_t i2c_addr;
+   unsigned int depth;
+   unsigned int timeout_ms;
+
+   /* GenCP */
+   uint16_t request_id;
+   uint8_t  rx[GENCP_RX_BUF_SIZE];   /* Answer being assembled */
+   size_t   rx_len;
+   uint8_t  dec[MICROLYNX_RX_CHUNK]; /* Microlynx stream, decoded and not consumed yet */
+   size_t   dec_len;
+   size_t   dec_pos;
+   uint8_t  last_byte;
+   int      word_count;
+
+   /* Dione register protocol */
+   uint8_t  scratch[DIONE_SCRATCH_LEN];
+
+   uint64_t ops;
+   uint64_t transactions;
+   uint64_t retries;
+   uint64_t errors;
+   uint64_t wait_ns;
+   uint64_t busy_ns;
+};
+
+/* One GenCP request or Dione message, a register or a buffer */
+struct xfer {
+   uint32_t addr;
+   uint8_t *data;
+   uint16_t len;
+   int      write;
+   int      status;
+   uint16_t request_id;
+   uint8_t  reg[4];
+};
+
+/* Batches are run XFER_CHUNK operations at a time */
+#define XFER_CHUNK          64
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint16_t get_be16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+static inline uint32_t get_be32(const uint8_t *p) { return ((uint32_t)get_be16(p) << 16) | get_be16(p + 2); }
+static inline uint32_t get_le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static inline uint16_t get_le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static inline void put_be16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+static inline void put_be32(uint8_t *p, uint32_t v) { put_be16(p, v >> 16); put_be16(p + 2, v); }
+static inline void put_le16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put_le32(uint8_t *p, uint32_t v) { put_le16(p, v); put_le16(p + 2, v >> 16); }
+
+/* ---- Readiness -------------------------------------------------------- */
+
+/*
+ * The camera NACKs while it is busy, the adapter reports it as one of these.
+ * Bus errors (EIO, ETIMEDOUT) are failures, not retried.
+ */
+static int is_not_ready(int err)
+{
+   return err == -ENXIO || err == -EREMOTEIO || err == -EAGAIN;
+}
+
+/* Wait a little longer each time, -ETIMEDOUT once past @deadline */
+static int wait_ready(struct camctl *c, unsigned int *backoff_us, uint64_t deadline)
+{
+   uint64_t start = now_ns();
+
+   if (start >= deadline)
+      return -ETIMEDOUT;
+   c->retries++;
+   usleep(*backoff_us);
+   c->wait_ns += now_ns() - start;
+   *backoff_us *= 2;
+   if (*backoff_us > BACKOFF_MAX_US)
+      *backoff_us = BACKOFF_MAX_US;
+   return 0;
+}
+
+/* I2C_RDWR transfer, retried while the camera NACKs */
+static int i2c_transfer(struct camctl *c, struct i2c_msg *msgs, unsigned int nmsgs)
+{
+   struct i2c_rdwr_ioctl_data rdwr = { .msgs = msgs, .nmsgs = nmsgs };
+   uint64_t deadline = now_ns() + c->timeout_ms * 1000000ull;
+   unsigned int backoff_us = BACKOFF_MIN_US;
+   int ret;
+
+   for (;;) {
+      c->transactions++;
+      if (ioctl(c->fd, I2C_RDWR, &rdwr) >= 0)
+         return 0;
+      ret = -errno;
+      if (!is_not_ready(ret) || wait_ready(c, &backoff_us, deadline))
+         return ret;
+   }
+}
+
+/* ---- Dione register protocol ------------------------------------------ */
+
+/*
+ * Writes that can be sent again without effect. I2C_RDWR doesn't tell which
+ * message was NACKed, so a NACKed transfer is retried whole: only these
+ * writes share a transfer. Anything else, such as AcquisitionStop or
+ * FileOperationExecute, could run twice and goes alone.
+ */
+static int dione_idempotent(const struct xfer *t)
+{
+   switch (t->addr) {
+   case DIONE_REG_ACQ_SRC:
+   case DIONE_REG_FILE_FIRST:
+   case DIONE_REG_FILE_OPEN_MODE:
+   case DIONE_REG_FILE_OP_SEL:
+   case DIONE_REG_FILE_ACCESS_OFS:
+   case DIONE_REG_FILE_ACCESS_LEN:
+      return 1;
+   }
+   return t->addr >= DIONE_REG_FILE_BUF && t->addr + t->len <= DIONE_REG_FILE_BUF_END;
+}
+
+/*
+ * As many idempotent writes as fit in one I2C_RDWR, one message each. Other
+ * writes and reads are transfers of their own, a read being a header write
+ * and a read of the status and data: adapters like i2c-bcm2835 (Pi 4) only
+ * take a single read message per transfer, as the last one.
+ */
+static int dione_run(struct camctl *c, struct xfer *x, unsigned int n)
+{
+   struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+   uint8_t *rx[CAMCTL_MAX_DEPTH];
+   unsigned int i, j, count, nmsgs;
+   size_t used;
+   int ret = 0;
+
+   for (i = 0; i < n && !ret; i += count) {
+      nmsgs = 0;
+      used = 0;
+      for (count = 0; i + count < n && count < c->depth; count++) {
+         struct xfer *t = &x[i + count];
+         size_t need = DIONE_HDR_LEN + (t->write ? t->len : DIONE_STATUS_LEN + t->len);
+         uint8_t *p = c->scratch + used;
+
+         int alone = !t->write || !dione_idempotent(t);
+
+         if ((alone && count) || nmsgs + (t->write ? 1 : 2) > I2C_RDWR_IOCTL_MAX_MSGS ||
+             used + need > sizeof(c->scratch))
+            break;
+
+         put_le32(p, t->addr);
+         put_le16(p + 4, t->len);
+         msgs[nmsgs].addr = c->i2c_addr;
+         msgs[nmsgs].flags = 0;
+         msgs[nmsgs].len = DIONE_HDR_LEN;
+         msgs[nmsgs].buf = p;
+         if (t->write) {
+            memcpy(p + DIONE_HDR_LEN, t->data, t->len);
+            msgs[nmsgs++].len += t->len;
+         } else {
+            rx[count] = p + DIONE_HDR_LEN;
+            nmsgs++;
+            msgs[nmsgs].addr = c->i2c_addr;
+            msgs[nmsgs].flags = I2C_M_RD;
+            msgs[nmsgs].len = DIONE_STATUS_LEN + t->len;
+            msgs[nmsgs++].buf = rx[count];
+         }
+         used += need;
+         if (alone) {
+            count++;
+            break;
+         }
+      }
+
+      ret = i2c_transfer(c, msgs, nmsgs);
+      for (j = 0; j < count; j++) {
+         struct xfer *t = &x[i + j];
+
+         t->status = ret;
+         if (ret || t->write)
+            continue;
+         // Same check as the dione_ir driver
+         if (get_le16(rx[j]))
+            t->status = -EINVAL;
+         else
+            memcpy(t->data, rx[j] + DIONE_STATUS_LEN, t->len);
+      }
+      for (j = 0; j < count && !ret; j++)
+         ret = x[i + j].status;
+   }
+
+   for (; i < n; i++)
+      x[i].status = -ECANCELED;
+   return ret;
+}
+
+/* ---- GenCP on I2C ----------------------------------------------------- */
+
+static void gencp_reset_rx(struct camctl *c)
+{
+   c->rx_len = 0;
+   c->dec_len = 0;
+   c->dec_pos = 0;
+   c->last_byte = 0xAA;
+   c->word_count = 0;
+}
+
+static int gencp_send(struct camctl *c, struct xfer *t)
+{
+   uint8_t msg[GENCP_TX_BUF_SIZE];
+   struct i2c_msg i2c = { .addr = c->i2c_addr, .flags = 0, .buf = msg };
+   uint16_t scd_len = t->write ? WRITEMEM_REGADDR_LENGTH_BYTES + t->len : GENCP_READ_SCD_LEN;
+
+   if (++c->request_id == 0)
+      c->request_id = 1;
+   t->request_id = c->request_id;
+
+   put_be16(msg, GENCP_PREAMBLE);
+   put_be16(msg + 6, 0);                           // Channel ID
+   put_be16(msg + 8, GENCP_CMD_FLAG_REQUEST_ACK);
+   put_be16(msg + 10, t->write ? GENCP_WRITEMEM_CMD : GENCP_READMEM_CMD);
+   put_be16(msg + 12, scd_len);
+   put_be16(msg + 14, t->request_id);
+   put_be32(msg + 16, 0);                          // 64-bit address
+   put_be32(msg + 20, t->addr);
+   if (t->write) {
+      memcpy(msg + 24, t->data, t->len);
+   } else {
+      put_be16(msg + 24, 0);
+      put_be16(msg + 26, t->len);
+   }
+   put_be16(msg + 2, GENCP_crc16(msg + 6, CCD_CRC_LENGTH_BYTES));
+   put_be16(msg + 4, GENCP_crc16(msg + 6, CCD_CRC_LENGTH_BYTES + scd_len));
+
+   i2c.len = GENCP_HDR_LEN + scd_len;
+   return i2c_transfer(c, &i2c, 1);
+}
+
+/* Assemble the answer byte by byte, 1 when a whole one is in c->rx */
+static int gencp_feed(struct camctl *c, uint8_t b)
+{
+   if (c->rx_len == 0 && b != (GENCP_PREAMBLE >> 8))
+      return 0;
+   if (c->rx_len == 1 && b != (GENCP_PREAMBLE & 0xFF)) {
+      c->rx_len = (b == (GENCP_PREAMBLE >> 8));
+      return 0;
+   }
+   c->rx[c->rx_len++] = b;
+
+   if (c->rx_len == GENCP_HDR_LEN &&
+       (GENCP_crc16(c->rx + 6, CCD_CRC_LENGTH_BYTES) != get_be16(c->rx + 2) ||
+        get_be16(c->rx + 12) > sizeof(c->rx) - GENCP_HDR_LEN)) {
+      c->errors++;
+      c->rx_len = 0;
+      return 0;
+   }
+   return c->rx_len >= GENCP_HDR_LEN &&
+          c->rx_len == (size_t)GENCP_HDR_LEN + get_be16(c->rx + 12);
+}
+
+/*
+ * Next answer from the camera in c->rx, 0, -EAGAIN when there is none yet or
+ * -errno.  The Microlynx sends a byte stream where each byte is followed by
+ * its complement and repeated bytes are idle (see parse_gencp_raw()); the
+ * Dione answers in one read of @expect bytes.
+ */
+static int gencp_recv(struct camctl *c, size_t expect)
+{
+   struct i2c_msg i2c = { .addr = c->i2c_addr, .flags = I2C_M_RD };
+   uint8_t raw[GENCP_RX_BUF_SIZE];
+   size_t i;
+   int ret;
+
+   if (c->type == CAMCTL_DIONE_GENCP) {
+      i2c.len = expect;
+      i2c.buf = raw;
+      ret = i2c_transfer(c, &i2c, 1);
+      if (ret)
+         return ret;
+      c->rx_len = 0;
+      for (i = 0; i < expect; i++)
+         if (gencp_feed(c, raw[i]))
+            return 0;
+      c->rx_len = 0;
+      return -EAGAIN;
+   }
+
+   for (;;) {
+      while (c->dec_pos < c->dec_len)
+         if (gencp_feed(c, c->dec[c->dec_pos++]))
+            return 0;
+
+      i2c.len = MICROLYNX_RX_CHUNK;
+      i2c.buf = raw;
+      ret = i2c_transfer(c, &i2c, 1);
+      if (ret)
+         return ret;
+
+      c->dec_len = 0;
+      c->dec_pos = 0;
+      for (i = 0; i < MICROLYNX_RX_CHUNK; i++) {
+         if (raw[i] != c->last_byte) {
+            c->word_count++;
+            if ((raw[i] ^ c->last_byte) == 0xFF && c->word_count > 1) {
+               c->word_count = 0;
+               c->dec[c->dec_len++] = c->last_byte;
+            }
+         }
+         c->last_byte = raw[i];
+      }
+      if (!c->dec_len)
+         return -EAGAIN;
+   }
+}
+
+/*
+ * Up to c->depth requests in flight.  The acks are matched on their request
+ * ID, stale acks of requests that timed out before are dropped.
+ */
+static int gencp_run(struct camctl *c, struct xfer *x, unsigned int n)
+{
+   struct xfer *inflight[CAMCTL_MAX_DEPTH];
+   unsigned int ninflight = 0, next = 0, i;
+   unsigned int backoff_us = BACKOFF_MIN_US;
+   uint64_t deadline = 0;
+   int failed = 0;
+   int ret;
+
+   for (i = 0; i < n; i++)
+      x[i].status = -ECANCELED;
+
+   while (next < n || ninflight) {
+      struct xfer *t = NULL;
+      uint16_t cmd, id;
+
+      // Keep the window full until something fails
+      while (!failed && next < n && ninflight < c->depth) {
+         t = &x[next++];
+         t->status = gencp_send(c, t);
+         if (t->status) {
+            failed = 1;
+            break;
+         }
+         inflight[ninflight++] = t;
+         deadline = now_ns() + c->timeout_ms * 1000000ull;
+      }
+      if (!ninflight)
+         break;
+
+      // The Dione answers in order, the oldest request tells the length
+      t = inflight[0];
+      ret = gencp_recv(c, GENCP_HDR_LEN + (t->write ? WRITE_MEM_ACK_MSG_SCD_LENGTH_BYTES : t->len));
+      if (ret == -EAGAIN) {
+         ret = wait_ready(c, &backoff_us, deadline);
+         if (!ret)
+            continue;
+      }
+      if (ret) {
+         for (i = 0; i < ninflight; i++)
+            inflight[i]->status = ret;
+         gencp_reset_rx(c);
+         break;
+      }
+      backoff_us = BACKOFF_MIN_US;
+
+      cmd = get_be16(c->rx + 10);
+      id = get_be16(c->rx + 14);
+      for (i = 0; i < ninflight && inflight[i]->request_id != id; i++)
+         ;
+      if (i == ninflight) {
+         c->errors++;
+         c->rx_len = 0;
+         continue;
+      }
+      t = inflight[i];
+
+      if (cmd == GENCP_PENDING_ACK && get_be16(c->rx + 12) >= 4) {
+         // The camera is still working on it, for up to the given time
+         deadline = now_ns() + (get_be16(c->rx + GENCP_HDR_LEN + 2) + c->timeout_ms) * 1000000ull;
+         c->retries++;
+         c->rx_len = 0;
+         continue;
+      }
+
+      t->status = get_be16(c->rx + 8);
+      if (!t->status && cmd != (t->write ? GENCP_WRITEMEM_ACK : GENCP_READMEM_ACK))
+         t->status = -EPROTO;
+      if (!t->status && !t->write) {
+         if (get_be16(c->rx + 12) < t->len)
+            t->status = -EPROTO;
+         else
+            memcpy(t->data, c->rx + GENCP_HDR_LEN, t->len);
+      }
+      c->rx_len = 0;
+      // Answers of requests sent before an error are still waited for
+      if (t->status)
+         failed = 1;
+      inflight[i] = inflight[--ninflight];
+      deadline = now_ns() + c->timeout_ms * 1000000ull;
+   }
+
+   // First failure in order of the batch
+   for (i = 0; i < n; i++)
+      if (x[i].status)
+         return x[i].status;
+   return 0;
+}
+
+/* ---- microlynx kernel chardev ----------------------------------------- */
+
+static int chardev_run(struct camctl *c, struct xfer *x, unsigned int n)
+{
+   unsigned int i;
+   int ret = 0;
+
+   for (i = 0; i < n; i++) {
+      struct xfer *t = &x[i];
+
+      if (ret) {
+         t->status = -ECANCELED;
+         continue;
+      }
+
+      c->transactions++;
+      if (t->len == 4 && t->write) {
+         struct microlynx_reg_op op = { .addr = t->addr, .val = get_be32(t->data) };
+
+         ret = ioctl(c->fd, MICROLYNX_IOCTL_WRITE_REG, &op) ? -errno : 0;
+      } else if (t->len == 4) {
+         struct microlynx_reg_op op = { .addr = t->addr };
+
+         ret = ioctl(c->fd, MICROLYNX_IOCTL_READ_REG, &op) ? -errno : 0;
+         put_be32(t->data, op.val);
+      } else if (!t->write && t->len <= MICROLYNX_STR_MAX) {
+         struct microlynx_str_op op = { .addr = t->addr, .len = t->len };
+
+         ret = ioctl(c->fd, MICROLYNX_IOCTL_READ_STR, &op) ? -errno : 0;
+         memcpy(t->data, op.buf, t->len);
+      } else {
+         ret = -EOPNOTSUPP;
+      }
+      t->status = ret;
+   }
+   return ret;
+}
+
+/* ---- API -------------------------------------------------------------- */
+
+static int run(struct camctl *c, struct xfer *x, unsigned int n)
+{
+   uint64_t start = now_ns();
+   int ret;
+
+   switch (c->type) {
+   case CAMCTL_DIONE:
+      ret = dione_run(c, x, n);
+      break;
+   case CAMCTL_MICROLYNX:
+      ret = chardev_run(c, x, n);
+      break;
+   default:
+      ret = gencp_run(c, x, n);
+      break;
+   }
+
+   c->ops += n;
+   if (ret)
+      c->errors++;
+   c->busy_ns += now_ns() - start;
+   return ret;
+}
+
+int camctl_open(struct camctl **c, enum camctl_type type, const char *path,
+                int bus, int addr)
+{
+   struct camctl *h;
+   char i2c_path[32];
+   uint32_t version;
+   int ret;
+
+   h = calloc(1, sizeof(*h));
+   if (!h)
+      return -ENOMEM;
+   h->type = type;
+   h->i2c_addr = addr;
+   h->depth = 1;
+   h->timeout_ms = DEFAULT_TIMEOUT_MS;
+   gencp_reset_rx(h);
+
+   if (type == CAMCTL_MICROLYNX) {
+      glob_t g = { 0 };
+
+      if (!path) {
+         if (glob("/dev/microlynx-*", 0, NULL, &g) || g.gl_pathc == 0) {
+            globfree(&g);
+            free(h);
+            return -ENODEV;
+         }
+         path = g.gl_pathv[0];
+      }
+      h->fd = open(path, O_RDWR | O_CLOEXEC);
+      ret = h->fd < 0 ? -errno : 0;
+      globfree(&g);
+   } else if (type <= CAMCTL_MICROLYNX_I2C) {
+      // I2C_RDWR carries the address, no I2C_SLAVE that a bound driver would refuse
+      snprintf(i2c_path, sizeof(i2c_path), "/dev/i2c-%d", bus);
+      h->fd = open(i2c_path, O_RDWR | O_CLOEXEC);
+      ret = h->fd < 0 ? -errno : 0;
+   } else {
+      ret = -EINVAL;
+   }
+   if (ret) {
+      free(h);
+      return ret;
+   }
+
+   // Same check as GENCPCLIENT_Init(), the first read may catch a stale answer
+   if (type == CAMCTL_DIONE_GENCP || type == CAMCTL_MICROLYNX_I2C) {
+      ret = camctl_read_reg(h, GENCP_REG_GENCP_VERSION, &version);
+      if (ret)
+         ret = camctl_read_reg(h, GENCP_REG_GENCP_VERSION, &version);
+      if (ret) {
+         camctl_close(h);
+         return ret < 0 ? ret : -EIO;
+      }
+   }
+
+   camctl_reset_stats(h);
+   *c = h;
+   return 0;
+}
+
+void camctl_close(struct camctl *c)
+{
+   if (!c)
+      return;
+   close(c->fd);
+   free(c);
+}
+
+int camctl_set_depth(struct camctl *c, unsigned int depth)
+{
+   if (depth < 1 || depth > CAMCTL_MAX_DEPTH)
+      return -EINVAL;
+   c->depth = depth;
+   return 0;
+}
+
+void camctl_set_timeout(struct camctl *c, unsigned int timeout_ms)
+{
+   c->timeout_ms = timeout_ms ? timeout_ms : DEFAULT_TIMEOUT_MS;
+}
+
+int camctl_read_reg(struct camctl *c, uint32_t addr, uint32_t *val)
+{
+   struct camctl_op op = { .addr = addr };
+   int ret = camctl_batch(c, &op, 1);
+
+   *val = op.val;
+   return ret;
+}
+
+int camctl_write_reg(struct camctl *c, uint32_t addr, uint32_t val)
+{
+   struct camctl_op op = { .addr = addr, .val = val, .write = 1 };
+
+   return camctl_batch(c, &op, 1);
+}
+
+int camctl_batch(struct camctl *c, struct camctl_op *ops, unsigned int n)
+{
+   struct xfer x[XFER_CHUNK];
+   unsigned int i, j, count;
+   int ret = 0;
+
+   for (i = 0; i < n; i += count) {
+      count = n - i < XFER_CHUNK ? n - i : XFER_CHUNK;
+      if (ret) {
+         for (j = 0; j < count; j++)
+            ops[i + j].status = -ECANCELED;
+         continue;
+      }
+
+      for (j = 0; j < count; j++) {
+         struct xfer *t = &x[j];
+
+         t->addr = ops[i + j].addr;
+         t->data = t->reg;
+         t->len = sizeof(t->reg);
+         t->write = ops[i + j].write;
+         // GenCP registers are big-endian
+         if (c->type == CAMCTL_DIONE)
+            put_le32(t->reg, ops[i + j].val);
+         else
+            put_be32(t->reg, ops[i + j].val);
+      }
+
+      ret = run(c, x, count);
+
+      for (j = 0; j < count; j++) {
+         struct xfer *t = &x[j];
+
+         ops[i + j].status = t->status;
+         if (t->status || t->write)
+            continue;
+         if (c->type == CAMCTL_DIONE)
+            ops[i + j].val = get_le32(t->reg);
+         else
+            ops[i + j].val = get_be32(t->reg);
+      }
+   }
+   return ret;
+}
+
+static int xfer_buf(struct camctl *c, uint32_t addr, uint8_t *buf, size_t len, int write)
+{
+   struct xfer x;
+   size_t done;
+   int ret = 0;
+
+   for (done = 0; done < len && !ret; done += x.len) {
+      x.addr = addr + done;
+      x.data = buf + done;
+      x.len = len - done < CAMCTL_MAX_BUF ? len - done : CAMCTL_MAX_BUF;
+      x.write = write;
+      ret = run(c, &x, 1);
+   }
+   return ret;
+}
+
+int camctl_read_buf(struct camctl *c, uint32_t addr, uint8_t *buf, size_t len)
+{
+   return xfer_buf(c, addr, buf, len, 0);
+}
+
+int camctl_write_buf(struct camctl *c, uint32_t addr, const uint8_t *buf, size_t len)
+{
+   return xfer_buf(c, addr, (uint8_t *)buf, len, 1);
+}
+
+void camctl_get_stats(struct camctl *c, struct camctl_stats *stats)
+{
+   stats->ops = c->ops;
+   stats->transactions = c->transactions;
+   stats->retries = c->retries;
+   stats->errors = c->errors;
+   stats->wait_us = c->wait_ns / 1000.0;
+   stats->us_per_op = c->ops ? c->busy_ns / 1000.0 / c->ops : 0;
+}
+
+void camctl_reset_stats(struct camctl *c)
+{
+   c->ops = 0;
+   c->transactions = 0;
+   c->retries = 0;
+   c->errors = 0;
+   c->wait_ns = 0;
+   c->busy_ns = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef CAMCTL_H
+#define CAMCTL_H
+
+/*
+ * Register access library for Dione and Microlynx cameras.
+ *
+ * One handle keeps the control channel of a camera open for its lifetime.
+ * The I2C is paced by the readiness of the camera instead of fixed sleeps:
+ * a NACK, a GenCP answer not there yet or a GenCP PENDING_ACK is retried
+ * with a short backoff, up to the timeout.
+ *
+ * Several operations can be passed in one camctl_batch() call:
+ *   - Dione register protocol: up to <depth> writes per I2C transfer
+ *     (I2C_RDWR, repeated start between the messages) for the registers
+ *     that can safely be written twice, a read or any other write per
+ *     transfer
+ *   - GenCP on I2C: up to <depth> requests in flight, the acks being
+ *     matched on their GenCP request ID
+ *   - microlynx kernel chardev: one ioctl per operation on the open handle,
+ *     the GenCP transactions are done by the kernel module
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct camctl;
+
+enum camctl_type {
+   CAMCTL_DIONE,          /* Dione register protocol on /dev/i2c-<bus> */
+   CAMCTL_DIONE_GENCP,    /* Dione GenCP on /dev/i2c-<bus> */
+   CAMCTL_MICROLYNX_I2C,  /* Microlynx GenCP on /dev/i2c-<bus>, without the module */
+   CAMCTL_MICROLYNX,      /* microlynx kernel chardev (/dev/microlynx-<bus>-<addr>) */
+};
+
+#define CAMCTL_MAX_DEPTH   32
+/* Largest camctl_read_buf()/camctl_write_buf() chunk sent in one message */
+#define CAMCTL_MAX_BUF     1000
+
+struct camctl_op {
+   uint32_t addr;
+   uint32_t val;      /* Value to write, or value read */
+   int      write;    /* 1 write, 0 read */
+   int      status;   /* Out: 0, GenCP status or -errno */
+};
+
+struct camctl_stats {
+   uint64_t ops;            /* Registers read or written */
+   uint64_t transactions;   /* I2C transfers or ioctls */
+   uint64_t retries;        /* Camera not ready yet: NACK, no answer, pending */
+   uint64_t errors;
+   double   wait_us;        /* Total time spent waiting for readiness */
+   double   us_per_op;      /* Average time per register */
+};
+
+/*
+ * Open the control channel, 0 or -errno.  @path is the microlynx chardev for
+ * CAMCTL_MICROLYNX (NULL: first /dev/microlynx-*), @bus and @addr are the I2C
+ * bus and address for the other types.
+ */
+int camctl_open(struct camctl **c, enum camctl_type type, const char *path,
+                int bus, int addr);
+void camctl_close(struct camctl *c);
+
+/* Operations per transfer or GenCP requests in flight, 1 to CAMCTL_MAX_DEPTH */
+int camctl_set_depth(struct camctl *c, unsigned int depth);
+/* Readiness timeout of one operation (default 300 ms, GenCP max response time) */
+void camctl_set_timeout(struct camctl *c, unsigned int timeout_ms);
+
+int camctl_read_reg(struct camctl *c, uint32_t addr, uint32_t *val);
+int camctl_write_reg(struct camctl *c, uint32_t addr, uint32_t val);
+
+/*
+ * Run @n operations in order.  Returns 0, or the status of the first failing
+ * operation: the operations after it are not run and get -ECANCELED.
+ */
+int camctl_batch(struct camctl *c, struct camctl_op *ops, unsigned int n);
+
+/* Raw register bytes, as sent by the camera (no byte swapping) */
+int camctl_read_buf(struct camctl *c, uint32_t addr, uint8_t *buf, size_t len);
+int camctl_write_buf(struct camctl *c, uint32_t addr, const uint8_t *buf, size_t len);
+
+void camctl_get_stats(struct camctl *c, struct camctl_stats *stats);
+void camctl_reset_stats(struct camctl *c);
+
+#endif /* CAMCTL_H */
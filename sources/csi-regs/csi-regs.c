@@ -0,0 +1,967 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * csi-regs - CSI-2 receiver register inspection for Raspberry Pi 4 and 5.
+ *
+ * Maps the receiver registers through /dev/mem (read only) and either dumps
+ * them once with the status bits decoded, or samples a set of status, lane
+ * and frame counter registers at a fixed rate while streaming.  Samples are
+ * taken by a dedicated thread into a ring buffer and written by another one,
+ * so the output doesn't disturb the sampling period.  Timestamps are
+ * CLOCK_MONOTONIC, as the V4L2 buffer timestamps, to correlate with a
+ * capture.
+ *
+ * Blocks: BCM2711 unicam (Pi 4) and RP1 CSI2 DMA, DPHY and MIPI config
+ * (Pi 5, the CFE inputs).  The register layouts are the ones of the
+ * vc4-regs-unicam.h, csi2.c, dphy.c and cfe.c kernel sources.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define NSEC_PER_SEC  1000000000ULL
+
+/* Below this period the sampler spins on the clock instead of sleeping */
+#define SPIN_PERIOD_NS 50000
+
+#define MAX_BLOCKS      3
+#define MAX_SAMPLE_REGS 16
+
+struct bit_desc {
+   uint32_t    mask;
+   const char *name;
+   int         error;
+};
+
+struct reg_desc {
+   const char *name;
+   uint32_t    off;
+   const char *desc;
+};
+
+struct block {
+   const char            *name;
+   uint64_t               base;
+   size_t                 size;
+   const struct reg_desc *regs;
+   unsigned int           nregs;
+   volatile uint32_t     *map;
+};
+
+/* A sampled register, with the bits to decode (may be none) */
+struct sample_reg {
+   const char            *name;
+   unsigned int           block;
+   uint32_t               off;
+   const struct bit_desc *bits;
+   unsigned int           nbits;
+   /* Field decoder for counters, NULL when bits (or plain hex) */
+   int (*decode)(uint32_t v, char *buf, size_t len);
+};
+
+struct target {
+   const char              *name;
+   const char              *desc;
+   struct block             blocks[MAX_BLOCKS];
+   unsigned int             nblocks;
+   const struct sample_reg *sample;
+   unsigned int             nsample;
+   void (*summary)(const struct target *t);
+};
+
+/*
+ * Data types
+ */
+
+static const char *dt_name(unsigned int dt)
+{
+   switch (dt) {
+   case 0x00: return "FS";
+   case 0x01: return "FE";
+   case 0x02: return "LS";
+   case 0x03: return "LE";
+   case 0x12: return "EMBEDDED";
+   case 0x1e: return "YUV422-8";
+   case 0x22: return "RGB565";
+   case 0x24: return "RGB888";
+   case 0x28: return "RAW6";
+   case 0x29: return "RAW7";
+   case 0x2a: return "RAW8";
+   case 0x2b: return "RAW10";
+   case 0x2c: return "RAW12";
+   case 0x2d: return "RAW14";
+   case 0x2e: return "RAW16";
+   case 0x2f: return "RAW20";
+   }
+   if (dt >= 0x30 && dt <= 0x37)
+      return "USER";
+   return "unknown";
+}
+
+/*
+ * BCM2711 unicam, vc4-regs-unicam.h
+ */
+
+static const struct reg_desc unicam_regs[] = {
+   { "UNICAM_CTRL",  0x000, "Control" },
+   { "UNICAM_STA",   0x004, "Status" },
+   { "UNICAM_ANA",   0x008, "PHY analog" },
+   { "UNICAM_PRI",   0x00c, "Priority" },
+   { "UNICAM_CLK",   0x010, "Clock lane" },
+   { "UNICAM_CLT",   0x014, "Clock lane timing" },
+   { "UNICAM_DAT0",  0x018, "Data lane 0" },
+   { "UNICAM_DAT1",  0x01c, "Data lane 1" },
+   { "UNICAM_DAT2",  0x020, "Data lane 2" },
+   { "UNICAM_DAT3",  0x024, "Data lane 3" },
+   { "UNICAM_DLT",   0x028, "Data lane timing" },
+   { "UNICAM_CMP0",  0x02c, "Packet compare 0" },
+   { "UNICAM_CMP1",  0x030, "Packet compare 1" },
+   { "UNICAM_CAP0",  0x034, "Packet capture 0" },
+   { "UNICAM_CAP1",  0x038, "Packet capture 1" },
+   { "UNICAM_ICTL",  0x100, "Image control" },
+   { "UNICAM_ISTA",  0x104, "Image status" },
+   { "UNICAM_IDI0",  0x108, "Image data IDs 0 (VC/DT)" },
+   { "UNICAM_IPIPE", 0x10c, "Image pipeline (un)packing" },
+   { "UNICAM_IBSA0", 0x110, "Image buffer 0 start" },
+   { "UNICAM_IBEA0", 0x114, "Image buffer 0 end" },
+   { "UNICAM_IBLS",  0x118, "Image line stride" },
+   { "UNICAM_IBWP",  0x11c, "Image write pointer" },
+   { "UNICAM_IHWIN", 0x120, "Image horizontal window" },
+   { "UNICAM_IHSTA", 0x124, "Image horizontal status" },
+   { "UNICAM_IVWIN", 0x128, "Image vertical window" },
+   { "UNICAM_IVSTA", 0x12c, "Image vertical status" },
+   { "UNICAM_ICC",   0x130, "Image compression control" },
+   { "UNICAM_ICS",   0x134, "Image compression status" },
+   { "UNICAM_IDC",   0x138, "Image differential control" },
+   { "UNICAM_IDPO",  0x13c, "Image differential offset" },
+   { "UNICAM_IDCA",  0x140, "Image differential address" },
+   { "UNICAM_IDCD",  0x144, "Image differential data" },
+   { "UNICAM_IDS",   0x148, "Image differential status" },
+   { "UNICAM_DCS",   0x200, "Data control/status" },
+   { "UNICAM_DBSA0", 0x204, "Data buffer 0 start" },
+   { "UNICAM_DBEA0", 0x208, "Data buffer 0 end" },
+   { "UNICAM_DBWP",  0x20c, "Data write pointer" },
+   { "UNICAM_DBCTL", 0x300, "Double buffer control" },
+   { "UNICAM_IBSA1", 0x304, "Image buffer 1 start" },
+   { "UNICAM_IBEA1", 0x308, "Image buffer 1 end" },
+   { "UNICAM_IDI1",  0x30c, "Image data IDs 1 (VC/DT)" },
+   { "UNICAM_DBSA1", 0x310, "Data buffer 1 start" },
+   { "UNICAM_DBEA1", 0x314, "Data buffer 1 end" },
+   { "UNICAM_MISC",  0x400, "Miscellaneous" },
+};
+
+static const struct bit_desc unicam_sta_bits[] = {
+   { 1u << 0,  "SYN",      0 },
+   { 1u << 1,  "CS",       0 },
+   { 1u << 2,  "SBE",      1 },
+   { 1u << 3,  "PBE",      1 },
+   { 1u << 4,  "HOE",      1 },
+   { 1u << 5,  "PLE",      1 },
+   { 1u << 6,  "SSC",      1 },
+   { 1u << 7,  "CRCE",     1 },
+   { 1u << 8,  "OES",      0 },
+   { 1u << 9,  "IFO",      1 },
+   { 1u << 10, "OFO",      1 },
+   { 1u << 11, "BFO",      1 },
+   { 1u << 12, "DL",       1 },
+   { 1u << 13, "PS",       0 },
+   { 1u << 14, "IS",       0 },
+   { 1u << 15, "PI0",      0 },
+   { 1u << 16, "PI1",      0 },
+   { 1u << 17, "FSI_S",    0 },
+   { 1u << 18, "FEI_S",    0 },
+   { 1u << 19, "LCI_S",    0 },
+   { 1u << 20, "BUF0_RDY", 0 },
+   { 1u << 21, "BUF0_NO",  0 },
+   { 1u << 22, "BUF1_RDY", 0 },
+   { 1u << 23, "BUF1_NO",  0 },
+   { 1u << 24, "DI",       0 },
+};
+
+static const struct bit_desc unicam_ista_bits[] = {
+   { 1u << 0, "FSI", 0 },
+   { 1u << 1, "FEI", 0 },
+   { 1u << 2, "LCI", 0 },
+};
+
+static const struct bit_desc unicam_clk_bits[] = {
+   { 1u << 0,  "CLE",   0 },
+   { 1u << 1,  "CLPD",  0 },
+   { 1u << 2,  "CLLPE", 0 },
+   { 1u << 3,  "CLHSE", 0 },
+   { 1u << 4,  "CLTRE", 0 },
+   { 1u << 29, "CLSTE", 1 },
+};
+
+static const struct bit_desc unicam_dat_bits[] = {
+   { 1u << 0,  "DLE",   0 },
+   { 1u << 1,  "DLPD",  0 },
+   { 1u << 2,  "DLLPE", 0 },
+   { 1u << 3,  "DLHSE", 0 },
+   { 1u << 4,  "DLTRE", 0 },
+   { 1u << 5,  "DLSM",  0 },
+   { 1u << 28, "DLFO",  1 },
+   { 1u << 29, "DLSTE", 1 },
+};
+
+/* Line being written, from the vertical status */
+static int decode_unicam_ivsta(uint32_t v, char *buf, size_t len)
+{
+   return snprintf(buf, len, "line=%u", v & 0xffff);
+}
+
+static const struct sample_reg unicam_sample[] = {
+   { "STA",   0, 0x004, unicam_sta_bits,  ARRAY_SIZE(unicam_sta_bits),  NULL },
+   { "ISTA",  0, 0x104, unicam_ista_bits, ARRAY_SIZE(unicam_ista_bits), NULL },
+   { "CLK",   0, 0x010, unicam_clk_bits,  ARRAY_SIZE(unicam_clk_bits),  NULL },
+   { "DAT0",  0, 0x018, unicam_dat_bits,  ARRAY_SIZE(unicam_dat_bits),  NULL },
+   { "DAT1",  0, 0x01c, unicam_dat_bits,  ARRAY_SIZE(unicam_dat_bits),  NULL },
+   { "DAT2",  0, 0x020, unicam_dat_bits,  ARRAY_SIZE(unicam_dat_bits),  NULL },
+   { "DAT3",  0, 0x024, unicam_dat_bits,  ARRAY_SIZE(unicam_dat_bits),  NULL },
+   { "CAP0",  0, 0x034, NULL, 0, NULL },
+   { "CAP1",  0, 0x038, NULL, 0, NULL },
+   { "IBWP",  0, 0x11c, NULL, 0, NULL },
+   { "IHSTA", 0, 0x124, NULL, 0, NULL },
+   { "IVSTA", 0, 0x12c, NULL, 0, decode_unicam_ivsta },
+};
+
+static void unicam_summary(const struct target *t)
+{
+   const volatile uint32_t *r = t->blocks[0].map;
+   uint32_t idi0 = r[0x108 / 4];
+   uint32_t ipipe = r[0x10c / 4];
+   uint32_t dcs = r[0x200 / 4];
+   unsigned int i;
+
+   printf("\n[Decoded summary]\n");
+   for (i = 0; i < 4; i++) {
+      uint32_t id = (idi0 >> (8 * i)) & 0xff;
+
+      if (!id && i)
+         continue;
+      printf("  Image ID %u       : VC %u, DT 0x%02x = %s\n", i, id >> 6, id & 0x3f,
+             dt_name(id & 0x3f));
+   }
+   printf("  Unpack / pack    : %u / %u\n", ipipe & 0x7, (ipipe >> 7) & 0x7);
+   printf("  Bytes / line     : %u\n", r[0x118 / 4]);
+   printf("  Line (IVSTA)     : %u\n", r[0x12c / 4] & 0xffff);
+   printf("  Embedded data    : %s, %u lines\n", dcs & 1 ? "enabled" : "disabled",
+          (dcs >> 8) & 0xff);
+}
+
+/*
+ * RP1 CSI2 (csi2.c), DPHY host (dphy.c) and MIPI config (cfe.c)
+ */
+
+enum { CFE_CSI2, CFE_DPHY, CFE_MIPICFG };
+
+#define CSI2_CH_REGS(x) \
+   { "CSI2_CH_CTRL(" #x ")",        (x) * 0x40 + 0x28, "Channel control" }, \
+   { "CSI2_CH_ADDR0(" #x ")",       (x) * 0x40 + 0x2c, "Buffer address low" }, \
+   { "CSI2_CH_STRIDE(" #x ")",      (x) * 0x40 + 0x30, "Stride (16 bytes)" }, \
+   { "CSI2_CH_LENGTH(" #x ")",      (x) * 0x40 + 0x34, "Length (16 bytes)" }, \
+   { "CSI2_CH_DEBUG(" #x ")",       (x) * 0x40 + 0x38, "Frame / line counters" }, \
+   { "CSI2_CH_ADDR1(" #x ")",       (x) * 0x40 + 0x3c, "Buffer address high" }, \
+   { "CSI2_CH_FRAME_SIZE(" #x ")",  (x) * 0x40 + 0x40, "Height / width" }, \
+   { "CSI2_CH_COMP_CTRL(" #x ")",   (x) * 0x40 + 0x44, "Compression" }, \
+   { "CSI2_CH_FE_FRAME_ID(" #x ")", (x) * 0x40 + 0x48, "Frame ID to the FE" }
+
+static const struct reg_desc csi2_regs[] = {
+   { "CSI2_STATUS",             0x000, "Interrupt status" },
+   { "CSI2_QOS",                0x004, "QoS" },
+   { "CSI2_DISCARDS_OVERFLOW",  0x008, "Discards, overflow" },
+   { "CSI2_DISCARDS_INACTIVE",  0x00c, "Discards, inactive channel" },
+   { "CSI2_DISCARDS_UNMATCHED", 0x010, "Discards, unmatched VC/DT" },
+   { "CSI2_DISCARDS_LEN_LIMIT", 0x014, "Discards, length limit" },
+   { "CSI2_LLEV_PANICS",        0x018, "Lower level panics" },
+   { "CSI2_ULEV_PANICS",        0x01c, "Upper level panics" },
+   { "CSI2_IRQ_MASK",           0x020, "Error interrupt mask" },
+   { "CSI2_CTRL",               0x024, "Control" },
+   CSI2_CH_REGS(0),
+   CSI2_CH_REGS(1),
+   CSI2_CH_REGS(2),
+   CSI2_CH_REGS(3),
+};
+
+static const struct reg_desc dphy_regs[] = {
+   { "VERSION",        0x000, "Host version" },
+   { "N_LANES",        0x004, "Active lanes - 1" },
+   { "RESETN",         0x008, "Host reset" },
+   { "PHY_SHUTDOWNZ",  0x040, "PHY shutdown" },
+   { "PHY_RSTZ",       0x044, "PHY reset" },
+   { "PHY_RX",         0x048, "PHY RX status" },
+   { "PHY_STOPSTATE",  0x04c, "Lanes in stop state" },
+   { "PHY_TST_CTRL0",  0x050, "Test control 0" },
+   { "PHY_TST_CTRL1",  0x054, "Test control 1" },
+};
+
+static const struct reg_desc mipicfg_regs[] = {
+   { "MIPICFG_CFG",    0x004, "Input select" },
+   { "MIPICFG_INTR",   0x028, "Raw interrupts" },
+   { "MIPICFG_INTE",   0x02c, "Interrupt enable" },
+   { "MIPICFG_INTF",   0x030, "Interrupt force" },
+   { "MIPICFG_INTS",   0x034, "Interrupt status" },
+};
+
+#define CSI2_CH_IRQ_BITS(x) \
+   { 1u << (0 + (x)),  "FS" #x,     0 }, \
+   { 1u << (4 + (x)),  "FE" #x,     0 }, \
+   { 1u << (8 + (x)),  "FE_ACK" #x, 0 }, \
+   { 1u << (12 + (x)), "LE" #x,     0 }, \
+   { 1u << (16 + (x)), "LE_ACK" #x, 0 }
+
+static const struct bit_desc csi2_status_bits[] = {
+   CSI2_CH_IRQ_BITS(0),
+   CSI2_CH_IRQ_BITS(1),
+   CSI2_CH_IRQ_BITS(2),
+   CSI2_CH_IRQ_BITS(3),
+   { 1u << 20, "OVERFLOW",          1 },
+   { 1u << 21, "DISCARD_OVERFLOW",  1 },
+   { 1u << 22, "DISCARD_LEN_LIMIT", 1 },
+   { 1u << 23, "DISCARD_UNMATCHED", 1 },
+   { 1u << 24, "DISCARD_INACTIVE",  1 },
+};
+
+static const struct bit_desc mipicfg_int_bits[] = {
+   { 1u << 0, "CSI_DMA",  0 },
+   { 1u << 2, "CSI_HOST", 0 },
+   { 1u << 4, "PISP_FE",  0 },
+};
+
+static const struct bit_desc dphy_stopstate_bits[] = {
+   { 1u << 0,  "D0", 0 },
+   { 1u << 1,  "D1", 0 },
+   { 1u << 2,  "D2", 0 },
+   { 1u << 3,  "D3", 0 },
+   { 1u << 16, "CLK", 0 },
+};
+
+static const struct bit_desc dphy_rx_bits[] = {
+   { 1u << 0,  "ULPS_D0",    0 },
+   { 1u << 1,  "ULPS_D1",    0 },
+   { 1u << 2,  "ULPS_D2",    0 },
+   { 1u << 3,  "ULPS_D3",    0 },
+   { 1u << 16, "ULPS_CLK_N", 0 },
+   { 1u << 17, "CLK_HS",     0 },
+};
+
+/* Count of discarded packets with the VC/DT of the last one */
+static int decode_csi2_discards(uint32_t v, char *buf, size_t len)
+{
+   if (!(v & 0xffffff))
+      return 0;
+   return snprintf(buf, len, "n=%u vc=%u dt=0x%02x", v & 0xffffff, v >> 30,
+                   (v >> 24) & 0x3f);
+}
+
+static int decode_csi2_ch_debug(uint32_t v, char *buf, size_t len)
+{
+   return snprintf(buf, len, "frame=%u line=%u", v >> 16, v & 0xffff);
+}
+
+static const struct sample_reg cfe_sample[] = {
+   { "STATUS",    CFE_CSI2,    0x000, csi2_status_bits, ARRAY_SIZE(csi2_status_bits), NULL },
+   { "DISC_OVF",  CFE_CSI2,    0x008, NULL, 0, decode_csi2_discards },
+   { "DISC_INA",  CFE_CSI2,    0x00c, NULL, 0, decode_csi2_discards },
+   { "DISC_UNM",  CFE_CSI2,    0x010, NULL, 0, decode_csi2_discards },
+   { "DISC_LEN",  CFE_CSI2,    0x014, NULL, 0, decode_csi2_discards },
+   { "DEBUG0",    CFE_CSI2,    0x038, NULL, 0, decode_csi2_ch_debug },
+   { "DEBUG1",    CFE_CSI2,    0x078, NULL, 0, decode_csi2_ch_debug },
+   { "FE_ID0",    CFE_CSI2,    0x048, NULL, 0, NULL },
+   { "STOPSTATE", CFE_DPHY,    0x04c, dphy_stopstate_bits, ARRAY_SIZE(dphy_stopstate_bits), NULL },
+   { "PHY_RX",    CFE_DPHY,    0x048, dphy_rx_bits, ARRAY_SIZE(dphy_rx_bits), NULL },
+   { "INTR",      CFE_MIPICFG, 0x028, mipicfg_int_bits, ARRAY_SIZE(mipicfg_int_bits), NULL },
+};
+
+static void cfe_summary(const struct target *t)
+{
+   const volatile uint32_t *csi2 = t->blocks[CFE_CSI2].map;
+   const volatile uint32_t *dphy = t->blocks[CFE_DPHY].map;
+   unsigned int ch;
+
+   printf("\n[Decoded summary]\n");
+   printf("  Data lanes       : %u\n", (dphy[0x004 / 4] & 0x3) + 1);
+   for (ch = 0; ch < 4; ch++) {
+      uint32_t ctrl = csi2[(ch * 0x40 + 0x28) / 4];
+      uint32_t size = csi2[(ch * 0x40 + 0x40) / 4];
+      uint32_t dbg = csi2[(ch * 0x40 + 0x38) / 4];
+      unsigned int dt = (ctrl >> 7) & 0x3f;
+
+      printf("  Channel %u        : %s, VC %u, DT 0x%02x = %s, mode %u, %ux%u, "
+             "stride %u, frame %u line %u\n",
+             ch, ctrl & 1 ? "enabled" : "disabled", (ctrl >> 5) & 0x3, dt, dt_name(dt),
+             (ctrl >> 1) & 0x3, size & 0xffff, size >> 16,
+             csi2[(ch * 0x40 + 0x30) / 4] << 4, dbg >> 16, dbg & 0xffff);
+   }
+}
+
+/*
+ * Targets, Pi 4 csi0/csi1 and RP1 csi0/csi1 through the Pi 5 PCIe window
+ */
+
+#define UNICAM_TARGET(n, b, d) { \
+   .name = n, .desc = d, \
+   .blocks = { { "unicam", b, 0x1000, unicam_regs, ARRAY_SIZE(unicam_regs), NULL } }, \
+   .nblocks = 1, \
+   .sample = unicam_sample, .nsample = ARRAY_SIZE(unicam_sample), \
+   .summary = unicam_summary }
+
+#define CFE_TARGET(n, b, d) { \
+   .name = n, .desc = d, \
+   .blocks = { \
+      { "csi2",    (b) + 0x00000, 0x1000, csi2_regs,    ARRAY_SIZE(csi2_regs),    NULL }, \
+      { "dphy",    (b) + 0x04000, 0x1000, dphy_regs,    ARRAY_SIZE(dphy_regs),    NULL }, \
+      { "mipicfg", (b) + 0x10000, 0x1000, mipicfg_regs, ARRAY_SIZE(mipicfg_regs), NULL } }, \
+   .nblocks = 3, \
+   .sample = cfe_sample, .nsample = ARRAY_SIZE(cfe_sample), \
+   .summary = cfe_summary }
+
+static struct target targets[] = {
+   UNICAM_TARGET("unicam1", 0xfe801000ULL, "BCM2711 unicam csi1 (camera connector)"),
+   UNICAM_TARGET("unicam0", 0xfe800000ULL, "BCM2711 unicam csi0"),
+   CFE_TARGET("cfe0", 0x1f00110000ULL, "RP1 CSI2 csi0 (CAM/DISP 0)"),
+   CFE_TARGET("cfe1", 0x1f00128000ULL, "RP1 CSI2 csi1 (CAM/DISP 1)"),
+};
+
+/*
+ * Register access
+ */
+
+static int map_target(struct target *t)
+{
+   unsigned int i;
+   int fd;
+
+   fd = open("/dev/mem", O_RDONLY | O_SYNC);
+   if (fd < 0)
+      return -errno;
+
+   for (i = 0; i < t->nblocks; i++) {
+      struct block *b = &t->blocks[i];
+      void *p;
+
+      p = mmap(NULL, b->size, PROT_READ, MAP_SHARED, fd, b->base);
+      if (p == MAP_FAILED) {
+         int err = -errno;
+
+         close(fd);
+         return err;
+      }
+      b->map = p;
+   }
+
+   close(fd);
+   return 0;
+}
+
+static void unmap_target(struct target *t)
+{
+   unsigned int i;
+
+   for (i = 0; i < t->nblocks; i++)
+      if (t->blocks[i].map)
+         munmap((void *)t->blocks[i].map, t->blocks[i].size);
+}
+
+static inline uint32_t reg_read(const struct target *t, unsigned int block, uint32_t off)
+{
+   return t->blocks[block].map[off / 4];
+}
+
+/* Space separated names of the bits set, returns the length */
+static int decode_bits(const struct bit_desc *bits, unsigned int nbits, uint32_t v,
+                       char *buf, size_t len)
+{
+   unsigned int i;
+   int n = 0;
+
+   if (len)
+      buf[0] = 0;
+   for (i = 0; i < nbits && (size_t)n < len; i++)
+      if (v & bits[i].mask)
+         n += snprintf(buf + n, len - n, "%s%s", n ? " " : "", bits[i].name);
+   return n;
+}
+
+static int decode_sample_reg(const struct sample_reg *s, uint32_t v, char *buf, size_t len)
+{
+   if (s->decode)
+      return s->decode(v, buf, len);
+   return decode_bits(s->bits, s->nbits, v, buf, len);
+}
+
+static const struct sample_reg *find_sample_reg(const struct target *t, unsigned int block,
+                                                uint32_t off)
+{
+   unsigned int i;
+
+   for (i = 0; i < t->nsample; i++)
+      if (t->sample[i].block == block && t->sample[i].off == off)
+         return &t->sample[i];
+   return NULL;
+}
+
+static void dump_target(const struct target *t)
+{
+   char dec[256];
+   unsigned int b, i;
+
+   printf("%s: %s\n", t->name, t->desc);
+   for (b = 0; b < t->nblocks; b++) {
+      const struct block *blk = &t->blocks[b];
+
+      printf("\n[%s @ 0x%010" PRIx64 "]\n", blk->name, blk->base);
+      for (i = 0; i < blk->nregs; i++) {
+         const struct reg_desc *r = &blk->regs[i];
+         const struct sample_reg *s = find_sample_reg(t, b, r->off);
+         uint32_t v = reg_read(t, b, r->off);
+
+         printf("  %-26s [+0x%03x] = 0x%08x  (%s)", r->name, r->off, v, r->desc);
+         if (s && decode_sample_reg(s, v, dec, sizeof(dec)) > 0)
+            printf("  %s", dec);
+         printf("\n");
+      }
+   }
+   t->summary(t);
+}
+
+/*
+ * Sampling
+ */
+
+struct sample {
+   uint64_t t_ns;
+   uint32_t v[MAX_SAMPLE_REGS];
+};
+
+struct sampler {
+   const struct target *t;
+   struct sample       *ring;
+   unsigned int         ring_size;
+   uint64_t             period_ns;
+   uint64_t             count;     /* Samples to take, 0 until stopped */
+   int                  trigger;   /* Flight recorder: stop after an error */
+
+   _Atomic uint64_t     head;      /* Written by the sampler */
+   _Atomic uint64_t     tail;      /* Written by the writer */
+   _Atomic int          done;
+
+   /* Sampler statistics */
+   uint64_t             late;
+   uint64_t             lost;
+   uint64_t             max_interval_ns;
+   uint64_t             trigger_index;
+   int                  triggered;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void wait_until(uint64_t deadline, uint64_t period_ns)
+{
+   struct timespec ts;
+
+   if (period_ns < SPIN_PERIOD_NS) {
+      while (now_ns() < deadline)
+         ;
+      return;
+   }
+   ts.tv_sec = deadline / NSEC_PER_SEC;
+   ts.tv_nsec = deadline % NSEC_PER_SEC;
+   while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !quit)
+      ;
+}
+
+static int sample_has_error(const struct target *t, const struct sample *s)
+{
+   unsigned int i, j;
+
+   for (i = 0; i < t->nsample; i++)
+      for (j = 0; j < t->sample[i].nbits; j++)
+         if (t->sample[i].bits[j].error && (s->v[i] & t->sample[i].bits[j].mask))
+            return 1;
+   return 0;
+}
+
+static void *sampler_thread(void *arg)
+{
+   struct sampler *sp = arg;
+   const struct target *t = sp->t;
+   uint64_t head = 0;
+   uint64_t stop_at = 0;
+   uint64_t next, prev = 0;
+   unsigned int i;
+
+   next = now_ns();
+   while (!quit && (!sp->count || head < sp->count)) {
+      struct sample *s;
+      uint64_t ts;
+
+      wait_until(next, sp->period_ns);
+
+      /* Streaming: never overwrite what the writer hasn't consumed */
+      if (!sp->trigger &&
+          head - atomic_load_explicit(&sp->tail, memory_order_acquire) >= sp->ring_size) {
+         sp->lost++;
+      } else {
+         s = &sp->ring[head % sp->ring_size];
+         ts = now_ns();
+         for (i = 0; i < t->nsample; i++)
+            s->v[i] = reg_read(t, t->sample[i].block, t->sample[i].off);
+         s->t_ns = ts;
+
+         if (prev && ts - prev > sp->max_interval_ns)
+            sp->max_interval_ns = ts - prev;
+         prev = ts;
+
+         /* Keep half a ring after the first error, the rest before it */
+         if (sp->trigger && !sp->triggered && sample_has_error(t, s)) {
+            sp->triggered = 1;
+            sp->trigger_index = head;
+            stop_at = head + sp->ring_size / 2;
+         }
+
+         head++;
+         atomic_store_explicit(&sp->head, head, memory_order_release);
+         if (sp->triggered && head >= stop_at)
+            break;
+      }
+
+      next += sp->period_ns;
+      ts = now_ns();
+      if (ts > next + sp->period_ns) {
+         /* Too late: skip the missed periods instead of bursting */
+         sp->late += (ts - next) / sp->period_ns;
+         next += (ts - next) / sp->period_ns * sp->period_ns;
+      }
+   }
+
+   atomic_store_explicit(&sp->done, 1, memory_order_release);
+   return NULL;
+}
+
+static void write_header(FILE *out, const struct sampler *sp)
+{
+   const struct target *t = sp->t;
+   unsigned int i;
+
+   fprintf(out, "# csi-regs %s @ 0x%010" PRIx64 ", %" PRIu64 " ns period, CLOCK_MONOTONIC\n",
+           t->name, t->blocks[0].base, sp->period_ns);
+   fprintf(out, "t_ns");
+   for (i = 0; i < t->nsample; i++)
+      fprintf(out, ",%s", t->sample[i].name);
+   fprintf(out, ",decoded\n");
+}
+
+/* Counts of samples with each bit set, for the end report */
+struct bit_counts {
+   uint64_t n[MAX_SAMPLE_REGS][32];
+};
+
+static void count_bits(const struct target *t, const struct sample *s, struct bit_counts *counts)
+{
+   unsigned int i, j;
+
+   for (i = 0; i < t->nsample; i++)
+      for (j = 0; j < t->sample[i].nbits; j++)
+         if (s->v[i] & t->sample[i].bits[j].mask)
+            counts->n[i][j]++;
+}
+
+static void write_sample(FILE *out, const struct target *t, const struct sample *s)
+{
+   char dec[256];
+   unsigned int i;
+   int first = 1;
+
+   fprintf(out, "%" PRIu64, s->t_ns);
+   for (i = 0; i < t->nsample; i++)
+      fprintf(out, ",0x%08x", s->v[i]);
+   fprintf(out, ",");
+   for (i = 0; i < t->nsample; i++) {
+      const struct sample_reg *r = &t->sample[i];
+
+      if (decode_sample_reg(r, s->v[i], dec, sizeof(dec)) > 0) {
+         fprintf(out, "%s%s[%s]", first ? "" : " ", r->name, dec);
+         first = 0;
+      }
+   }
+   fprintf(out, "\n");
+}
+
+static int same_values(const struct target *t, const struct sample *a, const struct sample *b)
+{
+   return !memcmp(a->v, b->v, t->nsample * sizeof(a->v[0]));
+}
+
+static void report(const struct sampler *sp, const struct bit_counts *counts, uint64_t samples,
+                   uint64_t written, uint64_t elapsed_ns)
+{
+   const struct target *t = sp->t;
+   unsigned int i, j;
+
+   fprintf(stderr, "%" PRIu64 " samples (%.0f/s), %" PRIu64 " written, %" PRIu64 " late, %"
+           PRIu64 " lost, max interval %.1f us\n",
+           samples, elapsed_ns ? samples * 1e9 / elapsed_ns : 0.0, written, sp->late, sp->lost,
+           sp->max_interval_ns / 1000.0);
+   for (i = 0; i < t->nsample; i++)
+      for (j = 0; j < t->sample[i].nbits; j++)
+         if (t->sample[i].bits[j].error && counts->n[i][j])
+            fprintf(stderr, "  %s %s: %" PRIu64 " samples\n", t->sample[i].name,
+                    t->sample[i].bits[j].name, counts->n[i][j]);
+}
+
+static int run_sampler(struct sampler *sp, FILE *out, int changes_only, int rt_prio)
+{
+   static struct bit_counts counts;
+   const struct target *t = sp->t;
+   struct sample last;
+   uint64_t written = 0;
+   uint64_t start, tail = 0, head, first;
+   pthread_attr_t attr;
+   pthread_t thread;
+   int have_last = 0;
+   int ret;
+
+   pthread_attr_init(&attr);
+   if (rt_prio) {
+      struct sched_param param = { .sched_priority = rt_prio };
+
+      pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+      pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+      pthread_attr_setschedparam(&attr, &param);
+   }
+
+   write_header(out, sp);
+   start = now_ns();
+   ret = pthread_create(&thread, &attr, sampler_thread, sp);
+   pthread_attr_destroy(&attr);
+   if (ret)
+      return -ret;
+
+   /*
+    * Streaming: drain the ring as it fills. Flight recorder: only write the
+    * ring once the sampler has stopped, around the first error.
+    */
+   for (;;) {
+      int done = atomic_load_explicit(&sp->done, memory_order_acquire);
+
+      head = atomic_load_explicit(&sp->head, memory_order_acquire);
+      if (sp->trigger) {
+         if (!done) {
+            usleep(10000);
+            continue;
+         }
+         tail = head > sp->ring_size ? head - sp->ring_size : 0;
+      }
+
+      for (; tail < head; tail++) {
+         const struct sample *s = &sp->ring[tail % sp->ring_size];
+
+         count_bits(t, s, &counts);
+         if (changes_only && have_last && same_values(t, s, &last))
+            continue;
+         write_sample(out, t, s);
+         last = *s;
+         have_last = 1;
+         written++;
+      }
+      atomic_store_explicit(&sp->tail, tail, memory_order_release);
+
+      if (done)
+         break;
+      fflush(out);
+      usleep(10000);
+   }
+
+   pthread_join(thread, NULL);
+   fflush(out);
+
+   first = head > sp->ring_size && sp->trigger ? head - sp->ring_size : 0;
+   if (sp->trigger) {
+      if (sp->triggered)
+         fprintf(stderr, "error at sample %" PRIu64 ", %" PRIu64 " samples before it written\n",
+                 sp->trigger_index, sp->trigger_index - first);
+      else
+         fprintf(stderr, "no error seen, last %" PRIu64 " samples written\n", head - first);
+   }
+   report(sp, &counts, head, written, now_ns() - start);
+   return 0;
+}
+
+static void usage(void)
+{
+   unsigned int i;
+
+   fprintf(stderr,
+      "Usage: csi-regs [-b BLOCK] [-s HZ] [-t SECONDS | -n SAMPLES] [-r RING] [-o FILE] [-c] [-e] [-p PRIO]\n"
+      "  -b BLOCK    receiver to inspect (default: unicam1 on Pi 4, cfe0 on Pi 5)\n"
+      "  -s HZ       sample at HZ instead of dumping once\n"
+      "  -t SECONDS  stop sampling after SECONDS (default: until interrupted)\n"
+      "  -n SAMPLES  stop sampling after SAMPLES\n"
+      "  -r RING     ring buffer size in samples (default: 65536)\n"
+      "  -o FILE     trace output (default: stdout)\n"
+      "  -c          write the samples that differ from the previous one only\n"
+      "  -e          flight recorder: stop half a ring after the first error and\n"
+      "              write the ring (samples around the error)\n"
+      "  -p PRIO     SCHED_FIFO priority of the sampling thread\n"
+      "Blocks:\n");
+   for (i = 0; i < ARRAY_SIZE(targets); i++)
+      fprintf(stderr, "  %-10s  %s\n", targets[i].name, targets[i].desc);
+}
+
+/* Pi 5 has the RP1, Pi 4 the BCM2711 */
+static const char *default_target(void)
+{
+   char model[128] = "";
+   FILE *f = fopen("/proc/device-tree/model", "r");
+
+   if (f) {
+      if (!fgets(model, sizeof(model), f))
+         model[0] = 0;
+      fclose(f);
+   }
+   return strstr(model, "Raspberry Pi 5") || strstr(model, "Compute Module 5") ?
+          "cfe0" : "unicam1";
+}
+
+int main(int argc, char **argv)
+{
+   struct sampler sp = { 0 };
+   const char *name = NULL;
+   const char *output = NULL;
+   struct target *t = NULL;
+   unsigned long hz = 0;
+   double seconds = 0;
+   int changes_only = 0;
+   int rt_prio = 0;
+   FILE *out = stdout;
+   unsigned int i;
+   int ret;
+   int opt;
+
+   sp.ring_size = 65536;
+   while ((opt = getopt(argc, argv, "b:s:t:n:r:o:cep:h")) != -1) {
+      switch (opt) {
+      case 'b':
+         name = optarg;
+         break;
+      case 's':
+         hz = strtoul(optarg, NULL, 0);
+         break;
+      case 't':
+         seconds = strtod(optarg, NULL);
+         break;
+      case 'n':
+         sp.count = strtoull(optarg, NULL, 0);
+         break;
+      case 'r':
+         sp.ring_size = strtoul(optarg, NULL, 0);
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      case 'c':
+         changes_only = 1;
+         break;
+      case 'e':
+         sp.trigger = 1;
+         break;
+      case 'p':
+         rt_prio = strtol(optarg, NULL, 0);
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   if (!name)
+      name = default_target();
+   for (i = 0; i < ARRAY_SIZE(targets); i++)
+      if (!strcmp(targets[i].name, name))
+         t = &targets[i];
+   if (!t || sp.ring_size < 2 || (optind < argc)) {
+      usage();
+      return 1;
+   }
+
+   ret = map_target(t);
+   if (ret) {
+      fprintf(stderr, "csi-regs: /dev/mem: %s%s\n", strerror(-ret),
+              ret == -EACCES || ret == -EPERM ?
+              " (run as root, the kernel may also need iomem=relaxed)" : "");
+      return 1;
+   }
+
+   if (!hz) {
+      dump_target(t);
+      unmap_target(t);
+      return 0;
+   }
+
+   if (output && strcmp(output, "-")) {
+      out = fopen(output, "w");
+      if (!out) {
+         perror(output);
+         unmap_target(t);
+         return 1;
+      }
+   }
+
+   sp.t = t;
+   sp.period_ns = NSEC_PER_SEC / hz;
+   if (seconds > 0 && !sp.count)
+      sp.count = (uint64_t)(seconds * hz);
+   sp.ring = calloc(sp.ring_size, sizeof(*sp.ring));
+   if (!sp.ring) {
+      fprintf(stderr, "csi-regs: out of memory\n");
+      unmap_target(t);
+      return 1;
+   }
+   /* Fault the ring in now, not in the sampling loop */
+   mlockall(MCL_CURRENT | MCL_FUTURE);
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+
+   ret = run_sampler(&sp, out, changes_only, rt_prio);
+   if (ret)
+      fprintf(stderr, "csi-regs: sampler: %s\n", strerror(-ret));
+
+   if (out != stdout)
+      fclose(out);
+   free(sp.ring);
+   unmap_target(t);
+   return ret ? 1 : 0;
+}
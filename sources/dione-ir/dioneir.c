@@ -19,6 +19,7 @@
 #include <media/v4l2-event.h>
 #include <media/v4l2-fwnode.h>
 #include <media/v4l2-mediabus.h>
+#include <media/mipi-csi2.h>
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6,12,0)
 #include <asm/unaligned.h>
 #else
@@ -27,9 +28,12 @@
 #include <linux/of_graph.h>
 #include <linux/regmap.h>
 #include <linux/clk.h>
+#include <linux/crc32.h>
+#include <linux/sched/signal.h>
 
 #include "tc358746_regs.h"
 #include "tc358746_calculation.h"
+#include "dioneir_ioctl.h"
 
 //#define DBG_TC358746
 
@@ -43,6 +47,29 @@
 #define DIONE_IR_REG_ACQUISITION_SRC	0x00080108
 #define DIONE_IR_REG_ACQUISITION_STAT	0x0008010c
 
+/* File access (SFNC FileAccessControl) */
+#define DIONE_IR_REG_FILE_SELECTOR		0x10010000
+#define DIONE_IR_REG_FILE_OPEN_MODE		0x10010004
+#define DIONE_IR_REG_FILE_OP_SELECTOR		0x10010008
+#define DIONE_IR_REG_FILE_OP_EXECUTE		0x1001000c
+#define DIONE_IR_REG_FILE_OP_STATUS		0x10010010
+#define DIONE_IR_REG_FILE_SIZE			0x10010018
+#define DIONE_IR_REG_FILE_ACCESS_OFFSET	0x1001001c
+#define DIONE_IR_REG_FILE_ACCESS_LENGTH	0x10010020
+#define DIONE_IR_REG_FILE_ACCESS_BUFFER	0x10011000
+
+#define DIONE_IR_FILE_OP_OPEN		0
+#define DIONE_IR_FILE_OP_CLOSE		1
+#define DIONE_IR_FILE_OP_READ		2
+#define DIONE_IR_FILE_OP_WRITE		3
+#define DIONE_IR_FILE_STATUS_BUSY	2
+#define DIONE_IR_FILE_OP_TMO_MS		5000
+
+#define DIONE_IR_FILE_BUFFER_SIZE	4096
+/* Largest register access in one I2C message */
+#define DIONE_IR_I2C_XFER_MAX		1000
+#define DIONE_IR_FILE_XFER_MSGS		DIV_ROUND_UP(DIONE_IR_FILE_BUFFER_SIZE, DIONE_IR_I2C_XFER_MAX)
+
 /* #define DIONE_IR_I2C_TMO_MS		5 */
 /* #define DIONE_IR_STARTUP_TMO_MS		1500 */
 /* #define DIONE_IR_HAS_SYSFS		1 */
@@ -52,8 +79,12 @@
 
 static int test_mode = 0;
 static int quick_mode = 1;
+/* File transfers: FileAccessBuffer writes in one i2c_transfer() */
+static int file_batch = 1;
 module_param(test_mode, int, 0644);
 module_param(quick_mode, int, 0644);
+module_param(file_batch, int, 0644);
+MODULE_PARM_DESC(file_batch, "Batch the FileAccessBuffer I2C writes of a file transfer (default 1)");
 
 s64 link_freq_menu_items[1];
 
@@ -81,6 +112,9 @@ struct dione_ir_i2c_client {
    int chnod_major_number;
    dev_t chnod_device_number;
    struct class *pClass_chnod;
+   /* File transfer progress in bytes, file_progress in sysfs */
+   u32 file_done;
+   u32 file_total;
 };
 
 struct dione_ir_i2c_client i2c_clients[MAX_I2C_CLIENTS_NUMBER];
@@ -928,6 +962,352 @@ static int dione_ir_set_mode(struct dione_ir *priv)
 	return err;
 }
 
+/*
+ * File transfers through the FileAccessBuffer
+ */
+
+struct dione_ir_file_ctx {
+   struct dione_ir_i2c_client *chnod;
+   struct i2c_client *client;
+   u8 *data;      /* One FileAccessBuffer */
+   u8 *msg_buf;   /* I2C messages: address, length and payload */
+   int op;        /* FileOperationSelector, -1 unknown */
+};
+
+/*
+ * Access the FileAccessBuffer in DIONE_IR_I2C_XFER_MAX pieces. The writes
+ * are all sent in one i2c_transfer() unless file_batch is 0. Each read is
+ * its own header write + read transfer: adapters like i2c-bcm2835 (Pi 4)
+ * only take a single read message per transfer, as the last one.
+ */
+static int dione_ir_file_buffer_write(struct dione_ir_file_ctx *ctx, const u8 *src, u32 len)
+{
+   struct i2c_msg msgs[DIONE_IR_FILE_XFER_MSGS];
+   u32 ofs;
+   int n = 0;
+   int i;
+
+   for (ofs = 0; ofs < len; ofs += DIONE_IR_I2C_XFER_MAX, n++)
+   {
+      u32 size = min_t(u32, len - ofs, DIONE_IR_I2C_XFER_MAX);
+      u8 *tx = ctx->msg_buf + n * (6 + DIONE_IR_I2C_XFER_MAX);
+
+      put_unaligned_le32(DIONE_IR_REG_FILE_ACCESS_BUFFER + ofs, tx);
+      put_unaligned_le16(size, tx + 4);
+      memcpy(tx + 6, src + ofs, size);
+
+      msgs[n].addr = ctx->client->addr;
+      msgs[n].flags = 0;
+      msgs[n].len = 6 + size;
+      msgs[n].buf = tx;
+   }
+
+   if (file_batch)
+      return i2c_transfer(ctx->client->adapter, msgs, n) == n ? 0 : -EIO;
+
+   for (i = 0; i < n; i++)
+      if (i2c_transfer(ctx->client->adapter, &msgs[i], 1) != 1)
+         return -EIO;
+   return 0;
+}
+
+static int dione_ir_file_buffer_read(struct dione_ir_file_ctx *ctx, u8 *dst, u32 len)
+{
+   struct i2c_msg msgs[2 * DIONE_IR_FILE_XFER_MSGS];
+   u8 headers[DIONE_IR_FILE_XFER_MSGS][6];
+   u32 ofs;
+   int n = 0;
+   int i;
+
+   for (ofs = 0; ofs < len; ofs += DIONE_IR_I2C_XFER_MAX, n++)
+   {
+      u32 size = min_t(u32, len - ofs, DIONE_IR_I2C_XFER_MAX);
+
+      put_unaligned_le32(DIONE_IR_REG_FILE_ACCESS_BUFFER + ofs, headers[n]);
+      put_unaligned_le16(size, headers[n] + 4);
+
+      msgs[2 * n].addr = ctx->client->addr;
+      msgs[2 * n].flags = 0;
+      msgs[2 * n].len = 6;
+      msgs[2 * n].buf = headers[n];
+
+      /* Two status bytes before the data */
+      msgs[2 * n + 1].addr = ctx->client->addr;
+      msgs[2 * n + 1].flags = I2C_M_RD;
+      msgs[2 * n + 1].len = 2 + size;
+      msgs[2 * n + 1].buf = ctx->msg_buf + n * (6 + DIONE_IR_I2C_XFER_MAX);
+   }
+
+   for (i = 0; i < n; i++)
+      if (i2c_transfer(ctx->client->adapter, &msgs[2 * i], 2) != 2)
+         return -EIO;
+
+   for (i = 0; i < n; i++)
+   {
+      const u8 *rx = msgs[2 * i + 1].buf;
+
+      if (rx[0] != 0 || rx[1] != 0)
+         return -EINVAL;
+      memcpy(dst + i * DIONE_IR_I2C_XFER_MAX, rx + 2, msgs[2 * i + 1].len - 2);
+   }
+
+   return 0;
+}
+
+/* Set FileOperationSelector, unless it already holds <op> */
+static int dione_ir_file_select(struct dione_ir_file_ctx *ctx, int op)
+{
+   int err;
+
+   if (op == ctx->op)
+      return 0;
+
+   err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_OP_SELECTOR, op);
+   if (!err)
+      ctx->op = op;
+   return err;
+}
+
+/* Execute a file operation and poll its status until done */
+static int dione_ir_file_exec(struct dione_ir_file_ctx *ctx, int op)
+{
+   ktime_t timeout = ktime_add_ms(ktime_get(), DIONE_IR_FILE_OP_TMO_MS);
+   u32 status;
+   int err;
+
+   err = dione_ir_file_select(ctx, op);
+   if (err)
+      return err;
+
+   err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_OP_EXECUTE, 1);
+   if (err)
+      return err;
+
+   for (;;)
+   {
+      err = dione_ir_i2c_read(ctx->client, DIONE_IR_REG_FILE_OP_STATUS,
+                              (u8 *)&status, sizeof(status));
+      if (err)
+         return err;
+      if (status != DIONE_IR_FILE_STATUS_BUSY)
+         break;
+      if (ktime_after(ktime_get(), timeout))
+         return -ETIMEDOUT;
+      usleep_range(500, 1000);
+   }
+
+   return status ? -EIO : 0;
+}
+
+static int dione_ir_file_open(struct dione_ir_file_ctx *ctx, u32 index, int write, u32 *size)
+{
+   u32 sel;
+   int err;
+
+   // Files can't be accessed while acquiring
+   err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_ACQUISITION_STOP, 2);
+   if (!err)
+      err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_SELECTOR, index);
+   if (!err)
+      err = dione_ir_i2c_read(ctx->client, DIONE_IR_REG_FILE_SELECTOR, (u8 *)&sel, sizeof(sel));
+   if (!err && sel != index)
+      err = -ENOENT;
+   if (!err)
+      err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_OPEN_MODE, write ? 1 : 0);
+   if (!err)
+      err = dione_ir_file_exec(ctx, DIONE_IR_FILE_OP_OPEN);
+   if (!err)
+      err = dione_ir_i2c_read(ctx->client, DIONE_IR_REG_FILE_SIZE, (u8 *)size, sizeof(*size));
+
+   return err;
+}
+
+static int dione_ir_file_access(struct dione_ir_file_ctx *ctx, int op, u32 offset, u32 len)
+{
+   int err;
+
+   err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_ACCESS_OFFSET, offset);
+   if (!err)
+      err = dione_ir_i2c_write32(ctx->client, DIONE_IR_REG_FILE_ACCESS_LENGTH, len);
+   if (!err)
+      err = dione_ir_file_exec(ctx, op);
+
+   return err;
+}
+
+/*
+ * Read <len> bytes at <offset> of the open file, to user memory when
+ * <user> isn't NULL, and update the CRC-32.
+ */
+static int dione_ir_file_read_range(struct dione_ir_file_ctx *ctx, u32 offset, u32 len,
+                                    u8 __user *user, u32 *crc, u32 *done)
+{
+   int err = 0;
+
+   while (*done < len)
+   {
+      u32 size = min_t(u32, len - *done, DIONE_IR_FILE_BUFFER_SIZE);
+
+      if (fatal_signal_pending(current))
+         return -EINTR;
+
+      err = dione_ir_file_access(ctx, DIONE_IR_FILE_OP_READ, offset + *done, size);
+      if (!err)
+         err = dione_ir_file_buffer_read(ctx, ctx->data, size);
+      if (err)
+         break;
+
+      if (user && copy_to_user(user + *done, ctx->data, size))
+         return -EFAULT;
+
+      *crc = crc32_le(*crc, ctx->data, size);
+      *done += size;
+      WRITE_ONCE(ctx->chnod->file_done, READ_ONCE(ctx->chnod->file_done) + size);
+   }
+
+   return err;
+}
+
+static int dione_ir_file_write_range(struct dione_ir_file_ctx *ctx, u32 offset, u32 len,
+                                     const u8 __user *user, u32 *crc, u32 *done)
+{
+   int err;
+
+   // Select WRITE before loading the first chunk, as the selector is still
+   // at OPEN after dione_ir_file_open()
+   err = dione_ir_file_select(ctx, DIONE_IR_FILE_OP_WRITE);
+   if (err)
+      return err;
+
+   while (*done < len)
+   {
+      u32 size = min_t(u32, len - *done, DIONE_IR_FILE_BUFFER_SIZE);
+
+      if (fatal_signal_pending(current))
+         return -EINTR;
+
+      if (copy_from_user(ctx->data, user + *done, size))
+         return -EFAULT;
+
+      // The write operation takes the data from the FileAccessBuffer
+      err = dione_ir_file_buffer_write(ctx, ctx->data, size);
+      if (!err)
+         err = dione_ir_file_access(ctx, DIONE_IR_FILE_OP_WRITE, offset + *done, size);
+      if (err)
+         break;
+
+      *crc = crc32_le(*crc, ctx->data, size);
+      *done += size;
+      WRITE_ONCE(ctx->chnod->file_done, READ_ONCE(ctx->chnod->file_done) + size);
+   }
+
+   return err;
+}
+
+static int dione_ir_file_xfer(struct dione_ir_i2c_client *chnod, int write,
+                              struct dione_ir_file_xfer *xfer)
+{
+   struct device *dev = &chnod->i2c_client->dev;
+   struct dione_ir_file_ctx ctx = {
+      .chnod = chnod,
+      .client = chnod->i2c_client,
+      .op = -1,
+   };
+   u8 __user *user = u64_to_user_ptr(xfer->data);
+   ktime_t start = ktime_get();
+   u32 crc = ~0;
+   u32 done = 0;
+   u32 size;
+   s64 us;
+   int err, err_close;
+
+   xfer->crc32 = 0;
+   xfer->verify_crc32 = 0;
+   xfer->transferred = 0;
+   xfer->file_size = 0;
+   if (xfer->flags & ~DIONE_IR_FILE_VERIFY)
+      return -EINVAL;
+
+   ctx.data = kmalloc(DIONE_IR_FILE_BUFFER_SIZE, GFP_KERNEL);
+   ctx.msg_buf = kmalloc(DIONE_IR_FILE_XFER_MSGS * (6 + DIONE_IR_I2C_XFER_MAX), GFP_KERNEL);
+   if (!ctx.data || !ctx.msg_buf)
+   {
+      err = -ENOMEM;
+      goto out_free;
+   }
+
+   err = dione_ir_file_open(&ctx, xfer->file_index, write, &size);
+   if (err)
+   {
+      dev_err(dev, "%s : Failed to open file %u, err %d\n", __func__, xfer->file_index, err);
+      goto out_free;
+   }
+   xfer->file_size = size;
+
+   if (!write && !xfer->length && xfer->offset < size)
+      xfer->length = size - xfer->offset;
+   // No buffer: only the size of the file is wanted
+   if (!xfer->data)
+      xfer->length = 0;
+
+   WRITE_ONCE(chnod->file_done, 0);
+   WRITE_ONCE(chnod->file_total, xfer->length * ((write && (xfer->flags & DIONE_IR_FILE_VERIFY)) ? 2 : 1));
+
+   if (write)
+      err = dione_ir_file_write_range(&ctx, xfer->offset, xfer->length, user, &crc, &done);
+   else
+      err = dione_ir_file_read_range(&ctx, xfer->offset, xfer->length, user, &crc, &done);
+
+   xfer->crc32 = ~crc;
+   xfer->transferred = done;
+
+   err_close = dione_ir_file_exec(&ctx, DIONE_IR_FILE_OP_CLOSE);
+   if (!err)
+      err = err_close;
+   if (err)
+   {
+      dev_err(dev, "%s : File %u %s failed at offset %u, err %d\n", __func__,
+              xfer->file_index, write ? "write" : "read", xfer->offset + done, err);
+      goto out_free;
+   }
+
+   // Read the upload back and compare the checksums, no data to userspace
+   if (write && (xfer->flags & DIONE_IR_FILE_VERIFY))
+   {
+      crc = ~0;
+      done = 0;
+      err = dione_ir_file_open(&ctx, xfer->file_index, 0, &size);
+      if (!err)
+      {
+         err = dione_ir_file_read_range(&ctx, xfer->offset, xfer->length, NULL, &crc, &done);
+         err_close = dione_ir_file_exec(&ctx, DIONE_IR_FILE_OP_CLOSE);
+         if (!err)
+            err = err_close;
+      }
+      xfer->verify_crc32 = ~crc;
+      if (!err && xfer->verify_crc32 != xfer->crc32)
+         err = -EBADMSG;
+      if (err)
+      {
+         dev_err(dev, "%s : File %u verify failed, crc 0x%08x read back 0x%08x, err %d\n",
+                 __func__, xfer->file_index, xfer->crc32, xfer->verify_crc32, err);
+         goto out_free;
+      }
+   }
+
+   us = ktime_us_delta(ktime_get(), start);
+   if (xfer->transferred)
+      dev_info(dev, "file %u: %s %u bytes in %lld ms (%lld B/s), crc32 0x%08x%s\n",
+               xfer->file_index, write ? "wrote" : "read", xfer->transferred, us / 1000,
+               us ? div64_s64((s64)xfer->transferred * USEC_PER_SEC, us) : 0, xfer->crc32,
+               (write && (xfer->flags & DIONE_IR_FILE_VERIFY)) ? ", verified" : "");
+
+out_free:
+   kfree(ctx.msg_buf);
+   kfree(ctx.data);
+   return err;
+}
+
 static ssize_t dione_ir_chnod_read(
       struct file *file_ptr
       , char __user *user_buffer
@@ -1063,6 +1443,49 @@ int dione_ir_chnod_release (struct inode * pInode, struct file * file)
    return -EINVAL;
 }
 
+static long dione_ir_chnod_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+   struct dione_ir_file_xfer xfer;
+   long ret;
+   int i;
+
+   switch (cmd) {
+      case DIONE_IR_FILE_WRITE:
+      case DIONE_IR_FILE_READ:
+         {
+            for (i = 0; i < MAX_I2C_CLIENTS_NUMBER; i++)
+            {
+               if (strcmp(i2c_clients[i].chnod_name, file->f_path.dentry->d_name.name) == 0)
+                  break;
+            }
+            if (i == MAX_I2C_CLIENTS_NUMBER)
+               return -EINVAL;
+
+            if (copy_from_user(&xfer, (void __user *)arg, sizeof(xfer)))
+               return -EFAULT;
+
+            ret = dione_ir_file_xfer(&i2c_clients[i], cmd == DIONE_IR_FILE_WRITE, &xfer);
+
+            // Counts and checksums are returned on errors too
+            if (copy_to_user((void __user *)arg, &xfer, sizeof(xfer)))
+               return -EFAULT;
+            return ret;
+         }
+      default:
+         {
+            return -ENOTTY;
+         }
+   }
+}
+
+static ssize_t file_progress_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+   struct dione_ir_i2c_client *chnod = dev_get_drvdata(dev);
+
+   return sysfs_emit(buf, "%u %u\n", READ_ONCE(chnod->file_done), READ_ONCE(chnod->file_total));
+}
+static DEVICE_ATTR_RO(file_progress);
+
 static struct file_operations dione_ir_chnod_register_fops = 
 {
    .owner   = THIS_MODULE,
@@ -1070,6 +1493,8 @@ static struct file_operations dione_ir_chnod_register_fops =
    .write   = dione_ir_chnod_write,
    .open    = dione_ir_chnod_open,
    .release = dione_ir_chnod_release,
+   .unlocked_ioctl = dione_ir_chnod_ioctl,
+   .compat_ioctl = compat_ptr_ioctl,
 };
 
 static inline int dione_ir_chnod_register_device(int i2c_ind)
@@ -1098,12 +1523,14 @@ static inline int dione_ir_chnod_register_device(int i2c_ind)
       return -EIO;
    }
 
-   if (IS_ERR(pDev = device_create(i2c_clients[i2c_ind].pClass_chnod, NULL, i2c_clients[i2c_ind].chnod_device_number, NULL, i2c_clients[i2c_ind].chnod_name))) {
+   if (IS_ERR(pDev = device_create(i2c_clients[i2c_ind].pClass_chnod, NULL, i2c_clients[i2c_ind].chnod_device_number, &i2c_clients[i2c_ind], i2c_clients[i2c_ind].chnod_name))) {
       printk(KERN_WARNING "Can't create device /dev/%s\n", i2c_clients[i2c_ind].chnod_name);
       class_destroy(i2c_clients[i2c_ind].pClass_chnod);
       unregister_chrdev_region(i2c_clients[i2c_ind].chnod_device_number, 1);
       return -EIO;
    }
+   if (device_create_file(pDev, &dev_attr_file_progress))
+      printk(KERN_WARNING "Can't create file_progress for /dev/%s\n", i2c_clients[i2c_ind].chnod_name);
    return 0;
 }
 
@@ -1507,6 +1934,41 @@ static int dione_ir_get_selection(struct v4l2_subdev *sd,
    return -EINVAL;
 }
 
+static int dione_ir_get_frame_desc(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_frame_desc *fd)
+{
+   struct dione_ir *dione_ir = to_dione_ir(sd);
+
+   if (pad)
+      return -EINVAL;
+
+   /* The TC358746 sends a single RGB888 stream on virtual channel 0 */
+   memset(fd, 0, sizeof(*fd));
+   fd->type = V4L2_MBUS_FRAME_DESC_TYPE_CSI2;
+   fd->num_entries = 1;
+   fd->entry[0].pixelcode = dione_ir->fmt.code;
+   fd->entry[0].bus.csi2.vc = 0;
+   fd->entry[0].bus.csi2.dt = MIPI_CSI2_DT_RGB888;
+
+   return 0;
+}
+
+static int dione_ir_get_mbus_config(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_config *config)
+{
+   if (pad)
+      return -EINVAL;
+
+   /* Lanes and clock mode the TC358746 is programmed with, from the DT */
+   memset(config, 0, sizeof(*config));
+   config->type = V4L2_MBUS_CSI2_DPHY;
+   config->bus.mipi_csi2.num_data_lanes =
+      dione_ir_ep_cfg.bus.mipi_csi2.num_data_lanes;
+   config->bus.mipi_csi2.flags = dione_ir_ep_cfg.bus.mipi_csi2.flags;
+
+   return 0;
+}
+
 static int dione_ir_set_stream(struct v4l2_subdev *sd, int enable)
 {
    struct dione_ir *priv = to_dione_ir(sd);
@@ -1605,6 +2067,8 @@ static const struct v4l2_subdev_pad_ops dione_ir_pad_ops = {
    .get_selection       = dione_ir_get_selection,
    .enum_frame_size     = dione_ir_enum_frame_size,
    .enum_frame_interval = dione_ir_enum_frame_interval,
+   .get_frame_desc      = dione_ir_get_frame_desc,
+   .get_mbus_config     = dione_ir_get_mbus_config,
 };
 
 static const struct v4l2_subdev_ops sensor_subdev_ops = {
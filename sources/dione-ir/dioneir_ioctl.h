@@ -0,0 +1,55 @@
+/**
+ * dioneir_ioctl.h
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ * ioctls of the Dione chnod (/dev/dione_ir-i2c-<bus>-<addr>-<fpga>).
+ */
+
+#ifndef __DIONEIR_IOCTL__
+#define __DIONEIR_IOCTL__
+
+#if defined(__KERNEL__)
+#include <linux/types.h>
+#include <linux/ioctl.h>
+#else
+#include <linux/types.h>
+#include <sys/ioctl.h>
+#endif
+
+/*
+ * Whole file transfer through the FileAccessBuffer, done in the driver:
+ * the buffer is filled with batched I2C transfers and the file operations
+ * are polled without the fixed sleeps of the register-level tools.
+ *
+ * DIONE_IR_FILE_WRITE uploads <length> bytes of <data> at <offset> of file
+ * <file_index>, DIONE_IR_FILE_READ downloads them (<length> 0 reads up to
+ * the end of the file, <data> 0 only returns <file_size>). Acquisition is
+ * stopped first, as for any file operation. <crc32> returns the CRC-32
+ * (zlib) of the data transferred.
+ *
+ * With DIONE_IR_FILE_VERIFY an upload is read back in the driver and its
+ * CRC-32 returned in <verify_crc32>; a mismatch fails with EBADMSG.
+ *
+ * Progress is readable while the ioctl runs from the file_progress
+ * attribute of the chnod in sysfs: "<done> <total>" in bytes.
+ */
+
+#define DIONE_IR_FILE_VERIFY   (1 << 0)
+
+struct dione_ir_file_xfer {
+   __u64 data;           /* User buffer */
+   __u32 file_index;     /* FileSelector */
+   __u32 offset;         /* Start offset in the Dione file */
+   __u32 length;         /* Bytes to transfer */
+   __u32 flags;          /* DIONE_IR_FILE_* */
+   __u32 crc32;          /* Out: CRC-32 of the data transferred */
+   __u32 verify_crc32;   /* Out: CRC-32 read back (DIONE_IR_FILE_VERIFY) */
+   __u32 file_size;      /* Out: file size reported at open */
+   __u32 transferred;    /* Out: bytes transferred */
+};
+
+#define DIONE_IR_FILE_WRITE    _IOWR('d', 0x10, struct dione_ir_file_xfer)
+#define DIONE_IR_FILE_READ     _IOWR('d', 0x11, struct dione_ir_file_xfer)
+
+#endif // __DIONEIR_IOCTL__
@@ -14,12 +14,14 @@
 #include <linux/delay.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
+#include <linux/property.h>
 #include <linux/regulator/consumer.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-event.h>
 #include <media/v4l2-fwnode.h>
 #include <media/v4l2-mediabus.h>
+#include <media/mipi-csi2.h>
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6,12,0)
 #include <asm/unaligned.h>
 #else
@@ -34,6 +36,39 @@
 #define EC_FEATURE_DETECTOR_WIDTH      0x180
 #define EC_FEATURE_DETECTOR_HEIGHT     0x184
 
+/*
+ * Window (ROI) of the sensor crop. The feature addresses depend on the
+ * camera, they are given by the "xenics,roi-registers" DT property in the
+ * order below. Offsets and sizes are aligned to these steps.
+ */
+enum {
+   EC_ROI_OFFSET_X,
+   EC_ROI_OFFSET_Y,
+   EC_ROI_WIDTH,
+   EC_ROI_HEIGHT,
+   EC_ROI_NUM_REGS,
+};
+#define EC_ROI_H_ALIGN      4
+#define EC_ROI_V_ALIGN      2
+#define EC_ROI_MIN_WIDTH    32
+#define EC_ROI_MIN_HEIGHT   32
+
+/*
+ * Optional metadata stream, embedded data lines or a second data type of the
+ * camera, given by the "xenics,metadata-lines", "xenics,metadata-bytes" (per
+ * line) and "xenics,metadata-dt" DT properties. It's advertised on a second
+ * source pad, which the receiver captures on its metadata node.
+ */
+enum {
+   EG_EC_PAD_IMAGE,
+   EG_EC_PAD_METADATA,
+   EG_EC_NUM_PADS,
+};
+
+#ifndef MEDIA_BUS_FMT_SENSOR_DATA
+#define MEDIA_BUS_FMT_SENSOR_DATA 0x7002
+#endif
+
 #define EC_PREDEFINED_FORMAT_Y16   20
 #define EC_PREDEFINED_FORMAT_RGB   21
 #define EC_PREDEFINED_FORMAT_YCBCR 22
@@ -70,7 +105,8 @@ static const struct eg_ec_mode eg_ec_supported_modes[] = {
         },
 };
 
-static const s64 link_freq_menu_items[] = { 240000000 };
+/* CSI-2 link frequency of the camera, unless given by the DT endpoint */
+#define EG_EC_DEFAULT_LINK_FREQ 240000000
 
 struct eg_ec_i2c_client {
    struct i2c_client *i2c_client;
@@ -87,10 +123,16 @@ struct eg_ec_i2c_client i2c_clients[MAX_I2C_CLIENTS_NUMBER];
 struct eg_ec {
    struct i2c_client *i2c_client;
    struct v4l2_subdev sd;
-   struct media_pad pad;
+   struct media_pad pad[EG_EC_NUM_PADS];
+   unsigned int num_pads;
 
    struct v4l2_mbus_framefmt fmt;
 
+   /* Metadata stream, meta_lines is 0 when there's none */
+   u32 meta_lines;
+   u32 meta_bytes;
+   u8 meta_dt;
+
    struct v4l2_ctrl_handler ctrl_handler;
    /*
     * Mutex for serialized access:
@@ -98,6 +140,21 @@ struct eg_ec {
     */
    struct mutex mutex;
    int mbus_code_index;
+
+   /* Detector size, read back from the camera with the active format */
+   u32 detector_width;
+   u32 detector_height;
+   /* Active crop, the full detector until a window is set */
+   struct v4l2_rect crop;
+   bool crop_set;
+   u32 roi_regs[EC_ROI_NUM_REGS];
+   bool has_roi;
+   bool streaming;
+
+   /* CSI-2 bus of the DT endpoint, the 2lanes overlay parameter included */
+   unsigned int num_data_lanes;
+   unsigned int bus_flags;
+   s64 link_freq_menu_items[1];
 };
 
 int eg_ec_chnod_open (struct inode * pInode, struct file * file);
@@ -108,6 +165,16 @@ static inline struct eg_ec *to_eg_ec(struct v4l2_subdev *_sd)
    return container_of(_sd, struct eg_ec, sd);
 }
 
+/* Fixed format of the metadata pad */
+static void eg_ec_meta_fmt(struct eg_ec *eg_ec, struct v4l2_mbus_framefmt *fmt)
+{
+   memset(fmt, 0, sizeof(*fmt));
+   fmt->code = MEDIA_BUS_FMT_SENSOR_DATA;
+   fmt->width = eg_ec->meta_bytes;
+   fmt->height = eg_ec->meta_lines;
+   fmt->field = V4L2_FIELD_NONE;
+}
+
 static ssize_t eg_ec_chnod_read(
       struct file *file_ptr
       , char __user *user_buffer
@@ -464,6 +531,13 @@ static int eg_ec_init_state(struct v4l2_subdev *sd,
    crop->width  = eg_ec->fmt.width;
    crop->height = eg_ec->fmt.height;
 
+   if (eg_ec->num_pads > EG_EC_PAD_METADATA)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+      eg_ec_meta_fmt(eg_ec, v4l2_subdev_get_try_format(sd, state, EG_EC_PAD_METADATA));
+#else
+      eg_ec_meta_fmt(eg_ec, v4l2_subdev_state_get_format(state, EG_EC_PAD_METADATA));
+#endif
+
    return 0;
 }
 
@@ -491,6 +565,13 @@ static int eg_ec_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
    try_crop->width = try_img_fmt->width;
    try_crop->height = try_img_fmt->height;
 
+   if (eg_ec->num_pads > EG_EC_PAD_METADATA)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+      eg_ec_meta_fmt(eg_ec, v4l2_subdev_get_try_format(sd, fh->state, EG_EC_PAD_METADATA));
+#else
+      eg_ec_meta_fmt(eg_ec, v4l2_subdev_state_get_format(fh->state, EG_EC_PAD_METADATA));
+#endif
+
    return 0;
 }
 
@@ -520,6 +601,16 @@ static int eg_ec_enum_mbus_code(struct v4l2_subdev *sd,
       struct v4l2_subdev_state *sd_state,
       struct v4l2_subdev_mbus_code_enum *code)
 {
+   struct eg_ec *eg_ec = to_eg_ec(sd);
+
+   if (code->pad == EG_EC_PAD_METADATA && eg_ec->num_pads > EG_EC_PAD_METADATA)
+   {
+      if (code->index)
+         return -EINVAL;
+      code->code = MEDIA_BUS_FMT_SENSOR_DATA;
+      return 0;
+   }
+
    if (code->index >= NUM_MBUS_CODES)
       return -EINVAL;
    if (code->pad)
@@ -540,6 +631,14 @@ static int eg_ec_enum_frame_size(struct v4l2_subdev *sd,
    struct eg_ec *eg_ec = to_eg_ec(sd);
    if (fse->index)
       return -EINVAL;
+   if (fse->pad == EG_EC_PAD_METADATA && eg_ec->num_pads > EG_EC_PAD_METADATA)
+   {
+      if (fse->code != MEDIA_BUS_FMT_SENSOR_DATA)
+         return -EINVAL;
+      fse->min_width = fse->max_width = eg_ec->meta_bytes;
+      fse->min_height = fse->max_height = eg_ec->meta_lines;
+      return 0;
+   }
    if (fse->pad)
       return -EINVAL;
 
@@ -599,16 +698,138 @@ static int eg_ec_enum_frame_interval(struct v4l2_subdev *sd,
    return -EINVAL;
 }
 
+/* CSI-2 data type of a media bus code */
+static u8 eg_ec_csi2_dt(u32 code)
+{
+   switch (code) {
+      case MEDIA_BUS_FMT_RGB888_1X24:
+         return MIPI_CSI2_DT_RGB888;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,1,63)
+      case MEDIA_BUS_FMT_Y16_1X16:
+         return MIPI_CSI2_DT_RAW16;
+#endif
+      case MEDIA_BUS_FMT_UYVY8_1X16:
+      default:
+         return MIPI_CSI2_DT_YUV422_8B;
+   }
+}
+
+static int eg_ec_get_frame_desc(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_frame_desc *fd)
+{
+   struct eg_ec *eg_ec = to_eg_ec(sd);
+
+   if (pad >= eg_ec->num_pads)
+      return -EINVAL;
+
+   /*
+    * The image on virtual channel 0, then the metadata when there's some.
+    * The stream of an entry is the index of its source pad.
+    */
+   memset(fd, 0, sizeof(*fd));
+   fd->type = V4L2_MBUS_FRAME_DESC_TYPE_CSI2;
+   fd->num_entries = 1;
+
+   mutex_lock(&eg_ec->mutex);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+   fd->entry[0].stream = EG_EC_PAD_IMAGE;
+#endif
+   fd->entry[0].pixelcode = eg_ec->fmt.code;
+   fd->entry[0].bus.csi2.vc = 0;
+   fd->entry[0].bus.csi2.dt = eg_ec_csi2_dt(eg_ec->fmt.code);
+   mutex_unlock(&eg_ec->mutex);
+
+   if (eg_ec->num_pads > EG_EC_PAD_METADATA)
+   {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+      fd->entry[1].stream = EG_EC_PAD_METADATA;
+#endif
+      fd->entry[1].flags = V4L2_MBUS_FRAME_DESC_FL_LEN_MAX;
+      fd->entry[1].length = eg_ec->meta_bytes * eg_ec->meta_lines;
+      fd->entry[1].pixelcode = MEDIA_BUS_FMT_SENSOR_DATA;
+      fd->entry[1].bus.csi2.vc = 0;
+      fd->entry[1].bus.csi2.dt = eg_ec->meta_dt;
+      fd->num_entries = 2;
+   }
+
+   return 0;
+}
+
+static int eg_ec_get_mbus_config(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_config *config)
+{
+   struct eg_ec *eg_ec = to_eg_ec(sd);
+
+   if (pad >= eg_ec->num_pads)
+      return -EINVAL;
+
+   memset(config, 0, sizeof(*config));
+   config->type = V4L2_MBUS_CSI2_DPHY;
+   config->bus.mipi_csi2.num_data_lanes = eg_ec->num_data_lanes;
+   config->bus.mipi_csi2.flags = eg_ec->bus_flags;
+
+   return 0;
+}
+
+static void eg_ec_read_detector_size(struct eg_ec *eg_ec)
+{
+   uint32_t detectorWidth;
+   uint32_t detectorHeight;
+   int err;
+
+   // Get detector width from the camera
+   err = eg_ec_mipi_read_reg(eg_ec->i2c_client, EC_FEATURE_DETECTOR_WIDTH, (uint8_t*)&detectorWidth, sizeof(detectorWidth));
+   if (!err)
+   {
+      eg_ec->detector_width = detectorWidth;
+   }
+   else
+   {
+      dev_err(&eg_ec->i2c_client->dev, "Failed to get detector's width.\n");
+   }
+
+   udelay(10000);
+
+   // Get detector height from the camera
+   err = eg_ec_mipi_read_reg(eg_ec->i2c_client, EC_FEATURE_DETECTOR_HEIGHT, (uint8_t*)&detectorHeight, sizeof(detectorHeight));
+   if (!err)
+   {
+      eg_ec->detector_height = detectorHeight;
+   }
+   else
+   {
+      dev_err(&eg_ec->i2c_client->dev, "Failed to get detector's height.\n");
+   }
+}
+
+/* Keep the active crop inside the detector, called with the mutex held */
+static void eg_ec_update_crop(struct eg_ec *eg_ec)
+{
+   if (!eg_ec->crop_set ||
+       eg_ec->crop.left + eg_ec->crop.width > eg_ec->detector_width ||
+       eg_ec->crop.top + eg_ec->crop.height > eg_ec->detector_height)
+   {
+      eg_ec->crop.left = 0;
+      eg_ec->crop.top = 0;
+      eg_ec->crop.width = eg_ec->detector_width;
+      eg_ec->crop.height = eg_ec->detector_height;
+      eg_ec->crop_set = false;
+   }
+}
+
 static int eg_ec_get_pad_format(struct v4l2_subdev *sd,
       struct v4l2_subdev_state *sd_state,
       struct v4l2_subdev_format *fmt)
 {
    struct eg_ec *eg_ec = to_eg_ec(sd);
    uint32_t predefinedFormat = EC_PREDEFINED_FORMAT_YCBCR;
-   uint32_t detectorWidth = DEFAULT_WIDTH;
-   uint32_t detectorHeight = DEFAULT_HEIGHT;
    int err;
 
+   if (fmt->pad == EG_EC_PAD_METADATA && eg_ec->num_pads > EG_EC_PAD_METADATA)
+   {
+      eg_ec_meta_fmt(eg_ec, &fmt->format);
+      return 0;
+   }
    if (fmt->pad)
       return -EINVAL;
 
@@ -652,31 +873,15 @@ static int eg_ec_get_pad_format(struct v4l2_subdev *sd,
       
       udelay(10000);
 
-      // Get detector width from the camera
-      err = eg_ec_mipi_read_reg(eg_ec->i2c_client, EC_FEATURE_DETECTOR_WIDTH, (uint8_t*)&detectorWidth, sizeof(detectorWidth));
-      if (!err)
-      {
-         eg_ec->fmt.width = detectorWidth;
-      }
-      else
-      {
-         dev_err(&eg_ec->i2c_client->dev, "Failed to get detector's width.\n");
-      }
-
-      udelay(10000);
-
-      // Get detector height from the camera
-      err = eg_ec_mipi_read_reg(eg_ec->i2c_client, EC_FEATURE_DETECTOR_HEIGHT, (uint8_t*)&detectorHeight, sizeof(detectorHeight));
-      if (!err)
-      {
-         eg_ec->fmt.height = detectorHeight;
-      }
-      else
-      {
-         dev_err(&eg_ec->i2c_client->dev, "Failed to get detector's height.\n");
-      }
+      eg_ec_read_detector_size(eg_ec);
 
+      // The image is the crop window when one is set
+      mutex_lock(&eg_ec->mutex);
+      eg_ec_update_crop(eg_ec);
+      eg_ec->fmt.width = eg_ec->crop.width;
+      eg_ec->fmt.height = eg_ec->crop.height;
       fmt->format = eg_ec->fmt;
+      mutex_unlock(&eg_ec->mutex);
    }
 
    return 0;
@@ -688,8 +893,15 @@ static int eg_ec_set_pad_format(struct v4l2_subdev *sd,
 {
    struct eg_ec *eg_ec = to_eg_ec(sd);
    struct v4l2_mbus_framefmt *format;
+   struct v4l2_rect *crop;
    int i;
 
+   // The metadata format is set by the camera
+   if (fmt->pad == EG_EC_PAD_METADATA && eg_ec->num_pads > EG_EC_PAD_METADATA)
+   {
+      eg_ec_meta_fmt(eg_ec, &fmt->format);
+      return 0;
+   }
    if (fmt->pad)
       return -EINVAL;
 
@@ -714,15 +926,27 @@ static int eg_ec_set_pad_format(struct v4l2_subdev *sd,
       V4L2_MAP_XFER_FUNC_DEFAULT(fmt->format.colorspace);
 
    if (fmt->which == V4L2_SUBDEV_FORMAT_TRY)
+   {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
       format = v4l2_subdev_get_try_format(&eg_ec->sd, sd_state, fmt->pad);
+      crop = v4l2_subdev_get_try_crop(&eg_ec->sd, sd_state, fmt->pad);
 #else
       format = v4l2_subdev_state_get_format(sd_state, fmt->pad);
+      crop = v4l2_subdev_state_get_crop(sd_state, fmt->pad);
 #endif
+   }
    else
+   {
       format = &eg_ec->fmt;
+      crop = &eg_ec->crop;
+   }
 
+   // The size is the one of the crop window, it can't be scaled
+   mutex_lock(&eg_ec->mutex);
+   fmt->format.width = crop->width;
+   fmt->format.height = crop->height;
    *format = fmt->format;
+   mutex_unlock(&eg_ec->mutex);
 
    return 0;
 }
@@ -733,14 +957,36 @@ static int eg_ec_get_selection(struct v4l2_subdev *sd,
 {
    struct eg_ec *eg_ec = to_eg_ec(sd);
 
+   if (sel->pad)
+      return -EINVAL;
+
    switch (sel->target) {
-//      case V4L2_SEL_TGT_CROP:
+      case V4L2_SEL_TGT_CROP:
+         if (sel->which == V4L2_SUBDEV_FORMAT_TRY)
+         {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+            sel->r = *v4l2_subdev_get_try_crop(sd, sd_state, sel->pad);
+#else
+            sel->r = *v4l2_subdev_state_get_crop(sd_state, sel->pad);
+#endif
+         }
+         else
+         {
+            mutex_lock(&eg_ec->mutex);
+            eg_ec_update_crop(eg_ec);
+            sel->r = eg_ec->crop;
+            mutex_unlock(&eg_ec->mutex);
+         }
+
+         return 0;
+
       case V4L2_SEL_TGT_NATIVE_SIZE:
-//      case V4L2_SEL_TGT_CROP_DEFAULT:
+      case V4L2_SEL_TGT_CROP_DEFAULT:
+      case V4L2_SEL_TGT_CROP_BOUNDS:
          sel->r.top = 0;
          sel->r.left = 0;
-         sel->r.width = eg_ec->fmt.width;
-         sel->r.height = eg_ec->fmt.height;
+         sel->r.width = eg_ec->detector_width;
+         sel->r.height = eg_ec->detector_height;
 
          return 0;
    }
@@ -748,12 +994,137 @@ static int eg_ec_get_selection(struct v4l2_subdev *sd,
    return -EINVAL;
 }
 
+static int eg_ec_write_roi(struct eg_ec *eg_ec, const struct v4l2_rect *r)
+{
+   uint32_t values[EC_ROI_NUM_REGS];
+   uint32_t zero = 0;
+   int err;
+   int i;
+
+   values[EC_ROI_OFFSET_X] = r->left;
+   values[EC_ROI_OFFSET_Y] = r->top;
+   values[EC_ROI_WIDTH] = r->width;
+   values[EC_ROI_HEIGHT] = r->height;
+
+   /*
+    * Clear the offsets first so that the window stays inside the detector
+    * while the size grows, then set the size and the offsets.
+    */
+   for (i = EC_ROI_OFFSET_X; i <= EC_ROI_OFFSET_Y; i++)
+   {
+      err = eg_ec_mipi_write_reg(eg_ec->i2c_client, eg_ec->roi_regs[i], (uint8_t*)&zero, sizeof(zero));
+      if (err)
+         return err;
+      udelay(10000);
+   }
+
+   for (i = EC_ROI_NUM_REGS - 1; i >= 0; i--)
+   {
+      err = eg_ec_mipi_write_reg(eg_ec->i2c_client, eg_ec->roi_regs[i], (uint8_t*)&values[i], sizeof(values[i]));
+      if (err)
+         return err;
+      udelay(10000);
+   }
+
+   return 0;
+}
+
+static int eg_ec_set_selection(struct v4l2_subdev *sd,
+      struct v4l2_subdev_state *sd_state,
+      struct v4l2_subdev_selection *sel)
+{
+   struct eg_ec *eg_ec = to_eg_ec(sd);
+   struct v4l2_mbus_framefmt *try_fmt;
+   struct v4l2_rect r = sel->r;
+   u32 max_left, max_top;
+   int err = 0;
+
+   if (sel->pad || sel->target != V4L2_SEL_TGT_CROP)
+      return -EINVAL;
+
+   if (sel->which == V4L2_SUBDEV_FORMAT_ACTIVE)
+      eg_ec_read_detector_size(eg_ec);
+
+   if (!eg_ec->has_roi ||
+       eg_ec->detector_width < EC_ROI_MIN_WIDTH ||
+       eg_ec->detector_height < EC_ROI_MIN_HEIGHT)
+   {
+      // No window feature, the crop is always the full detector
+      r.left = 0;
+      r.top = 0;
+      r.width = eg_ec->detector_width;
+      r.height = eg_ec->detector_height;
+   }
+   else
+   {
+      max_left = eg_ec->detector_width - EC_ROI_MIN_WIDTH;
+      max_top = eg_ec->detector_height - EC_ROI_MIN_HEIGHT;
+      r.left = ALIGN_DOWN(clamp_t(s32, r.left, 0, max_left), EC_ROI_H_ALIGN);
+      r.top = ALIGN_DOWN(clamp_t(s32, r.top, 0, max_top), EC_ROI_V_ALIGN);
+      r.width = ALIGN_DOWN(clamp_t(u32, r.width, EC_ROI_MIN_WIDTH,
+                                   eg_ec->detector_width - r.left), EC_ROI_H_ALIGN);
+      r.height = ALIGN_DOWN(clamp_t(u32, r.height, EC_ROI_MIN_HEIGHT,
+                                    eg_ec->detector_height - r.top), EC_ROI_V_ALIGN);
+   }
+
+   if (sel->which == V4L2_SUBDEV_FORMAT_TRY)
+   {
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+      *v4l2_subdev_get_try_crop(sd, sd_state, sel->pad) = r;
+      try_fmt = v4l2_subdev_get_try_format(sd, sd_state, sel->pad);
+#else
+      *v4l2_subdev_state_get_crop(sd_state, sel->pad) = r;
+      try_fmt = v4l2_subdev_state_get_format(sd_state, sel->pad);
+#endif
+      try_fmt->width = r.width;
+      try_fmt->height = r.height;
+      sel->r = r;
+      return 0;
+   }
+
+   mutex_lock(&eg_ec->mutex);
+
+   if (eg_ec->streaming)
+   {
+      err = -EBUSY;
+      goto unlock;
+   }
+
+   if (eg_ec->has_roi)
+   {
+      err = eg_ec_write_roi(eg_ec, &r);
+      if (err)
+      {
+         dev_err(&eg_ec->i2c_client->dev, "Failed to set the window %ux%u@(%d,%d), err %d\n",
+               r.width, r.height, r.left, r.top, err);
+         goto unlock;
+      }
+   }
+
+   eg_ec->crop = r;
+   eg_ec->crop_set = eg_ec->has_roi;
+   eg_ec->fmt.width = r.width;
+   eg_ec->fmt.height = r.height;
+   sel->r = r;
+
+unlock:
+   mutex_unlock(&eg_ec->mutex);
+
+   return err;
+}
+
 static int eg_ec_set_stream(struct v4l2_subdev *sd, int enable)
 {
+   struct eg_ec *eg_ec = to_eg_ec(sd);
+
    /*
     * Don't need to do anything here, just assume the source is streaming
-    * already.
+    * already. The window can't change while streaming.
     */
+   mutex_lock(&eg_ec->mutex);
+   eg_ec->streaming = enable;
+   mutex_unlock(&eg_ec->mutex);
+
    return 0;
 }
 
@@ -771,8 +1142,11 @@ static const struct v4l2_subdev_pad_ops eg_ec_pad_ops = {
    .get_fmt             = eg_ec_get_pad_format,
    .set_fmt             = eg_ec_set_pad_format,
    .get_selection       = eg_ec_get_selection,
+   .set_selection       = eg_ec_set_selection,
    .enum_frame_size     = eg_ec_enum_frame_size,
    .enum_frame_interval = eg_ec_enum_frame_interval,
+   .get_frame_desc      = eg_ec_get_frame_desc,
+   .get_mbus_config     = eg_ec_get_mbus_config,
 };
 
 static const struct v4l2_subdev_ops eg_ec_subdev_ops = {
@@ -822,7 +1196,7 @@ static int eg_ec_init_controls(struct eg_ec *eg_ec)
       ctrl->flags |= V4L2_CTRL_FLAG_READ_ONLY;
 
    ctrl = v4l2_ctrl_new_int_menu(ctrl_hdlr, &eg_ec_ctrl_ops, V4L2_CID_LINK_FREQ,
-                                0, 0, link_freq_menu_items);
+                                0, 0, eg_ec->link_freq_menu_items);
    if (ctrl)
       ctrl->flags |= V4L2_CTRL_FLAG_READ_ONLY;
 
@@ -851,7 +1225,7 @@ static void eg_ec_free_controls(struct eg_ec *eg_ec)
    mutex_destroy(&eg_ec->mutex);
 }
 
-static int eg_ec_check_hwcfg(struct device *dev)
+static int eg_ec_check_hwcfg(struct device *dev, struct eg_ec *eg_ec)
 {
    struct fwnode_handle *endpoint;
    struct v4l2_fwnode_endpoint ep_cfg = {
@@ -870,6 +1244,18 @@ static int eg_ec_check_hwcfg(struct device *dev)
       goto error_out;
    }
 
+   /* Kept for get_mbus_config, the endpoint is freed below */
+   eg_ec->num_data_lanes = ep_cfg.bus.mipi_csi2.num_data_lanes;
+   eg_ec->bus_flags = ep_cfg.bus.mipi_csi2.flags;
+
+   /* Optional, the receiver programs its DPHY from this frequency */
+   eg_ec->link_freq_menu_items[0] = EG_EC_DEFAULT_LINK_FREQ;
+   if (ep_cfg.nr_of_link_frequencies > 0)
+      eg_ec->link_freq_menu_items[0] = ep_cfg.link_frequencies[0];
+
+   dev_info(dev, "%u data lane(s), link frequency %lld Hz\n",
+         eg_ec->num_data_lanes, eg_ec->link_freq_menu_items[0]);
+
    ret = 0;
 
 error_out:
@@ -879,6 +1265,32 @@ error_out:
    return ret;
 }
 
+/* Optional metadata stream of the camera, none unless its size is given */
+static void eg_ec_read_metadata_cfg(struct device *dev, struct eg_ec *eg_ec)
+{
+   u32 dt = MIPI_CSI2_DT_EMBEDDED_8B;
+
+   if (device_property_read_u32(dev, "xenics,metadata-lines", &eg_ec->meta_lines) ||
+       device_property_read_u32(dev, "xenics,metadata-bytes", &eg_ec->meta_bytes) ||
+       !eg_ec->meta_lines || !eg_ec->meta_bytes)
+   {
+      eg_ec->meta_lines = 0;
+      return;
+   }
+
+   device_property_read_u32(dev, "xenics,metadata-dt", &dt);
+   if (dt > 0x3f)
+   {
+      dev_warn(dev, "invalid metadata data type 0x%x, using 0x%x\n",
+            dt, MIPI_CSI2_DT_EMBEDDED_8B);
+      dt = MIPI_CSI2_DT_EMBEDDED_8B;
+   }
+   eg_ec->meta_dt = dt;
+
+   dev_info(dev, "metadata: %u line(s) of %u bytes, data type 0x%x\n",
+         eg_ec->meta_lines, eg_ec->meta_bytes, eg_ec->meta_dt);
+}
+
 static int eg_ec_probe(struct i2c_client *client)
 {
    struct device *dev = &client->dev;
@@ -935,11 +1347,27 @@ static int eg_ec_probe(struct i2c_client *client)
          dev->driver->name);
 
    /* Check the hardware configuration in device tree */
-   if (eg_ec_check_hwcfg(dev))
+   if (eg_ec_check_hwcfg(dev, eg_ec))
       return -EINVAL;
 
    eg_ec->fmt.width = eg_ec_supported_modes[0].width;
    eg_ec->fmt.height = eg_ec_supported_modes[0].height;
+   eg_ec->detector_width = DEFAULT_WIDTH;
+   eg_ec->detector_height = DEFAULT_HEIGHT;
+   eg_ec->crop.width = DEFAULT_WIDTH;
+   eg_ec->crop.height = DEFAULT_HEIGHT;
+
+   // Optional window (ROI) feature addresses of this camera
+   if (!device_property_read_u32_array(dev, "xenics,roi-registers",
+            eg_ec->roi_regs, EC_ROI_NUM_REGS))
+   {
+      eg_ec->has_roi = true;
+      dev_info(dev, "window registers 0x%x 0x%x 0x%x 0x%x\n",
+            eg_ec->roi_regs[EC_ROI_OFFSET_X], eg_ec->roi_regs[EC_ROI_OFFSET_Y],
+            eg_ec->roi_regs[EC_ROI_WIDTH], eg_ec->roi_regs[EC_ROI_HEIGHT]);
+   }
+   eg_ec_read_metadata_cfg(dev, eg_ec);
+
    eg_ec->fmt.code = eg_ec_mbus_codes[0];
    eg_ec->fmt.field = V4L2_FIELD_NONE;
    eg_ec->fmt.colorspace = V4L2_COLORSPACE_SRGB;
@@ -962,11 +1390,13 @@ static int eg_ec_probe(struct i2c_client *client)
       V4L2_SUBDEV_FL_HAS_EVENTS;
    eg_ec->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR;
 
-   /* Initialize source pads */
-   eg_ec->pad.flags = MEDIA_PAD_FL_SOURCE;
+   /* Initialize source pads, the image and the optional metadata */
+   eg_ec->pad[EG_EC_PAD_IMAGE].flags = MEDIA_PAD_FL_SOURCE;
+   eg_ec->pad[EG_EC_PAD_METADATA].flags = MEDIA_PAD_FL_SOURCE;
+   eg_ec->num_pads = eg_ec->meta_lines ? EG_EC_NUM_PADS : 1;
 
-   ret = media_entity_pads_init(&eg_ec->sd.entity, 1,
-         &eg_ec->pad);
+   ret = media_entity_pads_init(&eg_ec->sd.entity, eg_ec->num_pads,
+         eg_ec->pad);
    if (ret) {
       dev_err(dev, "failed to init entity pads: %d\n", ret);
       goto error_handler_free;
@@ -0,0 +1,530 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * fe-agc - thermal AGC from the PiSP front end statistics on the Pi 5.
+ *
+ * Streams rp1-cfe-fe_image0 with the front end statistics
+ * (eg_media_configure_rp1_cfe.sh fe), queues the configuration built by
+ * fe_agc_config() for every frame and runs fe_agc_update() on each stats
+ * buffer. The image is not read, unless -c also runs the CPU AGC of
+ * libexoy16 (y16_agc, full frame read) on it for comparison.
+ *
+ * Prints the range, gain and levels per frame (-v, or -o CSV) and a summary
+ * of the bytes read and CPU time per frame of both.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/media.h>
+#include <linux/videodev2.h>
+
+#include "fe_agc.h"
+#include "y16conv.h"
+
+#ifndef V4L2_PIX_FMT_PISP_COMP1_MONO
+#define V4L2_PIX_FMT_PISP_COMP1_MONO v4l2_fourcc('P', 'C', '1', 'M')
+#endif
+
+#define NBUFS    4
+#define HISTORY  16             /* FE results kept for the comparison by sequence */
+
+struct node {
+   int      fd;
+   enum v4l2_buf_type type;
+   void    *map[NBUFS];
+   size_t   len[NBUFS];
+};
+
+struct fe_result {
+   uint32_t sequence;
+   float    lo, hi;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+static double mono_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double thread_cpu_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* /dev path of the character device @major:@minor */
+static int devnode_path(unsigned major, unsigned minor, char *path, size_t len)
+{
+   char uevent[64], line[128];
+   int ret = -ENOENT;
+   FILE *f;
+
+   snprintf(uevent, sizeof(uevent), "/sys/dev/char/%u:%u/uevent", major, minor);
+   f = fopen(uevent, "r");
+   if (!f)
+      return -errno;
+   while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, "DEVNAME=", 8)) {
+         line[strcspn(line, "\n")] = 0;
+         snprintf(path, len, "/dev/%s", line + 8);
+         ret = 0;
+         break;
+      }
+   }
+   fclose(f);
+   return ret;
+}
+
+/* Video node of the entity @name of the media device @fd */
+static int media_video_node(int fd, const char *name, char *path, size_t len)
+{
+   struct media_v2_topology topo = { 0 };
+   struct media_v2_entity *ents = NULL;
+   struct media_v2_interface *ifaces = NULL;
+   struct media_v2_link *links = NULL;
+   uint32_t ent_id = 0;
+   unsigned i, j;
+   int ret;
+
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &topo);
+   if (ret)
+      return ret;
+   ents = calloc(topo.num_entities, sizeof(*ents));
+   ifaces = calloc(topo.num_interfaces, sizeof(*ifaces));
+   links = calloc(topo.num_links, sizeof(*links));
+   if (!ents || !ifaces || !links) {
+      ret = -ENOMEM;
+      goto out;
+   }
+   topo.ptr_entities = (uintptr_t)ents;
+   topo.ptr_interfaces = (uintptr_t)ifaces;
+   topo.ptr_links = (uintptr_t)links;
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &topo);
+   if (ret)
+      goto out;
+
+   ret = -ENOENT;
+   for (i = 0; i < topo.num_entities && !ent_id; i++)
+      if (!strcmp(ents[i].name, name))
+         ent_id = ents[i].id;
+   for (i = 0; i < topo.num_links && ent_id; i++) {
+      if ((links[i].flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_INTERFACE_LINK ||
+          links[i].sink_id != ent_id)
+         continue;
+      for (j = 0; j < topo.num_interfaces; j++)
+         if (ifaces[j].id == links[i].source_id) {
+            ret = devnode_path(ifaces[j].devnode.major, ifaces[j].devnode.minor,
+                               path, len);
+            goto out;
+         }
+   }
+
+out:
+   free(ents);
+   free(ifaces);
+   free(links);
+   return ret;
+}
+
+/* Media device @index among the rp1-cfe ones */
+static int media_open_cfe(int index)
+{
+   char path[32];
+   int i, fd;
+
+   for (i = 0; i < 64; i++) {
+      struct media_device_info info;
+
+      snprintf(path, sizeof(path), "/dev/media%d", i);
+      fd = open(path, O_RDWR | O_CLOEXEC);
+      if (fd < 0)
+         continue;
+      if (!xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info) && !strcmp(info.model, "rp1-cfe") &&
+          index-- == 0)
+         return fd;
+      close(fd);
+   }
+   return -ENODEV;
+}
+
+static int node_open(int media, const char *name, enum v4l2_buf_type type,
+                     struct node *n)
+{
+   struct v4l2_requestbuffers req = {
+      .count = NBUFS,
+      .type = type,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   char path[128];
+   unsigned i;
+   int ret;
+
+   n->type = type;
+   ret = media_video_node(media, name, path, sizeof(path));
+   if (ret)
+      return ret;
+   n->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (n->fd < 0)
+      return -errno;
+   ret = xioctl(n->fd, VIDIOC_REQBUFS, &req);
+   if (ret)
+      return ret;
+   if (req.count < NBUFS)
+      return -ENOMEM;
+
+   for (i = 0; i < NBUFS; i++) {
+      struct v4l2_buffer buf = { .type = type, .memory = V4L2_MEMORY_MMAP, .index = i };
+
+      ret = xioctl(n->fd, VIDIOC_QUERYBUF, &buf);
+      if (ret)
+         return ret;
+      n->map[i] = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, n->fd,
+                       buf.m.offset);
+      if (n->map[i] == MAP_FAILED)
+         return -errno;
+      n->len[i] = buf.length;
+   }
+   return 0;
+}
+
+static void node_close(struct node *n)
+{
+   unsigned i;
+
+   if (n->fd < 0)
+      return;
+   xioctl(n->fd, VIDIOC_STREAMOFF, &n->type);
+   for (i = 0; i < NBUFS; i++)
+      if (n->map[i] && n->map[i] != MAP_FAILED)
+         munmap(n->map[i], n->len[i]);
+   close(n->fd);
+}
+
+static int node_queue(struct node *n, unsigned index, size_t bytesused)
+{
+   struct v4l2_buffer buf = {
+      .type = n->type,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = index,
+      .bytesused = bytesused,
+   };
+
+   return xioctl(n->fd, VIDIOC_QBUF, &buf);
+}
+
+static int node_dequeue(struct node *n, struct v4l2_buffer *buf)
+{
+   memset(buf, 0, sizeof(*buf));
+   buf->type = n->type;
+   buf->memory = V4L2_MEMORY_MMAP;
+   return xioctl(n->fd, VIDIOC_DQBUF, buf);
+}
+
+/* Centre weighted histogram: zones of the central half weigh 4, the others 1 */
+static void centre_weights(uint8_t *w)
+{
+   unsigned x, y;
+
+   for (y = 0; y < PISP_AGC_STATS_SIZE; y++)
+      for (x = 0; x < PISP_AGC_STATS_SIZE; x++)
+         w[y * PISP_AGC_STATS_SIZE + x] =
+            x >= PISP_AGC_STATS_SIZE / 4 && x < PISP_AGC_STATS_SIZE * 3 / 4 &&
+            y >= PISP_AGC_STATS_SIZE / 4 && y < PISP_AGC_STATS_SIZE * 3 / 4 ? 4 : 1;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: fe-agc [-m INDEX] [-n FRAMES] [-l LOW_PCT] [-H HIGH_PCT] [-s SPEED]\n"
+      "              [-w] [-c] [-v] [-o FILE] [-M MODE] [-O OFFSET]\n"
+      "  -m INDEX   rp1-cfe media device among the CFEs (default: 0)\n"
+      "  -n FRAMES  frames, 0 until interrupted (default: 300)\n"
+      "  -l, -H     percentiles mapped to 0 and 255 (default: 1 and 99)\n"
+      "  -s SPEED   0..1, weight of the new range per frame (default: 0.2)\n"
+      "  -w         centre weighted histogram\n"
+      "  -c         also run the CPU AGC (y16_agc) on the image, compare\n"
+      "  -v         one line per frame\n"
+      "  -o FILE    CSV per frame: sequence,lo,hi,gain,offset,mean,centre\n"
+      "  -M, -O     compression mode and offset of a PC1M fe_image0 (default: 1 and 0)\n");
+}
+
+int main(int argc, char **argv)
+{
+   struct node image = { .fd = -1 }, stats = { .fd = -1 }, config = { .fd = -1 };
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_format meta = { .type = V4L2_BUF_TYPE_META_OUTPUT };
+   struct fe_agc_params params = { .comp_mode = 1 };
+   struct fe_result history[HISTORY] = { 0 };
+   struct y16_agc *cpu_agc = NULL;
+   struct fe_agc agc;
+   uint8_t weights[FE_AGC_ZONES];
+   uint16_t *line = NULL;
+   uint8_t *line8 = NULL;
+   float low_pct = 1, high_pct = 99, speed = 0.2f;
+   int index = 0, frames = 300, weighted = 0, compare = 0, verbose = 0;
+   unsigned fe_frames = 0, cpu_frames = 0, compared = 0;
+   double fe_cpu = 0, cpu_cpu = 0, diff_sum = 0, t0;
+   const char *csv_path = NULL;
+   FILE *csv = NULL;
+   int media, opt, ret;
+   unsigned i, y;
+
+   while ((opt = getopt(argc, argv, "m:n:l:H:s:wcvo:M:O:h")) != -1) {
+      switch (opt) {
+      case 'm':
+         index = strtol(optarg, NULL, 0);
+         break;
+      case 'n':
+         frames = strtol(optarg, NULL, 0);
+         break;
+      case 'l':
+         low_pct = strtof(optarg, NULL);
+         break;
+      case 'H':
+         high_pct = strtof(optarg, NULL);
+         break;
+      case 's':
+         speed = strtof(optarg, NULL);
+         break;
+      case 'w':
+         weighted = 1;
+         break;
+      case 'c':
+         compare = 1;
+         break;
+      case 'v':
+         verbose = 1;
+         break;
+      case 'o':
+         csv_path = optarg;
+         break;
+      case 'M':
+         params.comp_mode = strtoul(optarg, NULL, 0);
+         break;
+      case 'O':
+         params.comp_offset = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   media = media_open_cfe(index);
+   if (media < 0) {
+      fprintf(stderr, "fe-agc: no rp1-cfe media device %d\n", index);
+      return 1;
+   }
+   ret = node_open(media, "rp1-cfe-fe_image0", V4L2_BUF_TYPE_VIDEO_CAPTURE, &image);
+   if (!ret)
+      ret = node_open(media, "rp1-cfe-fe_stats", V4L2_BUF_TYPE_META_CAPTURE, &stats);
+   if (!ret)
+      ret = node_open(media, "rp1-cfe-fe_config", V4L2_BUF_TYPE_META_OUTPUT, &config);
+   close(media);
+   if (ret) {
+      fprintf(stderr, "fe-agc: front end nodes: %s (eg_media_configure_rp1_cfe.sh fe?)\n",
+              strerror(-ret));
+      return 1;
+   }
+
+   if (xioctl(image.fd, VIDIOC_G_FMT, &fmt) || xioctl(config.fd, VIDIOC_G_FMT, &meta) ||
+       (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_Y16 &&
+        fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_PISP_COMP1_MONO)) {
+      fprintf(stderr, "fe-agc: fe_image0 is not Y16 or PC1M\n");
+      return 1;
+   }
+   params.width = fmt.fmt.pix.width;
+   params.height = fmt.fmt.pix.height;
+   params.stride = fmt.fmt.pix.bytesperline;
+   params.compressed = fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_PISP_COMP1_MONO;
+   if (weighted) {
+      centre_weights(weights);
+      params.weights = weights;
+   }
+   /* Region 0: centre quarter of the scene */
+   params.regions[0].x = (params.width / 4) & ~1u;
+   params.regions[0].y = (params.height / 4) & ~1u;
+   params.regions[0].width = (params.width / 2) & ~1u;
+   params.regions[0].height = (params.height / 2) & ~1u;
+
+   /* Same configuration for every frame, queued again as soon as it's back */
+   for (i = 0; i < NBUFS; i++) {
+      if (config.len[i] < sizeof(struct pisp_fe_config) ||
+          fe_agc_config(&params, config.map[i])) {
+         fprintf(stderr, "fe-agc: %ux%u: no front end configuration\n", params.width,
+                 params.height);
+         return 1;
+      }
+   }
+
+   fe_agc_init(&agc, low_pct, high_pct, speed);
+   if (compare) {
+      cpu_agc = malloc(sizeof(*cpu_agc));
+      line = malloc(params.width * 2);
+      line8 = malloc(params.width);
+      if (!cpu_agc || !line || !line8)
+         return 1;
+      y16_agc_init(cpu_agc, low_pct, high_pct, speed);
+   }
+   if (csv_path) {
+      csv = fopen(csv_path, "w");
+      if (!csv) {
+         perror(csv_path);
+         return 1;
+      }
+      fprintf(csv, "sequence,lo,hi,gain,offset,mean,centre\n");
+   }
+
+   for (i = 0; i < NBUFS; i++) {
+      node_queue(&config, i, meta.fmt.meta.buffersize);
+      node_queue(&stats, i, 0);
+      node_queue(&image, i, 0);
+   }
+   if (xioctl(config.fd, VIDIOC_STREAMON, &config.type) ||
+       xioctl(stats.fd, VIDIOC_STREAMON, &stats.type) ||
+       xioctl(image.fd, VIDIOC_STREAMON, &image.type)) {
+      fprintf(stderr, "fe-agc: stream on: %s\n", strerror(errno));
+      return 1;
+   }
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+   printf("%ux%u %s, front end AGC %.0f..%.0f %%%s\n", params.width, params.height,
+          params.compressed ? "PC1M" : "Y16", low_pct, high_pct,
+          weighted ? ", centre weighted" : "");
+
+   t0 = mono_s();
+   while (!quit && (!frames || fe_frames < (unsigned)frames)) {
+      struct pollfd pfd[3] = {
+         { .fd = config.fd, .events = POLLOUT },
+         { .fd = stats.fd, .events = POLLIN },
+         { .fd = image.fd, .events = POLLIN },
+      };
+      struct v4l2_buffer buf;
+
+      ret = poll(pfd, 3, 2000);
+      if (ret == 0) {
+         fprintf(stderr, "fe-agc: no frame\n");
+         break;
+      }
+      if (ret < 0)
+         continue;
+
+      if ((pfd[0].revents & POLLOUT) && !node_dequeue(&config, &buf))
+         node_queue(&config, buf.index, meta.fmt.meta.buffersize);
+
+      if ((pfd[1].revents & POLLIN) && !node_dequeue(&stats, &buf)) {
+         double t = thread_cpu_s();
+         struct fe_result *r = &history[buf.sequence % HISTORY];
+
+         ret = fe_agc_update(&agc, stats.map[buf.index]);
+         fe_cpu += thread_cpu_s() - t;
+         node_queue(&stats, buf.index, 0);
+         if (ret)
+            continue;
+         fe_frames++;
+         r->sequence = buf.sequence;
+         r->lo = agc.lo;
+         r->hi = agc.hi;
+
+         if (verbose)
+            printf("%6u lo %5.0f hi %5.0f gain %.5f mean %7.1f centre %7.1f\n",
+                   buf.sequence, agc.lo, agc.hi, agc.gain, agc.mean, agc.region_mean[0]);
+         if (csv)
+            fprintf(csv, "%u,%.1f,%.1f,%.6f,%.3f,%.1f,%.1f\n", buf.sequence, agc.lo,
+                    agc.hi, agc.gain, agc.offset, agc.mean, agc.region_mean[0]);
+      }
+
+      if ((pfd[2].revents & POLLIN) && !node_dequeue(&image, &buf)) {
+         if (compare) {
+            const uint8_t *frame = image.map[buf.index];
+            struct fe_result *r = &history[buf.sequence % HISTORY];
+            double t = thread_cpu_s();
+
+            for (y = 0; y < params.height; y++) {
+               const uint8_t *src = frame + y * params.stride;
+
+               if (params.compressed)
+                  y16_comp1_decode(src, line, params.width, params.comp_mode,
+                                   params.comp_offset);
+               y16_agc_convert(cpu_agc, params.compressed ? line : (const uint16_t *)src,
+                               line8, params.width, 0);
+            }
+            y16_agc_update(cpu_agc);
+            cpu_cpu += thread_cpu_s() - t;
+            cpu_frames++;
+
+            /* Stats of the same frame, when already there */
+            if (r->sequence == buf.sequence && fe_frames) {
+               diff_sum += fabsf(r->lo - cpu_agc->lo) + fabsf(r->hi - cpu_agc->hi);
+               compared++;
+            }
+         }
+         node_queue(&image, buf.index, 0);
+      }
+   }
+   t0 = mono_s() - t0;
+
+   printf("frames %u in %.1f s, %.1f fps\n", fe_frames, t0, fe_frames / t0);
+   if (fe_frames)
+      printf("front end: %zu B read/frame, %.1f us/frame, lo %.0f hi %.0f mean %.1f\n",
+             sizeof(((struct pisp_agc_statistics *)0)->histogram) +
+             sizeof(((struct pisp_agc_statistics *)0)->floating),
+             fe_cpu / fe_frames * 1e6, agc.lo, agc.hi, agc.mean);
+   if (cpu_frames) {
+      printf("cpu:       %u B read/frame, %.1f us/frame (y16_agc, 8-bit output included), "
+             "lo %.0f hi %.0f\n", params.stride * params.height,
+             cpu_cpu / cpu_frames * 1e6, cpu_agc->lo, cpu_agc->hi);
+      if (compared)
+         printf("range difference: %.1f codes per bound on average over %u frames\n",
+                diff_sum / (2 * compared), compared);
+   }
+
+   node_close(&image);
+   node_close(&stats);
+   node_close(&config);
+   if (csv)
+      fclose(csv);
+   free(cpu_agc);
+   free(line);
+   free(line8);
+   return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "fe_agc.h"
+
+#define HIST_BINS (65536 >> FE_AGC_HIST_SHIFT)
+
+/*
+ * RGBY gain of 1.0 (4.12). A greyscale input is the same on the three
+ * channels, Y is taken from G alone so that it keeps the 16-bit scale.
+ */
+#define RGBY_GAIN_UNITY (1 << 12)
+
+/* AXI settings of the Raspberry Pi front end configurations */
+static const struct pisp_fe_input_axi_config input_axi = {
+   .maxlen_flags = 0x47,
+   .cache_prot = 0x33,
+   .qos = 0,
+};
+
+static const struct pisp_fe_output_axi_config output_axi = {
+   .maxlen_flags = 0xaf,
+   .cache_prot = 0x32,
+   .qos = 0x8400,
+   .thresh = 0x0140,
+   .throttle = 0x0200,
+};
+
+int fe_agc_config(const struct fe_agc_params *p, struct pisp_fe_config *cfg)
+{
+   struct pisp_fe_agc_stats_config *agc = &cfg->agc_stats;
+   unsigned int zone_w, zone_h, i;
+
+   if (p->width < 2 * PISP_AGC_STATS_SIZE || p->height < 2 * PISP_AGC_STATS_SIZE ||
+       p->width > 0xffff || p->height > 0xffff ||
+       (p->compressed && (p->comp_mode < 1 || p->comp_mode > 3)))
+      return -EINVAL;
+
+   memset(cfg, 0, sizeof(*cfg));
+   cfg->global.enables = PISP_FE_ENABLE_INPUT | PISP_FE_ENABLE_STATS_CROP |
+                         PISP_FE_ENABLE_RGBY | PISP_FE_ENABLE_AGC_STATS |
+                         PISP_FE_ENABLE_OUTPUT0;
+   cfg->global.bayer_order = PISP_BAYER_ORDER_GREYSCALE;
+
+   /* Streamed from the CSI-2 channel, 16 bits per pixel */
+   cfg->input.streaming = 1;
+   cfg->input.format.width = p->width;
+   cfg->input.format.height = p->height;
+   cfg->input.format.format = PISP_IMAGE_FORMAT_BPS_16;
+   cfg->input.axi = input_axi;
+
+   /* Statistics of the whole frame */
+   cfg->stats_crop.width = p->width;
+   cfg->stats_crop.height = p->height;
+
+   cfg->rgby.gain_g = RGBY_GAIN_UNITY;
+
+   /* 16x16 zones centred, even sizes and offsets */
+   zone_w = (p->width / PISP_AGC_STATS_SIZE) & ~1u;
+   zone_h = (p->height / PISP_AGC_STATS_SIZE) & ~1u;
+   agc->size_x = zone_w;
+   agc->size_y = zone_h;
+   agc->offset_x = ((p->width - zone_w * PISP_AGC_STATS_SIZE) / 2) & ~1u;
+   agc->offset_y = ((p->height - zone_h * PISP_AGC_STATS_SIZE) / 2) & ~1u;
+   for (i = 0; i < FE_AGC_ZONES / 2; i++)
+      agc->weights[i] = p->weights ?
+                        (p->weights[2 * i] & 0xf) | (p->weights[2 * i + 1] & 0xf) << 4 :
+                        0x11;
+   agc->row_size_x = p->width;
+   agc->row_size_y = p->height;
+   /* A row sum of 64K 16-bit pixels still fits 32 bits, the Y sums are 64 bits */
+   agc->row_shift = 0;
+   agc->float_shift = 0;
+
+   for (i = 0; i < FE_AGC_REGIONS; i++) {
+      const struct fe_agc_region *r = &p->regions[i];
+
+      if (!r->width || !r->height || r->x + r->width > p->width ||
+          r->y + r->height > p->height)
+         continue;
+      cfg->floating_stats.regions[i].offset_x = r->x;
+      cfg->floating_stats.regions[i].offset_y = r->y;
+      cfg->floating_stats.regions[i].size_x = r->width;
+      cfg->floating_stats.regions[i].size_y = r->height;
+   }
+
+   /* The image as it would be captured on a CSI-2 channel */
+   cfg->ch[0].output.format.width = p->width;
+   cfg->ch[0].output.format.height = p->height;
+   cfg->ch[0].output.format.stride = p->stride;
+   if (p->compressed) {
+      cfg->global.enables |= PISP_FE_ENABLE_COMPRESS0;
+      cfg->ch[0].output.format.format = PISP_IMAGE_FORMAT_BPS_8 +
+                                        p->comp_mode * PISP_IMAGE_FORMAT_COMPRESSION_MODE_1;
+      cfg->ch[0].compress.offset = p->comp_offset;
+      cfg->ch[0].compress.mode = p->comp_mode;
+   } else {
+      cfg->ch[0].output.format.format = PISP_IMAGE_FORMAT_BPS_16;
+   }
+   cfg->output_axi = output_axi;
+
+   /* Every block written for each job, the buffer is queued as is every frame */
+   cfg->dirty_flags = cfg->global.enables;
+   cfg->dirty_flags_extra = PISP_FE_DIRTY_GLOBAL | PISP_FE_DIRTY_FLOATING |
+                            PISP_FE_DIRTY_OUTPUT_AXI;
+   return 0;
+}
+
+void fe_agc_init(struct fe_agc *agc, float low_pct, float high_pct, float speed)
+{
+   memset(agc, 0, sizeof(*agc));
+   agc->low_pct = low_pct;
+   agc->high_pct = high_pct;
+   agc->speed = speed;
+   agc->lo = 0;
+   agc->hi = 65535;
+   agc->gain = 255.0f / 65535;
+}
+
+int fe_agc_update(struct fe_agc *agc, const struct pisp_statistics *stats)
+{
+   /* One read of the stats buffer, which isn't cached */
+   uint32_t hist[HIST_BINS];
+   struct pisp_agc_statistics_zone floating[FE_AGC_REGIONS];
+   uint64_t count = 0, sum = 0, low_count, high_count, acc = 0;
+   float lo = -1, hi = -1;
+   unsigned int i;
+
+   memcpy(hist, stats->agc.histogram, sizeof(hist));
+   memcpy(floating, stats->agc.floating, sizeof(floating));
+
+   for (i = 0; i < HIST_BINS; i++) {
+      count += hist[i];
+      sum += (uint64_t)hist[i] * ((i << FE_AGC_HIST_SHIFT) + (1 << FE_AGC_HIST_SHIFT) / 2);
+   }
+   if (!count)
+      return -1;
+
+   low_count = count * (agc->low_pct / 100.0f);
+   high_count = count * (agc->high_pct / 100.0f);
+   for (i = 0; i < HIST_BINS; i++) {
+      acc += hist[i];
+      if (lo < 0 && acc > low_count)
+         lo = i << FE_AGC_HIST_SHIFT;
+      if (hi < 0 && acc >= high_count) {
+         hi = ((i + 1) << FE_AGC_HIST_SHIFT) - 1;
+         break;
+      }
+   }
+   if (lo < 0)
+      lo = 0;
+   if (hi < 0)
+      hi = 65535;
+
+   agc->lo += agc->speed * (lo - agc->lo);
+   agc->hi += agc->speed * (hi - agc->hi);
+   agc->gain = 255.0f / (agc->hi > agc->lo + 1 ? agc->hi - agc->lo : 1);
+   agc->offset = -agc->lo * agc->gain;
+   agc->mean = (float)sum / count;
+   agc->count = count > UINT32_MAX ? UINT32_MAX : count;
+
+   for (i = 0; i < FE_AGC_REGIONS; i++)
+      agc->region_mean[i] = floating[i].counted ?
+                            (float)floating[i].Y_sum / floating[i].counted : 0;
+   return 0;
+}
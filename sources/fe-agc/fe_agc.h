@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef FE_AGC_H
+#define FE_AGC_H
+
+/*
+ * Thermal automatic gain from the Pi 5 PiSP front end statistics.
+ *
+ * With the CFE front end in the path (csi2 -> pisp-fe -> fe_image0), the
+ * front end builds the histogram of each 16-bit mono frame in the stats
+ * buffer (rp1-cfe-fe_stats) while the frame is written. The AGC then reads
+ * the 4 KB histogram and the region sums instead of the whole image.
+ *
+ * fe_agc_config() fills the rp1-cfe-fe_config buffer for this, and
+ * fe_agc_update() turns the statistics into the range, gain and levels.
+ * Same percentiles and temporal smoothing as y16_agc (libexoy16).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/media/raspberrypi/pisp_fe_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FE_AGC_HIST_SHIFT 6                            /* 1024 bins */
+#define FE_AGC_REGIONS    PISP_FLOATING_STATS_NUM_ZONES
+#define FE_AGC_ZONES      PISP_AGC_STATS_NUM_ZONES     /* 16x16 weights */
+
+struct fe_agc_region {
+   uint16_t x, y, width, height;   /* width 0: unused */
+};
+
+struct fe_agc_params {
+   /* rp1-cfe-fe_image0 format, Y16 or PISP_COMP1_MONO (compressed) */
+   unsigned int width, height;
+   unsigned int stride;
+   int          compressed;
+   unsigned int comp_mode, comp_offset;
+   /* Histogram weight of each zone, 0..15, row by row. NULL: 1 everywhere */
+   const uint8_t *weights;
+   /* Mean level of up to 4 rectangles, e.g. the centre of the scene */
+   struct fe_agc_region regions[FE_AGC_REGIONS];
+};
+
+/* Fill the front end configuration @cfg from @p, 0 or -EINVAL */
+int fe_agc_config(const struct fe_agc_params *p, struct pisp_fe_config *cfg);
+
+struct fe_agc {
+   /* Settings, see fe_agc_init() */
+   float    low_pct;        /* Percentile mapped to 0 */
+   float    high_pct;       /* Percentile mapped to 255 */
+   float    speed;          /* 0..1, weight of the new range per frame */
+   /* Results */
+   float    lo, hi;         /* Range, smoothed */
+   float    gain, offset;   /* 8-bit output = v * gain + offset for the range */
+   float    mean;           /* Mean level of the weighted histogram */
+   float    region_mean[FE_AGC_REGIONS];
+   uint32_t count;          /* Weighted pixels in the last histogram */
+};
+
+void fe_agc_init(struct fe_agc *agc, float low_pct, float high_pct, float speed);
+
+/* Update from the statistics of one frame, -1 if its histogram is empty */
+int fe_agc_update(struct fe_agc *agc, const struct pisp_statistics *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FE_AGC_H */
@@ -0,0 +1,975 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * eg-media-config - media graph configuration of the Pi 5 CFE cameras.
+ *
+ * Native replacement of the media-ctl/v4l2-ctl sequence of
+ * eg_media_configure_rp1_cfe.sh, through the media controller and subdev
+ * ioctls: no text output to parse, a few ms for both CAM/DISP ports.
+ *
+ * Every sensor found on an rp1-cfe media device is configured from its
+ * profile (/etc/eg-media-config.conf):
+ *
+ *   [default]        applies to all cameras
+ *   [<sensor>]       cameras whose sensor entity name starts with <sensor>
+ *   [cam0], [cam1]   camera on the CAM/DISP 0 or 1 port
+ *
+ * the more specific section overriding the keys of the others:
+ *
+ *   mode = raw | comp1 | fe
+ *      raw:   sensor format on rp1-cfe-csi2_ch0
+ *      comp1: mono 14/16-bit formats PISP_COMP1 compressed (PC1M) on
+ *             rp1-cfe-csi2_ch0
+ *      fe:    through the PiSP front end, Y16 on rp1-cfe-fe_image0 and the
+ *             statistics on rp1-cfe-fe_stats
+ *   format = <code>/<W>x<H>, <code> or <W>x<H>
+ *      sensor format set first (e.g. Y16_1X16/640x480), default: as is
+ *   metadata = on | off
+ *      metadata stream of the sensor (second source pad) captured on
+ *      rp1-cfe-embedded, default: off. Once enabled, the node has to be
+ *      streamed with the image one or the CFE doesn't start
+ *
+ * A camera is configured entirely or not at all: on an error, the links and
+ * formats changed are restored. The resulting video nodes are printed one
+ * camera per line, as key=value pairs, or as JSON with -j.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/media.h>
+#include <linux/media-bus-format.h>
+#include <linux/v4l2-subdev.h>
+#include <linux/videodev2.h>
+
+#define V4L2_PIX_FMT_PISP_COMP1_MONO v4l2_fourcc('P', 'C', '1', 'M')
+
+/* Not in the uapi headers before 6.6 */
+#ifndef MEDIA_BUS_FMT_Y16_1X16
+#define MEDIA_BUS_FMT_Y16_1X16 0x202e
+#endif
+
+/* Raspberry Pi kernel headers only */
+#ifndef MEDIA_BUS_FMT_SENSOR_DATA
+#define MEDIA_BUS_FMT_SENSOR_DATA 0x7002
+#endif
+#ifndef V4L2_META_FMT_SENSOR_DATA
+#define V4L2_META_FMT_SENSOR_DATA v4l2_fourcc('S', 'E', 'N', 'S')
+#endif
+
+#define PROFILE_PATH   "/etc/eg-media-config.conf"
+#define CFE_MODEL      "rp1-cfe"
+#define MAX_CAMS       4
+#define MAX_SECTIONS   16
+#define MAX_UNDO       16
+
+/* Pads of the rp1-cfe graph */
+#define SENSOR_PAD_META 1
+#define CSI2_PAD_SINK   0
+#define CSI2_PAD_META   1
+#define CSI2_PAD_CH0    4
+#define CSI2_PAD_CH1    5
+#define FE_PAD_SINK     0
+#define FE_PAD_CONFIG   1
+#define FE_PAD_OUT0     2
+#define FE_PAD_STATS    4
+
+/* CSI-2 receivers of the Pi 5 CAM/DISP ports */
+static const char *const cfe_ports[] = { "1f00110000", "1f00128000" };
+
+static const struct {
+   const char *name;
+   uint32_t    code;
+} mbus_codes[] = {
+   { "Y8_1X8",      MEDIA_BUS_FMT_Y8_1X8 },
+   { "Y10_1X10",    MEDIA_BUS_FMT_Y10_1X10 },
+   { "Y12_1X12",    MEDIA_BUS_FMT_Y12_1X12 },
+   { "Y14_1X14",    MEDIA_BUS_FMT_Y14_1X14 },
+   { "Y16_1X16",    MEDIA_BUS_FMT_Y16_1X16 },
+   { "UYVY8_1X16",  MEDIA_BUS_FMT_UYVY8_1X16 },
+   { "YUYV8_1X16",  MEDIA_BUS_FMT_YUYV8_1X16 },
+   { "RGB888_1X24", MEDIA_BUS_FMT_RGB888_1X24 },
+};
+
+enum mode { MODE_UNSET, MODE_RAW, MODE_COMP1, MODE_FE };
+
+static const char *const mode_names[] = { "", "raw", "comp1", "fe" };
+
+struct profile {
+   enum mode mode;
+   uint32_t  code;           /* Sensor format, 0: as is */
+   unsigned  width, height;
+   int       metadata;       /* 1: on, -1: off, 0: unset */
+};
+
+struct section {
+   char           name[64];
+   struct profile p;
+};
+
+struct topology {
+   struct media_v2_topology topo;
+   struct media_v2_entity *ents;
+   struct media_v2_interface *ifaces;
+   struct media_v2_pad *pads;
+   struct media_v2_link *links;
+};
+
+/* A link or a subdev format as it was before the change */
+struct undo {
+   int      is_link;
+   struct media_link_desc link;
+   char     node[128];
+   struct v4l2_subdev_format fmt;
+};
+
+struct camera {
+   int      port;
+   char     media[32];
+   int      fd;
+   struct topology t;
+   char     sensor[64];
+   char     sensor_node[128], csi2_node[128], fe_node[128];
+   uint32_t sensor_id, csi2_id, ch0_id, meta_id;
+   uint32_t fe_id, fe_image_id, fe_stats_id, fe_config_id;
+   struct profile p;
+
+   /* Result */
+   struct v4l2_mbus_framefmt mbus;
+   struct v4l2_pix_format pix;
+   char     video[128], stats[128], config[128], meta[128];
+   int      error;
+   const char *step;
+
+   struct undo undo[MAX_UNDO];
+   unsigned nundo;
+};
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+static double mono_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static const char *fourcc_str(uint32_t f, char *buf)
+{
+   buf[0] = f & 0xff;
+   buf[1] = (f >> 8) & 0xff;
+   buf[2] = (f >> 16) & 0xff;
+   buf[3] = (f >> 24) & 0xff;
+   buf[4] = 0;
+   return buf;
+}
+
+static const char *code_name(uint32_t code, char *buf, size_t len)
+{
+   unsigned i;
+
+   for (i = 0; i < sizeof(mbus_codes) / sizeof(mbus_codes[0]); i++)
+      if (mbus_codes[i].code == code)
+         return mbus_codes[i].name;
+   snprintf(buf, len, "0x%04x", code);
+   return buf;
+}
+
+/* ---- Profiles --------------------------------------------------------- */
+
+static char *trim(char *s)
+{
+   char *e;
+
+   while (isspace((unsigned char)*s))
+      s++;
+   e = s + strlen(s);
+   while (e > s && isspace((unsigned char)e[-1]))
+      *--e = 0;
+   return s;
+}
+
+/* <code>/<W>x<H>, <code> or <W>x<H> */
+static int parse_format(const char *s, struct profile *p)
+{
+   const char *size = strchr(s, '/');
+   size_t len = size ? (size_t)(size - s) : strlen(s);
+   unsigned i;
+
+   if (!size && isdigit((unsigned char)*s))
+      return sscanf(s, "%ux%u", &p->width, &p->height) == 2 ? 0 : -EINVAL;
+
+   for (i = 0; i < sizeof(mbus_codes) / sizeof(mbus_codes[0]); i++)
+      if (strlen(mbus_codes[i].name) == len && !strncmp(mbus_codes[i].name, s, len))
+         p->code = mbus_codes[i].code;
+   if (!p->code && !strncmp(s, "0x", 2))
+      p->code = strtoul(s, NULL, 16);
+   if (!p->code)
+      return -EINVAL;
+   if (size && sscanf(size + 1, "%ux%u", &p->width, &p->height) != 2)
+      return -EINVAL;
+   return 0;
+}
+
+static int parse_mode(const char *s, enum mode *mode)
+{
+   unsigned i;
+
+   for (i = MODE_RAW; i <= MODE_FE; i++)
+      if (!strcmp(s, mode_names[i])) {
+         *mode = i;
+         return 0;
+      }
+   return -EINVAL;
+}
+
+/* Sections of @path, -errno when it can't be read or parsed */
+static int profile_load(const char *path, struct section *sec, unsigned *nsec)
+{
+   char line[256];
+   struct section *cur = NULL;
+   unsigned n = 0;
+   int lineno = 0, ret = 0;
+   FILE *f;
+
+   *nsec = 0;
+   f = fopen(path, "r");
+   if (!f)
+      return -errno;
+   while (fgets(line, sizeof(line), f)) {
+      char *s = trim(line), *val;
+
+      lineno++;
+      if (!*s || *s == '#')
+         continue;
+      if (*s == '[') {
+         char *end = strchr(s, ']');
+
+         if (!end || n == MAX_SECTIONS) {
+            ret = -EINVAL;
+            break;
+         }
+         *end = 0;
+         cur = &sec[n++];
+         memset(cur, 0, sizeof(*cur));
+         snprintf(cur->name, sizeof(cur->name), "%s", trim(s + 1));
+         continue;
+      }
+      val = strchr(s, '=');
+      if (!cur || !val) {
+         ret = -EINVAL;
+         break;
+      }
+      *val++ = 0;
+      s = trim(s);
+      val = trim(val);
+      if (!strcmp(s, "mode"))
+         ret = parse_mode(val, &cur->p.mode);
+      else if (!strcmp(s, "format"))
+         ret = parse_format(val, &cur->p);
+      else if (!strcmp(s, "metadata"))
+         ret = !strcmp(val, "on") ? (cur->p.metadata = 1, 0) :
+               !strcmp(val, "off") ? (cur->p.metadata = -1, 0) : -EINVAL;
+      else
+         ret = -EINVAL;
+      if (ret)
+         break;
+   }
+   fclose(f);
+   if (ret)
+      fprintf(stderr, "%s:%d: invalid line\n", path, lineno);
+   *nsec = n;
+   return ret;
+}
+
+static void profile_merge(struct profile *p, const struct profile *from)
+{
+   if (from->mode)
+      p->mode = from->mode;
+   if (from->code)
+      p->code = from->code;
+   if (from->width) {
+      p->width = from->width;
+      p->height = from->height;
+   }
+   if (from->metadata)
+      p->metadata = from->metadata;
+}
+
+/* [default], then [<sensor>], then [camN] */
+static void profile_select(struct camera *cam, const struct section *sec, unsigned nsec)
+{
+   char port[8];
+   unsigned i;
+
+   snprintf(port, sizeof(port), "cam%d", cam->port);
+   cam->p.mode = MODE_RAW;
+   for (i = 0; i < nsec; i++)
+      if (!strcmp(sec[i].name, "default"))
+         profile_merge(&cam->p, &sec[i].p);
+   for (i = 0; i < nsec; i++)
+      if (strcmp(sec[i].name, "default") && strncmp(sec[i].name, "cam", 3) &&
+          !strncmp(cam->sensor, sec[i].name, strlen(sec[i].name)))
+         profile_merge(&cam->p, &sec[i].p);
+   for (i = 0; i < nsec; i++)
+      if (!strcmp(sec[i].name, port))
+         profile_merge(&cam->p, &sec[i].p);
+}
+
+/* ---- Media graph ------------------------------------------------------ */
+
+static void topology_free(struct topology *t)
+{
+   free(t->ents);
+   free(t->ifaces);
+   free(t->pads);
+   free(t->links);
+}
+
+static int topology_get(int fd, struct topology *t)
+{
+   int ret;
+
+   memset(t, 0, sizeof(*t));
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &t->topo);
+   if (ret)
+      return ret;
+   t->ents = calloc(t->topo.num_entities, sizeof(*t->ents));
+   t->ifaces = calloc(t->topo.num_interfaces, sizeof(*t->ifaces));
+   t->pads = calloc(t->topo.num_pads, sizeof(*t->pads));
+   t->links = calloc(t->topo.num_links, sizeof(*t->links));
+   if (!t->ents || !t->ifaces || !t->pads || !t->links) {
+      topology_free(t);
+      return -ENOMEM;
+   }
+   t->topo.ptr_entities = (uintptr_t)t->ents;
+   t->topo.ptr_interfaces = (uintptr_t)t->ifaces;
+   t->topo.ptr_pads = (uintptr_t)t->pads;
+   t->topo.ptr_links = (uintptr_t)t->links;
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &t->topo);
+   if (ret)
+      topology_free(t);
+   return ret;
+}
+
+static uint32_t topology_entity(const struct topology *t, const char *name)
+{
+   unsigned i;
+
+   for (i = 0; i < t->topo.num_entities; i++)
+      if (!strcmp(t->ents[i].name, name))
+         return t->ents[i].id;
+   return 0;
+}
+
+static const struct media_v2_pad *topology_pad(const struct topology *t, uint32_t id)
+{
+   unsigned i;
+
+   for (i = 0; i < t->topo.num_pads; i++)
+      if (t->pads[i].id == id)
+         return &t->pads[i];
+   return NULL;
+}
+
+/* Data link @src:@src_pad -> @sink:@sink_pad */
+static const struct media_v2_link *topology_link(const struct topology *t, uint32_t src,
+                                                 unsigned src_pad, uint32_t sink,
+                                                 unsigned sink_pad)
+{
+   unsigned i;
+
+   for (i = 0; i < t->topo.num_links; i++) {
+      const struct media_v2_link *l = &t->links[i];
+      const struct media_v2_pad *s, *d;
+
+      if ((l->flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_DATA_LINK)
+         continue;
+      s = topology_pad(t, l->source_id);
+      d = topology_pad(t, l->sink_id);
+      if (s && d && s->entity_id == src && s->index == src_pad &&
+          d->entity_id == sink && d->index == sink_pad)
+         return l;
+   }
+   return NULL;
+}
+
+/* /dev path of the character device @major:@minor */
+static int devnode_path(unsigned major, unsigned minor, char *path, size_t len)
+{
+   char uevent[64], line[128];
+   int ret = -ENOENT;
+   FILE *f;
+
+   snprintf(uevent, sizeof(uevent), "/sys/dev/char/%u:%u/uevent", major, minor);
+   f = fopen(uevent, "r");
+   if (!f)
+      return -errno;
+   while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, "DEVNAME=", 8)) {
+         line[strcspn(line, "\n")] = 0;
+         snprintf(path, len, "/dev/%s", line + 8);
+         ret = 0;
+         break;
+      }
+   }
+   fclose(f);
+   return ret;
+}
+
+/* Device node (video or subdev) of the entity @id */
+static int topology_devnode(const struct topology *t, uint32_t id, char *path, size_t len)
+{
+   unsigned i, j;
+
+   for (i = 0; i < t->topo.num_links; i++) {
+      if ((t->links[i].flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_INTERFACE_LINK ||
+          t->links[i].sink_id != id)
+         continue;
+      for (j = 0; j < t->topo.num_interfaces; j++)
+         if (t->ifaces[j].id == t->links[i].source_id)
+            return devnode_path(t->ifaces[j].devnode.major,
+                                t->ifaces[j].devnode.minor, path, len);
+   }
+   return -ENOENT;
+}
+
+/* Camera of the CFE media device @fd, -ENODEV without a sensor */
+static int camera_probe(struct camera *cam, int fd, const char *bus_info)
+{
+   struct topology *t = &cam->t;
+   unsigned i;
+   int ret;
+
+   ret = topology_get(fd, t);
+   if (ret)
+      return ret;
+   for (i = 0; i < t->topo.num_entities && !cam->sensor_id; i++)
+      if (t->ents[i].function == MEDIA_ENT_F_CAM_SENSOR) {
+         cam->sensor_id = t->ents[i].id;
+         snprintf(cam->sensor, sizeof(cam->sensor), "%s", t->ents[i].name);
+      }
+   cam->csi2_id = topology_entity(t, "csi2");
+   cam->ch0_id = topology_entity(t, "rp1-cfe-csi2_ch0");
+   cam->meta_id = topology_entity(t, "rp1-cfe-embedded");
+   cam->fe_id = topology_entity(t, "pisp-fe");
+   cam->fe_image_id = topology_entity(t, "rp1-cfe-fe_image0");
+   cam->fe_stats_id = topology_entity(t, "rp1-cfe-fe_stats");
+   cam->fe_config_id = topology_entity(t, "rp1-cfe-fe_config");
+   if (!cam->sensor_id || !cam->csi2_id || !cam->ch0_id ||
+       topology_devnode(t, cam->sensor_id, cam->sensor_node, sizeof(cam->sensor_node)) ||
+       topology_devnode(t, cam->csi2_id, cam->csi2_node, sizeof(cam->csi2_node))) {
+      topology_free(t);
+      return -ENODEV;
+   }
+
+   cam->fd = fd;
+   cam->port = -1;
+   for (i = 0; i < sizeof(cfe_ports) / sizeof(cfe_ports[0]); i++)
+      if (strstr(bus_info, cfe_ports[i]))
+         cam->port = i;
+   return 0;
+}
+
+static int link_set(struct camera *cam, uint32_t src, unsigned src_pad, uint32_t sink,
+                    unsigned sink_pad, int enable)
+{
+   const struct media_v2_link *l = topology_link(&cam->t, src, src_pad, sink, sink_pad);
+   struct media_link_desc desc = {
+      .source = { .entity = src, .index = src_pad },
+      .sink = { .entity = sink, .index = sink_pad },
+   };
+   int ret;
+
+   if (!l)
+      return enable ? -ENOENT : 0;
+   if (!!(l->flags & MEDIA_LNK_FL_ENABLED) == !!enable)
+      return 0;
+   if (l->flags & MEDIA_LNK_FL_IMMUTABLE)
+      return -EPERM;
+
+   desc.flags = enable ? MEDIA_LNK_FL_ENABLED : 0;
+   ret = xioctl(cam->fd, MEDIA_IOC_SETUP_LINK, &desc);
+   if (!ret && cam->nundo < MAX_UNDO) {
+      struct undo *u = &cam->undo[cam->nundo++];
+
+      u->is_link = 1;
+      u->link = desc;
+      u->link.flags = l->flags & MEDIA_LNK_FL_ENABLED;
+   }
+   return ret;
+}
+
+static int subdev_fmt(const char *node, unsigned long req, struct v4l2_subdev_format *fmt)
+{
+   int fd, ret;
+
+   fd = open(node, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return -errno;
+   ret = xioctl(fd, req, fmt);
+   close(fd);
+   return ret;
+}
+
+static int fmt_get(const char *node, unsigned pad, struct v4l2_mbus_framefmt *mbus)
+{
+   struct v4l2_subdev_format fmt = {
+      .which = V4L2_SUBDEV_FORMAT_ACTIVE,
+      .pad = pad,
+   };
+   int ret;
+
+   ret = subdev_fmt(node, VIDIOC_SUBDEV_G_FMT, &fmt);
+   if (!ret)
+      *mbus = fmt.format;
+   return ret;
+}
+
+/* Set the format of @node:@pad, -EINVAL when the subdev changes it */
+static int fmt_set(struct camera *cam, const char *node, unsigned pad,
+                   const struct v4l2_mbus_framefmt *mbus)
+{
+   struct v4l2_subdev_format old = {
+      .which = V4L2_SUBDEV_FORMAT_ACTIVE,
+      .pad = pad,
+   };
+   struct v4l2_subdev_format fmt = old;
+   int ret;
+
+   ret = subdev_fmt(node, VIDIOC_SUBDEV_G_FMT, &old);
+   if (ret)
+      return ret;
+   if (old.format.code == mbus->code && old.format.width == mbus->width &&
+       old.format.height == mbus->height && old.format.field == mbus->field)
+      return 0;
+
+   fmt.format = *mbus;
+   ret = subdev_fmt(node, VIDIOC_SUBDEV_S_FMT, &fmt);
+   if (!ret && cam->nundo < MAX_UNDO) {
+      struct undo *u = &cam->undo[cam->nundo++];
+
+      u->is_link = 0;
+      snprintf(u->node, sizeof(u->node), "%s", node);
+      u->fmt = old;
+   }
+   if (!ret && (fmt.format.code != mbus->code || fmt.format.width != mbus->width ||
+                fmt.format.height != mbus->height))
+      ret = -EINVAL;
+   return ret;
+}
+
+static void camera_rollback(struct camera *cam)
+{
+   while (cam->nundo) {
+      struct undo *u = &cam->undo[--cam->nundo];
+
+      if (u->is_link)
+         xioctl(cam->fd, MEDIA_IOC_SETUP_LINK, &u->link);
+      else
+         subdev_fmt(u->node, VIDIOC_SUBDEV_S_FMT, &u->fmt);
+   }
+}
+
+/* Format of the video node @video: first one of the bus format, or @fourcc */
+static int video_set(const char *video, const struct v4l2_mbus_framefmt *mbus, uint32_t fourcc,
+                     struct v4l2_pix_format *pix)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_fmtdesc desc = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .mbus_code = mbus->code,
+   };
+   int fd, ret = 0;
+
+   fd = open(video, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return -errno;
+   if (!fourcc) {
+      ret = xioctl(fd, VIDIOC_ENUM_FMT, &desc);
+      fourcc = desc.pixelformat;
+   }
+   if (!ret) {
+      fmt.fmt.pix.width = mbus->width;
+      fmt.fmt.pix.height = mbus->height;
+      fmt.fmt.pix.pixelformat = fourcc;
+      fmt.fmt.pix.field = V4L2_FIELD_NONE;
+      ret = xioctl(fd, VIDIOC_S_FMT, &fmt);
+   }
+   if (!ret && fmt.fmt.pix.pixelformat != fourcc)
+      ret = -EINVAL;
+   if (!ret)
+      *pix = fmt.fmt.pix;
+   close(fd);
+   return ret;
+}
+
+/* Buffer size of the metadata node @video, at least @size */
+static int meta_set(const char *video, uint32_t size)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_META_CAPTURE };
+   int fd, ret;
+
+   fd = open(video, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return -errno;
+   fmt.fmt.meta.dataformat = V4L2_META_FMT_SENSOR_DATA;
+   fmt.fmt.meta.buffersize = size;
+   ret = xioctl(fd, VIDIOC_S_FMT, &fmt);
+   if (!ret && fmt.fmt.meta.buffersize < size)
+      ret = -EINVAL;
+   close(fd);
+   return ret;
+}
+
+static int video_get(const char *video, struct v4l2_pix_format *pix)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   int fd, ret;
+
+   fd = open(video, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return -errno;
+   ret = xioctl(fd, VIDIOC_G_FMT, &fmt);
+   if (!ret)
+      *pix = fmt.fmt.pix;
+   close(fd);
+   return ret;
+}
+
+#define STEP(cam, what, call)             \
+   do {                                   \
+      (cam)->step = (what);               \
+      ret = (call);                       \
+      if (ret)                            \
+         return ret;                      \
+   } while (0)
+
+/*
+ * Metadata of the sensor second source pad, on CSI-2 channel 1. The sensor
+ * link is immutable, the CFE captures it when the rp1-cfe-embedded link is
+ * enabled.
+ */
+static int camera_apply_meta(struct camera *cam)
+{
+   struct v4l2_mbus_framefmt meta;
+   int ret;
+
+   if (cam->p.metadata <= 0) {
+      if (cam->meta_id)
+         STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH1, cam->meta_id, 0, 0));
+      return 0;
+   }
+
+   cam->step = "sensor metadata pad";
+   if (!cam->meta_id || fmt_get(cam->sensor_node, SENSOR_PAD_META, &meta) ||
+       meta.code != MEDIA_BUS_FMT_SENSOR_DATA)
+      return -ENOENT;
+   STEP(cam, "csi2 metadata format", fmt_set(cam, cam->csi2_node, CSI2_PAD_META, &meta));
+   STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH1, cam->meta_id, 0, 1));
+   STEP(cam, "video nodes", topology_devnode(&cam->t, cam->meta_id, cam->meta,
+                                             sizeof(cam->meta)));
+   STEP(cam, "metadata format", meta_set(cam->meta, meta.width * meta.height));
+   return 0;
+}
+
+static int camera_apply(struct camera *cam)
+{
+   struct v4l2_mbus_framefmt mbus, out;
+   int ret;
+
+   /* Sensor format, from the profile or as it is */
+   STEP(cam, "sensor format", fmt_get(cam->sensor_node, 0, &mbus));
+   if (cam->p.code || cam->p.width) {
+      if (cam->p.code)
+         mbus.code = cam->p.code;
+      if (cam->p.width) {
+         mbus.width = cam->p.width;
+         mbus.height = cam->p.height;
+      }
+      STEP(cam, "sensor format", fmt_set(cam, cam->sensor_node, 0, &mbus));
+   }
+   mbus.field = V4L2_FIELD_NONE;
+   cam->mbus = mbus;
+   STEP(cam, "csi2 sink format", fmt_set(cam, cam->csi2_node, CSI2_PAD_SINK, &mbus));
+
+   /* The CFE compresses, and the front end takes, the 16-bit version of the code */
+   out = mbus;
+   if (cam->p.mode != MODE_RAW) {
+      if (mbus.code != MEDIA_BUS_FMT_Y14_1X14 && mbus.code != MEDIA_BUS_FMT_Y16_1X16) {
+         cam->step = "mono 14/16-bit sensor format";
+         return -EINVAL;
+      }
+      out.code = MEDIA_BUS_FMT_Y16_1X16;
+   }
+
+   if (cam->p.mode == MODE_FE) {
+      if (!cam->fe_id || !cam->fe_image_id || !cam->fe_stats_id || !cam->fe_config_id) {
+         cam->step = "pisp-fe";
+         return -ENOENT;
+      }
+      STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH0, cam->ch0_id, 0, 0));
+      STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH0, cam->fe_id,
+                                  FE_PAD_SINK, 1));
+      STEP(cam, "links", link_set(cam, cam->fe_id, FE_PAD_OUT0, cam->fe_image_id, 0, 1));
+      STEP(cam, "links", link_set(cam, cam->fe_id, FE_PAD_STATS, cam->fe_stats_id, 0, 1));
+      STEP(cam, "links", link_set(cam, cam->fe_config_id, 0, cam->fe_id,
+                                  FE_PAD_CONFIG, 1));
+      STEP(cam, "csi2 source format", fmt_set(cam, cam->csi2_node, CSI2_PAD_CH0, &out));
+      STEP(cam, "pisp-fe", topology_devnode(&cam->t, cam->fe_id, cam->fe_node,
+                                            sizeof(cam->fe_node)));
+      STEP(cam, "pisp-fe sink format", fmt_set(cam, cam->fe_node, FE_PAD_SINK, &out));
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_image_id, cam->video,
+                                                sizeof(cam->video)));
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_stats_id, cam->stats,
+                                                sizeof(cam->stats)));
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_config_id, cam->config,
+                                                sizeof(cam->config)));
+      STEP(cam, "video format", video_set(cam->video, &out, V4L2_PIX_FMT_Y16, &cam->pix));
+      return camera_apply_meta(cam);
+   }
+
+   if (cam->fe_id)
+      STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH0, cam->fe_id,
+                                  FE_PAD_SINK, 0));
+   STEP(cam, "links", link_set(cam, cam->csi2_id, CSI2_PAD_CH0, cam->ch0_id, 0, 1));
+   STEP(cam, "csi2 source format", fmt_set(cam, cam->csi2_node, CSI2_PAD_CH0, &out));
+   STEP(cam, "video nodes", topology_devnode(&cam->t, cam->ch0_id, cam->video,
+                                             sizeof(cam->video)));
+   STEP(cam, "video format",
+        video_set(cam->video, &out,
+                  cam->p.mode == MODE_COMP1 ? V4L2_PIX_FMT_PISP_COMP1_MONO : 0, &cam->pix));
+   return camera_apply_meta(cam);
+}
+
+/* Configuration in place, with -l */
+static int camera_query(struct camera *cam)
+{
+   const struct media_v2_link *l = cam->fe_id ?
+      topology_link(&cam->t, cam->csi2_id, CSI2_PAD_CH0, cam->fe_id, FE_PAD_SINK) : NULL;
+   const struct media_v2_link *m = cam->meta_id ?
+      topology_link(&cam->t, cam->csi2_id, CSI2_PAD_CH1, cam->meta_id, 0) : NULL;
+   int ret;
+
+   STEP(cam, "sensor format", fmt_get(cam->sensor_node, 0, &cam->mbus));
+   if (l && (l->flags & MEDIA_LNK_FL_ENABLED)) {
+      cam->p.mode = MODE_FE;
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_image_id, cam->video,
+                                                sizeof(cam->video)));
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_stats_id, cam->stats,
+                                                sizeof(cam->stats)));
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->fe_config_id, cam->config,
+                                                sizeof(cam->config)));
+   } else {
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->ch0_id, cam->video,
+                                                sizeof(cam->video)));
+   }
+   STEP(cam, "video format", video_get(cam->video, &cam->pix));
+   if (cam->p.mode != MODE_FE)
+      cam->p.mode = cam->pix.pixelformat == V4L2_PIX_FMT_PISP_COMP1_MONO ? MODE_COMP1
+                                                                         : MODE_RAW;
+   if (m && (m->flags & MEDIA_LNK_FL_ENABLED))
+      STEP(cam, "video nodes", topology_devnode(&cam->t, cam->meta_id, cam->meta,
+                                                sizeof(cam->meta)));
+   return 0;
+}
+
+/* ---- Output ----------------------------------------------------------- */
+
+static void print_text(const struct camera *cam, const char *field)
+{
+   char code[16], fcc[5];
+
+   if (field) {
+      const char *v = !strcmp(field, "video") ? cam->video :
+                      !strcmp(field, "stats") ? cam->stats :
+                      !strcmp(field, "config") ? cam->config :
+                      !strcmp(field, "metadata") ? cam->meta :
+                      !strcmp(field, "media") ? cam->media :
+                      !strcmp(field, "sensor") ? cam->sensor : "";
+
+      if (!cam->error && *v)
+         printf("%s\n", v);
+      return;
+   }
+
+   printf("cam%d sensor=\"%s\" media=%s mode=%s", cam->port, cam->sensor, cam->media,
+          mode_names[cam->p.mode]);
+   if (cam->error) {
+      printf(" error=\"%s: %s\"\n", cam->step, strerror(-cam->error));
+      return;
+   }
+   printf(" format=%s/%ux%u video=%s pixelformat=%s bytesperline=%u",
+          code_name(cam->mbus.code, code, sizeof(code)), cam->mbus.width, cam->mbus.height,
+          cam->video, fourcc_str(cam->pix.pixelformat, fcc), cam->pix.bytesperline);
+   if (*cam->stats)
+      printf(" stats=%s config=%s", cam->stats, cam->config);
+   if (*cam->meta)
+      printf(" metadata=%s", cam->meta);
+   printf("\n");
+}
+
+static void print_json(const struct camera *cams, unsigned ncams, double ms)
+{
+   char code[16], fcc[5];
+   unsigned i;
+
+   printf("{\"elapsed_ms\": %.2f, \"cameras\": [", ms);
+   for (i = 0; i < ncams; i++) {
+      const struct camera *cam = &cams[i];
+
+      printf("%s\n  {\"port\": %d, \"sensor\": \"%s\", \"media\": \"%s\", \"mode\": \"%s\"",
+             i ? "," : "", cam->port, cam->sensor, cam->media, mode_names[cam->p.mode]);
+      if (cam->error) {
+         printf(", \"error\": \"%s: %s\"}", cam->step, strerror(-cam->error));
+         continue;
+      }
+      printf(", \"code\": \"%s\", \"width\": %u, \"height\": %u, \"video\": \"%s\","
+             " \"pixelformat\": \"%s\", \"bytesperline\": %u, \"sizeimage\": %u",
+             code_name(cam->mbus.code, code, sizeof(code)), cam->mbus.width,
+             cam->mbus.height, cam->video, fourcc_str(cam->pix.pixelformat, fcc),
+             cam->pix.bytesperline, cam->pix.sizeimage);
+      if (*cam->stats)
+         printf(", \"stats\": \"%s\", \"config\": \"%s\"", cam->stats, cam->config);
+      if (*cam->meta)
+         printf(", \"metadata\": \"%s\"", cam->meta);
+      printf("}");
+   }
+   printf("%s]}\n", ncams ? "\n" : "");
+}
+
+/* ---- Main ------------------------------------------------------------- */
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: eg-media-config [-c PROFILE] [-m raw|comp1|fe] [-p PORT] [-l] [-j] [-f FIELD]\n"
+      "                       [-v]\n"
+      "  -c PROFILE file of the camera profiles (default: " PROFILE_PATH ")\n"
+      "  -m MODE    mode of all the cameras, over the profiles\n"
+      "  -p PORT    only the camera of the CAM/DISP port PORT (0 or 1)\n"
+      "  -l         print the configuration in place, change nothing\n"
+      "  -j         JSON output\n"
+      "  -f FIELD   print only FIELD of each camera: video, stats, config,\n"
+      "             metadata, media or sensor\n"
+      "  -v         time taken, on stderr\n");
+}
+
+int main(int argc, char **argv)
+{
+   static struct camera cams[MAX_CAMS];
+   struct section sec[MAX_SECTIONS];
+   const char *profile = NULL, *field = NULL;
+   enum mode mode = MODE_UNSET;
+   unsigned nsec = 0, ncams = 0, i;
+   int port = -1, list = 0, json = 0, verbose = 0, failed = 0, opt, ret;
+   double start = mono_ms();
+
+   while ((opt = getopt(argc, argv, "c:m:p:ljf:vh")) != -1) {
+      switch (opt) {
+         case 'c': profile = optarg; break;
+         case 'm':
+            if (parse_mode(optarg, &mode)) {
+               usage();
+               return 1;
+            }
+            break;
+         case 'p': port = atoi(optarg); break;
+         case 'l': list = 1; break;
+         case 'j': json = 1; break;
+         case 'f': field = optarg; break;
+         case 'v': verbose = 1; break;
+         default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   /* No profile file: all cameras raw */
+   if (!list) {
+      ret = profile_load(profile ? profile : PROFILE_PATH, sec, &nsec);
+      if (ret && (profile || ret != -ENOENT)) {
+         fprintf(stderr, "%s: %s\n", profile ? profile : PROFILE_PATH, strerror(-ret));
+         return 1;
+      }
+   }
+
+   for (i = 0; i < 64 && ncams < MAX_CAMS; i++) {
+      struct camera *cam = &cams[ncams];
+      struct media_device_info info;
+      int fd;
+
+      snprintf(cam->media, sizeof(cam->media), "/dev/media%u", i);
+      fd = open(cam->media, O_RDWR | O_CLOEXEC);
+      if (fd < 0)
+         continue;
+      if (xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info) || strcmp(info.model, CFE_MODEL) ||
+          camera_probe(cam, fd, info.bus_info)) {
+         close(fd);
+         continue;
+      }
+      if (cam->port < 0)
+         cam->port = ncams;
+      if (port >= 0 && cam->port != port) {
+         topology_free(&cam->t);
+         close(fd);
+         continue;
+      }
+      ncams++;
+   }
+
+   for (i = 0; i < ncams; i++) {
+      struct camera *cam = &cams[i];
+
+      if (list) {
+         cam->error = camera_query(cam);
+      } else {
+         profile_select(cam, sec, nsec);
+         if (mode)
+            cam->p.mode = mode;
+         cam->error = camera_apply(cam);
+         if (cam->error)
+            camera_rollback(cam);
+      }
+      if (cam->error)
+         failed = 1;
+   }
+
+   if (json) {
+      print_json(cams, ncams, mono_ms() - start);
+   } else {
+      for (i = 0; i < ncams; i++)
+         print_text(&cams[i], field);
+   }
+   if (verbose)
+      fprintf(stderr, "eg-media-config: %u camera(s) in %.2f ms\n", ncams, mono_ms() - start);
+
+   for (i = 0; i < ncams; i++) {
+      topology_free(&cams[i].t);
+      close(cams[i].fd);
+   }
+   if (!ncams)
+      fprintf(stderr, "eg-media-config: no camera found on the CFEs\n");
+   return failed || !ncams;
+}
@@ -0,0 +1,230 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * gencp-crc-bench - GENCP_crc16() of libgencp against the byte loop it
+ * replaced.
+ *
+ * Checks the checksum of libgencp (words, NEON on aarch64) against the
+ * reference byte loop: random payloads of every length up to 300 bytes at
+ * the 4 start offsets, all-0x00 and all-0xFF buffers, and payloads which sum
+ * to 0xFFFF (the RFC768 special case). Then reports the time per checksum
+ * of both across payload sizes. Exits 1 on a mismatch.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gencp_common.h"
+
+#define MAX_CHECK_LEN   300
+#define MAX_BENCH_LEN   65536
+
+static const uint32_t bench_sizes[] = { 8, 24, 64, 256, 1024, 4096, 16384, 65536 };
+
+static double now_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* GENCP_crc16() as it was, one byte at a time */
+static uint16_t crc16_ref(const uint8_t *buf, uint32_t len)
+{
+   uint32_t sum = 0;
+   uint32_t i;
+
+   for (i = 0; i < len; i++) {
+      if (i & 1)
+         sum += (uint32_t)buf[i];
+      else
+         sum += (uint32_t)buf[i] << 8;
+   }
+
+   while (sum >> 16)
+      sum = (sum & 0xFFFF) + (sum >> 16);
+
+   if (sum == 0xFFFF)
+      sum = 0;
+
+   return ~sum;
+}
+
+/* Ones' complement sum of @buf as big-endian words, folded, before the special case */
+static uint32_t sum16(const uint8_t *buf, uint32_t len)
+{
+   uint32_t sum = 0;
+   uint32_t i;
+
+   for (i = 0; i < len; i++)
+      sum += (i & 1) ? buf[i] : (uint32_t)buf[i] << 8;
+   while (sum >> 16)
+      sum = (sum & 0xFFFF) + (sum >> 16);
+   return sum;
+}
+
+static int check(uint8_t *buf, uint32_t len, const char *what, unsigned int *failures)
+{
+   uint16_t ref = crc16_ref(buf, len);
+   uint16_t crc = GENCP_crc16(buf, len);
+
+   if (crc == ref)
+      return 0;
+   if ((*failures)++ < 10)
+      fprintf(stderr, "gencp-crc-bench: %s, %u bytes at offset %u: 0x%04x, expected 0x%04x\n",
+              what, len, (unsigned int)((uintptr_t)buf & 3), crc, ref);
+   return 1;
+}
+
+static unsigned int run_checks(uint8_t *mem)
+{
+   unsigned int failures = 0, checks = 0;
+   uint32_t len, ofs, sum, pad;
+
+   for (ofs = 0; ofs < 4; ofs++) {
+      uint8_t *buf = mem + ofs;
+
+      for (len = 0; len <= MAX_CHECK_LEN; len++) {
+         uint32_t i;
+
+         for (i = 0; i < len; i++)
+            buf[i] = rand();
+         checks++;
+         check(buf, len, "random", &failures);
+
+         memset(buf, 0x00, len);
+         checks++;
+         check(buf, len, "0x00", &failures);
+
+         memset(buf, 0xFF, len);
+         checks++;
+         check(buf, len, "0xFF", &failures);
+
+         /*
+          * Random payload followed by the big-endian word bringing its sum
+          * to 0xFFFF, at an even length so that the word is aligned on the
+          * GenCP words.
+          */
+         if (len < 2 || (len & 1))
+            continue;
+         for (i = 0; i < len - 2; i++)
+            buf[i] = rand();
+         buf[len - 2] = 0;
+         buf[len - 1] = 0;
+         sum = sum16(buf, len);
+         pad = 0xFFFF - sum;
+         buf[len - 2] = pad >> 8;
+         buf[len - 1] = pad;
+         if (sum16(buf, len) != 0xFFFF) {
+            fprintf(stderr, "gencp-crc-bench: no 0xFFFF payload of %u bytes\n", len);
+            failures++;
+            continue;
+         }
+         checks++;
+         check(buf, len, "sum 0xFFFF", &failures);
+      }
+   }
+
+   printf("%u checks, %u mismatches\n", checks, failures);
+   return failures;
+}
+
+static void bench(uint8_t *buf, double min_time)
+{
+   volatile uint16_t sink = 0;
+   unsigned int s;
+
+   printf("%8s %12s %12s %8s\n", "bytes", "byte loop", "GENCP_crc16", "speedup");
+   for (s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++) {
+      uint32_t len = bench_sizes[s];
+      double t_ref, t_new, start;
+      unsigned long n, iters = 1;
+
+      /* Enough iterations for min_time of the byte loop */
+      for (;;) {
+         start = now_s();
+         for (n = 0; n < iters; n++)
+            sink += crc16_ref(buf, len);
+         t_ref = now_s() - start;
+         if (t_ref >= min_time)
+            break;
+         iters *= 2;
+      }
+
+      start = now_s();
+      for (n = 0; n < iters; n++)
+         sink += GENCP_crc16(buf, len);
+      t_new = now_s() - start;
+
+      printf("%8u %9.1f ns %9.1f ns %7.1fx\n", len, t_ref / iters * 1e9,
+             t_new / iters * 1e9, t_ref / t_new);
+   }
+   (void)sink;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: gencp-crc-bench [-s SEED] [-t SECONDS] [-c]\n"
+      "  -s SEED     seed of the random payloads (default: time)\n"
+      "  -t SECONDS  minimum time per payload size (default: 0.2)\n"
+      "  -c          checks only, no timing\n");
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int seed = time(NULL);
+   double min_time = 0.2;
+   int check_only = 0, opt;
+   uint8_t *mem;
+   uint32_t i;
+
+   while ((opt = getopt(argc, argv, "s:t:ch")) != -1) {
+      switch (opt) {
+      case 's':
+         seed = strtoul(optarg, NULL, 0);
+         break;
+      case 't':
+         min_time = atof(optarg);
+         break;
+      case 'c':
+         check_only = 1;
+         break;
+      default:
+         usage();
+         return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   /* Aligned, the checks start at offsets 0 to 3 from it */
+   mem = aligned_alloc(64, MAX_BENCH_LEN + 64);
+   if (!mem) {
+      perror("gencp-crc-bench");
+      return 1;
+   }
+
+   printf("seed %u\n", seed);
+   srand(seed);
+   if (run_checks(mem)) {
+      free(mem);
+      return 1;
+   }
+
+   if (!check_only) {
+      for (i = 0; i < MAX_BENCH_LEN; i++)
+         mem[i] = rand();
+      bench(mem, min_time);
+   }
+
+   free(mem);
+   return 0;
+}
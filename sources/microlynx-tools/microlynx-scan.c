@@ -0,0 +1,223 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * microlynx-scan - continuous line-scan capture for Microlynx cameras.
+ *
+ * Streams the capture node as one continuous image: windows of several V4L2
+ * buffers are written to the output with a single write() straight from the
+ * mirrored buffer ring (see mlscan.h), without copying the lines.  Gaps in
+ * the frame sequence are reported with the number of lines lost, and the
+ * sustained lines/s and CPU time per line are printed every second.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mlscan.h"
+
+#define MAX_WINDOW 32
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: microlynx-scan [-d VIDEO] [-n NBUFS] [-w WINDOW] [-o FILE] [-t SECONDS] [-q]\n"
+      "  -d VIDEO    capture node (default: /dev/video0)\n"
+      "  -n NBUFS    V4L2 buffers in the ring (default: 16)\n"
+      "  -w WINDOW   buffers written per write() (default: 4, < NBUFS)\n"
+      "  -o FILE     raw 16-bit output, '-' for stdout (default: none)\n"
+      "  -t SECONDS  stop after SECONDS (default: until interrupted)\n"
+      "  -q          no periodic statistics\n");
+}
+
+static int write_all(int fd, const uint8_t *p, size_t len)
+{
+   while (len) {
+      ssize_t n = write(fd, p, len);
+
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         return -errno;
+      }
+      p += n;
+      len -= n;
+   }
+   return 0;
+}
+
+static void print_stats(struct mlscan *m)
+{
+   struct mlscan_stats s;
+
+   mlscan_get_stats(m, &s);
+   fprintf(stderr, "lines %llu frames %llu lost %llu  %.0f lines/s  %.1f ns CPU/line\n",
+           (unsigned long long)s.lines, (unsigned long long)s.frames,
+           (unsigned long long)s.frames_lost, s.lines_per_s, s.cpu_ns_per_line);
+}
+
+int main(int argc, char **argv)
+{
+   struct mlscan_chunk win[MAX_WINDOW];
+   const char *video = "/dev/video0";
+   const char *output = NULL;
+   unsigned int nbufs = 16;
+   unsigned int window = 4;
+   unsigned int nwin = 0;
+   unsigned int i;
+   int seconds = 0;
+   int verbose = 1;
+   int out_fd = -1;
+   time_t start, last;
+   struct mlscan *m;
+   int ret;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "d:n:w:o:t:qh")) != -1) {
+      switch (opt) {
+      case 'd':
+         video = optarg;
+         break;
+      case 'n':
+         nbufs = strtoul(optarg, NULL, 0);
+         break;
+      case 'w':
+         window = strtoul(optarg, NULL, 0);
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      case 't':
+         seconds = strtol(optarg, NULL, 0);
+         break;
+      case 'q':
+         verbose = 0;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   /* The window must leave buffers queued to the receiver */
+   if (window < 1 || window > MAX_WINDOW || window >= nbufs) {
+      usage();
+      return 1;
+   }
+
+   if (output) {
+      out_fd = strcmp(output, "-") ? open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+                                   : STDOUT_FILENO;
+      if (out_fd < 0) {
+         perror(output);
+         return 1;
+      }
+   }
+
+   ret = mlscan_open(&m, video, nbufs);
+   if (ret == -EINVAL) {
+      fprintf(stderr, "microlynx-scan: %s: buffers must be page aligned, "
+                      "use a line height giving a multiple of the page size\n", video);
+      return 1;
+   }
+   if (ret) {
+      fprintf(stderr, "microlynx-scan: %s: %s\n", video, strerror(-ret));
+      return 1;
+   }
+   if (verbose)
+      fprintf(stderr, "%s: %u pixels/line, %s\n", video, mlscan_width(m),
+              mlscan_is_unpacking(m) ? "Y14P unpacked in software" : "no unpacking");
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+
+   ret = mlscan_start(m);
+   if (ret) {
+      fprintf(stderr, "microlynx-scan: start: %s\n", strerror(-ret));
+      mlscan_close(m);
+      return 1;
+   }
+
+   start = last = time(NULL);
+   while (!quit) {
+      struct mlscan_chunk *c = &win[nwin];
+      time_t now;
+
+      ret = mlscan_next(m, c, 1000);
+      if (ret == -ETIMEDOUT) {
+         ret = 0;
+         if (seconds && time(NULL) - start >= seconds)
+            break;
+         continue;
+      }
+      if (ret) {
+         fprintf(stderr, "microlynx-scan: %s\n", strerror(-ret));
+         break;
+      }
+      if (c->frames_lost)
+         fprintf(stderr, "gap before frame %u: %u frames, %u lines lost\n",
+                 c->sequence, c->frames_lost, c->frames_lost * c->nlines);
+
+      /*
+       * Buffers are dequeued in ring order, so the window is contiguous
+       * from its first chunk unless the stream restarted in between.
+       */
+      if (++nwin == window) {
+         size_t len = 0;
+
+         for (i = 0; i < nwin; i++)
+            len += win[i].nlines * win[i].stride;
+
+         if (out_fd >= 0) {
+            for (i = 1; i < nwin; i++)
+               if (win[i].index != (win[0].index + i) % mlscan_nbufs(m))
+                  break;
+            if (i == nwin) {
+               ret = write_all(out_fd, win[0].lines, len);
+            } else {
+               for (i = 0, ret = 0; i < nwin && !ret; i++)
+                  ret = write_all(out_fd, win[i].lines, win[i].nlines * win[i].stride);
+            }
+            if (ret) {
+               fprintf(stderr, "microlynx-scan: write: %s\n", strerror(-ret));
+               break;
+            }
+         }
+
+         for (i = 0; i < nwin; i++)
+            mlscan_release(m, &win[i]);
+         nwin = 0;
+      }
+
+      now = time(NULL);
+      if (verbose && now != last) {
+         print_stats(m);
+         last = now;
+      }
+      if (seconds && now - start >= seconds)
+         break;
+   }
+
+   print_stats(m);
+   mlscan_close(m);
+   if (out_fd > STDOUT_FILENO)
+      close(out_fd);
+   return ret ? 1 : 0;
+}
@@ -0,0 +1,615 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * microlynxd - persistent GenCP control daemon for Microlynx cameras.
+ *
+ * Keeps the camera control channel open and serves batched register access
+ * on a local unix socket, so scripts don't pay the device open and a full
+ * GenCP round trip for every register.  Static registers (firmware version,
+ * width, pixel format, bootstrap strings) are read once and served from a
+ * cache.
+ *
+ * Backends:
+ *   - the microlynx kernel module chardev (/dev/microlynx-<bus>-<addr>),
+ *     used when the module is loaded (default)
+ *   - raw /dev/i2c-<bus> with the userspace GenCP client from libgencp,
+ *     when the camera is used without the kernel module (-b/-a options)
+ *
+ * Protocol: one request per line, one response line per request.
+ *   r ADDR [ADDR ...]          -> ok VAL [VAL ...]
+ *   w ADDR VAL [ADDR VAL ...]  -> ok
+ *   s ADDR LEN                 -> ok HEXBYTES
+ *   flush                      -> ok          (drop the cache)
+ *   stats                      -> ok HITS MISSES TRANSACTIONS AVG_US
+ * Errors are reported as "err STATUS INDEX", STATUS being the GenCP status
+ * or a negative errno and INDEX the failing operation of the batch.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <linux/i2c-dev.h>
+
+#include "libunio.h"
+#include "gencp_client.h"
+#include "microlynx_ioctl.h"
+#include "microlynx_regs.h"
+
+#define MAX_CLIENTS     16
+#define LINE_MAX_LEN    4096
+#define MAX_BATCH       128
+#define SOCKET_DIR      "/run"
+
+/* GenCP bootstrap strings live below this address and never change */
+#define BOOTSTRAP_END   0x00000200
+
+struct reg_cache_entry {
+   uint32_t addr;
+   uint32_t val;
+   int      valid;
+};
+
+struct str_cache_entry {
+   uint32_t addr;
+   uint32_t len;
+   uint8_t  buf[MICROLYNX_STR_MAX];
+   int      valid;
+};
+
+static struct reg_cache_entry reg_cache[] = {
+   { .addr = REG_FIRW_VER_R },
+   { .addr = REG_IMG_WIDTH_R },
+   { .addr = REG_PIXEL_FORMAT },
+   { .addr = REG_MIPI_ENA_R },
+};
+#define NUM_CACHED_REGS (sizeof(reg_cache) / sizeof(reg_cache[0]))
+
+static struct str_cache_entry str_cache[8];
+#define NUM_CACHED_STRS (sizeof(str_cache) / sizeof(str_cache[0]))
+
+struct client {
+   int    fd;
+   size_t len;
+   char   buf[LINE_MAX_LEN];
+};
+
+static struct {
+   int      chardev_fd;   /* -1 when the i2c-dev backend is used */
+   int      i2c_fd;
+   struct unio_handle io_handle;
+   uint64_t cache_hits;
+   uint64_t cache_misses;
+   uint64_t transactions;
+   uint64_t transaction_ns;
+} dev = { .chardev_fd = -1, .i2c_fd = -1 };
+
+static volatile sig_atomic_t quit;
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* ---- Backend ---------------------------------------------------------- */
+
+static int backend_read_reg(uint32_t addr, uint32_t *val)
+{
+   uint64_t start = now_ns();
+   int ret;
+
+   if (dev.chardev_fd >= 0) {
+      struct microlynx_reg_op op = { .addr = addr };
+
+      ret = ioctl(dev.chardev_fd, MICROLYNX_IOCTL_READ_REG, &op) ? -errno : 0;
+      *val = op.val;
+   } else {
+      ret = GENCPCLIENT_ReadRegister(addr, val);
+   }
+
+   dev.transactions++;
+   dev.transaction_ns += now_ns() - start;
+   return ret;
+}
+
+static int backend_write_reg(uint32_t addr, uint32_t val)
+{
+   uint64_t start = now_ns();
+   int ret;
+
+   if (dev.chardev_fd >= 0) {
+      struct microlynx_reg_op op = { .addr = addr, .val = val };
+
+      ret = ioctl(dev.chardev_fd, MICROLYNX_IOCTL_WRITE_REG, &op) ? -errno : 0;
+   } else {
+      ret = GENCPCLIENT_WriteRegister(addr, val);
+   }
+
+   dev.transactions++;
+   dev.transaction_ns += now_ns() - start;
+   return ret;
+}
+
+static int backend_read_str(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+   uint64_t start = now_ns();
+   int ret;
+
+   if (dev.chardev_fd >= 0) {
+      struct microlynx_str_op op = { .addr = addr, .len = len };
+
+      ret = ioctl(dev.chardev_fd, MICROLYNX_IOCTL_READ_STR, &op) ? -errno : 0;
+      memcpy(buf, op.buf, len);
+   } else {
+      ret = GENCPCLIENT_ReadString(addr, buf, len);
+   }
+
+   dev.transactions++;
+   dev.transaction_ns += now_ns() - start;
+   return ret;
+}
+
+static int backend_open_chardev(const char *path)
+{
+   dev.chardev_fd = open(path, O_RDWR | O_CLOEXEC);
+   if (dev.chardev_fd < 0) {
+      fprintf(stderr, "microlynxd: cannot open %s: %s\n", path, strerror(errno));
+      return -1;
+   }
+   return 0;
+}
+
+static int backend_open_i2c(int bus, int addr)
+{
+   char path[32];
+
+   snprintf(path, sizeof(path), "/dev/i2c-%d", bus);
+   dev.i2c_fd = open(path, O_RDWR | O_CLOEXEC);
+   if (dev.i2c_fd < 0) {
+      fprintf(stderr, "microlynxd: cannot open %s: %s\n", path, strerror(errno));
+      return -1;
+   }
+   if (ioctl(dev.i2c_fd, I2C_SLAVE, addr) < 0) {
+      fprintf(stderr, "microlynxd: cannot select 0x%02x on %s: %s "
+              "(is the microlynx module bound to it?)\n",
+              addr, path, strerror(errno));
+      close(dev.i2c_fd);
+      return -1;
+   }
+
+   dev.io_handle.fd = dev.i2c_fd;
+   GENCPCLIENT_Init(&dev.io_handle);
+   if (!GENCPCLIENT_isSuccesfullyInitialized()) {
+      fprintf(stderr, "microlynxd: no GenCP answer on %s 0x%02x\n", path, addr);
+      GENCPCLIENT_Cleanup();
+      close(dev.i2c_fd);
+      return -1;
+   }
+   return 0;
+}
+
+static void backend_close(void)
+{
+   if (dev.chardev_fd >= 0)
+      close(dev.chardev_fd);
+   if (dev.i2c_fd >= 0) {
+      GENCPCLIENT_Cleanup();
+      close(dev.i2c_fd);
+   }
+}
+
+/* ---- Cache ------------------------------------------------------------ */
+
+static struct reg_cache_entry *reg_cache_find(uint32_t addr)
+{
+   size_t i;
+
+   for (i = 0; i < NUM_CACHED_REGS; i++)
+      if (reg_cache[i].addr == addr)
+         return &reg_cache[i];
+   return NULL;
+}
+
+static int cached_read_reg(uint32_t addr, uint32_t *val)
+{
+   struct reg_cache_entry *e = reg_cache_find(addr);
+   int ret;
+
+   if (e && e->valid) {
+      dev.cache_hits++;
+      *val = e->val;
+      return 0;
+   }
+
+   dev.cache_misses++;
+   ret = backend_read_reg(addr, val);
+   if (!ret && e) {
+      e->val = *val;
+      e->valid = 1;
+   }
+   return ret;
+}
+
+static int cached_write_reg(uint32_t addr, uint32_t val)
+{
+   struct reg_cache_entry *e = reg_cache_find(addr);
+
+   if (e)
+      e->valid = 0;
+   return backend_write_reg(addr, val);
+}
+
+static int cached_read_str(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+   struct str_cache_entry *free_entry = NULL;
+   size_t i;
+   int ret;
+
+   if (addr >= BOOTSTRAP_END)
+      return backend_read_str(addr, buf, len);
+
+   for (i = 0; i < NUM_CACHED_STRS; i++) {
+      if (!str_cache[i].valid) {
+         if (!free_entry)
+            free_entry = &str_cache[i];
+      } else if (str_cache[i].addr == addr && str_cache[i].len == len) {
+         dev.cache_hits++;
+         memcpy(buf, str_cache[i].buf, len);
+         return 0;
+      }
+   }
+
+   dev.cache_misses++;
+   ret = backend_read_str(addr, buf, len);
+   if (!ret && free_entry) {
+      free_entry->addr = addr;
+      free_entry->len = len;
+      memcpy(free_entry->buf, buf, len);
+      free_entry->valid = 1;
+   }
+   return ret;
+}
+
+static void cache_flush(void)
+{
+   size_t i;
+
+   for (i = 0; i < NUM_CACHED_REGS; i++)
+      reg_cache[i].valid = 0;
+   for (i = 0; i < NUM_CACHED_STRS; i++)
+      str_cache[i].valid = 0;
+}
+
+/* ---- Requests --------------------------------------------------------- */
+
+static int parse_u32(const char *tok, uint32_t *val)
+{
+   char *end;
+   unsigned long v;
+
+   if (!tok)
+      return -1;
+   errno = 0;
+   v = strtoul(tok, &end, 0);
+   if (errno || *end || v > 0xFFFFFFFFul)
+      return -1;
+   *val = (uint32_t)v;
+   return 0;
+}
+
+/* Handle one request line, the response is written to @out without newline */
+static void handle_request(char *line, char *out, size_t out_len)
+{
+   char *save = NULL;
+   char *cmd = strtok_r(line, " \t", &save);
+   char *tok;
+   size_t pos;
+   int index = 0;
+   int ret = 0;
+
+   if (!cmd) {
+      snprintf(out, out_len, "err %d 0", -EINVAL);
+      return;
+   }
+
+   if (!strcmp(cmd, "r")) {
+      uint32_t addr, val;
+
+      pos = snprintf(out, out_len, "ok");
+      while ((tok = strtok_r(NULL, " \t", &save))) {
+         if (index >= MAX_BATCH || parse_u32(tok, &addr)) {
+            ret = -EINVAL;
+            break;
+         }
+         ret = cached_read_reg(addr, &val);
+         if (ret)
+            break;
+         if (pos < out_len)
+            pos += snprintf(out + pos, out_len - pos, " 0x%08x", val);
+         index++;
+      }
+   } else if (!strcmp(cmd, "w")) {
+      uint32_t addr, val;
+
+      snprintf(out, out_len, "ok");
+      while ((tok = strtok_r(NULL, " \t", &save))) {
+         if (index >= MAX_BATCH || parse_u32(tok, &addr) ||
+             parse_u32(strtok_r(NULL, " \t", &save), &val)) {
+            ret = -EINVAL;
+            break;
+         }
+         ret = cached_write_reg(addr, val);
+         if (ret)
+            break;
+         index++;
+      }
+   } else if (!strcmp(cmd, "s")) {
+      uint8_t buf[MICROLYNX_STR_MAX];
+      uint32_t addr, len, i;
+
+      if (parse_u32(strtok_r(NULL, " \t", &save), &addr) ||
+          parse_u32(strtok_r(NULL, " \t", &save), &len) ||
+          len == 0 || len > MICROLYNX_STR_MAX) {
+         ret = -EINVAL;
+      } else {
+         ret = cached_read_str(addr, buf, len);
+         if (!ret) {
+            pos = snprintf(out, out_len, "ok ");
+            for (i = 0; i < len && pos + 2 < out_len; i++)
+               pos += snprintf(out + pos, out_len - pos, "%02x", buf[i]);
+         }
+      }
+   } else if (!strcmp(cmd, "flush")) {
+      cache_flush();
+      snprintf(out, out_len, "ok");
+   } else if (!strcmp(cmd, "stats")) {
+      snprintf(out, out_len, "ok %llu %llu %llu %llu",
+               (unsigned long long)dev.cache_hits,
+               (unsigned long long)dev.cache_misses,
+               (unsigned long long)dev.transactions,
+               (unsigned long long)(dev.transactions ?
+                  dev.transaction_ns / dev.transactions / 1000 : 0));
+   } else {
+      ret = -EINVAL;
+   }
+
+   if (ret)
+      snprintf(out, out_len, "err %d %d", ret, index);
+}
+
+/* Returns -1 when the client has to be dropped */
+static int client_process(struct client *c)
+{
+   char out[LINE_MAX_LEN + 16];
+   ssize_t n;
+   char *nl;
+
+   n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+   if (n <= 0)
+      return -1;
+   c->len += n;
+   c->buf[c->len] = '\0';
+
+   while ((nl = memchr(c->buf, '\n', c->len))) {
+      size_t line_len = nl - c->buf + 1;
+      size_t out_len;
+
+      *nl = '\0';
+      if (nl > c->buf && nl[-1] == '\r')
+         nl[-1] = '\0';
+      handle_request(c->buf, out, sizeof(out) - 1);
+      out_len = strlen(out);
+      out[out_len++] = '\n';
+      if (write(c->fd, out, out_len) != (ssize_t)out_len)
+         return -1;
+
+      memmove(c->buf, c->buf + line_len, c->len - line_len);
+      c->len -= line_len;
+   }
+
+   /* Line too long for the buffer */
+   if (c->len == sizeof(c->buf) - 1)
+      return -1;
+   return 0;
+}
+
+/* ---- Main ------------------------------------------------------------- */
+
+static int listen_socket(const char *path)
+{
+   struct sockaddr_un sa = { .sun_family = AF_UNIX };
+   int fd;
+
+   if (strlen(path) >= sizeof(sa.sun_path)) {
+      fprintf(stderr, "microlynxd: socket path too long\n");
+      return -1;
+   }
+   strcpy(sa.sun_path, path);
+
+   fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (fd < 0)
+      return -1;
+   unlink(path);
+   if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+       listen(fd, MAX_CLIENTS) < 0) {
+      fprintf(stderr, "microlynxd: cannot listen on %s: %s\n", path, strerror(errno));
+      close(fd);
+      return -1;
+   }
+   chmod(path, 0660);
+   return fd;
+}
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: microlynxd [-d DEVICE | -b I2C_BUS -a I2C_ADDR] [-s SOCKET] [-f]\n"
+      "  -d DEVICE   microlynx chardev (default: first /dev/microlynx-*)\n"
+      "  -b I2C_BUS  use /dev/i2c-I2C_BUS directly, without the kernel module\n"
+      "  -a I2C_ADDR camera I2C address for -b (default: 0x51)\n"
+      "  -s SOCKET   unix socket path (default: " SOCKET_DIR "/microlynxd-<device>.sock)\n"
+      "  -f          stay in foreground\n");
+}
+
+int main(int argc, char **argv)
+{
+   struct pollfd pfds[MAX_CLIENTS + 1];
+   struct client clients[MAX_CLIENTS];
+   char socket_path[108] = "";
+   char device[64] = "";
+   int i2c_bus = -1;
+   int i2c_addr = 0x51;
+   int foreground = 0;
+   int listen_fd;
+   int opt;
+   int i;
+
+   while ((opt = getopt(argc, argv, "d:b:a:s:fh")) != -1) {
+      switch (opt) {
+      case 'd':
+         snprintf(device, sizeof(device), "%s", optarg);
+         break;
+      case 'b':
+         i2c_bus = strtol(optarg, NULL, 0);
+         break;
+      case 'a':
+         i2c_addr = strtol(optarg, NULL, 0);
+         break;
+      case 's':
+         snprintf(socket_path, sizeof(socket_path), "%s", optarg);
+         break;
+      case 'f':
+         foreground = 1;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   if (i2c_bus >= 0) {
+      snprintf(device, sizeof(device), "i2c-%d-%04x", i2c_bus, i2c_addr);
+      if (backend_open_i2c(i2c_bus, i2c_addr))
+         return 1;
+   } else {
+      if (!device[0]) {
+         glob_t g;
+
+         if (glob("/dev/microlynx-*", 0, NULL, &g) || g.gl_pathc == 0) {
+            fprintf(stderr, "microlynxd: no /dev/microlynx-* chardev found\n");
+            return 1;
+         }
+         snprintf(device, sizeof(device), "%s", g.gl_pathv[0]);
+         globfree(&g);
+      }
+      if (backend_open_chardev(device))
+         return 1;
+   }
+
+   if (!socket_path[0]) {
+      const char *name = strrchr(device, '/');
+
+      snprintf(socket_path, sizeof(socket_path), SOCKET_DIR "/microlynxd-%s.sock",
+               name ? name + 1 : device);
+   }
+
+   listen_fd = listen_socket(socket_path);
+   if (listen_fd < 0) {
+      backend_close();
+      return 1;
+   }
+
+   if (!foreground && daemon(0, 0)) {
+      perror("microlynxd: daemon");
+      return 1;
+   }
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+   signal(SIGPIPE, SIG_IGN);
+
+   for (i = 0; i < MAX_CLIENTS; i++)
+      clients[i].fd = -1;
+
+   while (!quit) {
+      int nfds = 1;
+      int map[MAX_CLIENTS];
+
+      pfds[0].fd = listen_fd;
+      pfds[0].events = POLLIN;
+      for (i = 0; i < MAX_CLIENTS; i++) {
+         if (clients[i].fd < 0)
+            continue;
+         pfds[nfds].fd = clients[i].fd;
+         pfds[nfds].events = POLLIN;
+         map[nfds - 1] = i;
+         nfds++;
+      }
+
+      if (poll(pfds, nfds, -1) < 0) {
+         if (errno == EINTR)
+            continue;
+         break;
+      }
+
+      for (i = 1; i < nfds; i++) {
+         struct client *c = &clients[map[i - 1]];
+
+         if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+         if (client_process(c)) {
+            close(c->fd);
+            c->fd = -1;
+         }
+      }
+
+      if (pfds[0].revents & POLLIN) {
+         int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+
+         if (fd < 0)
+            continue;
+         for (i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0) {
+               clients[i].fd = fd;
+               clients[i].len = 0;
+               break;
+            }
+         }
+         if (i == MAX_CLIENTS)
+            close(fd);
+      }
+   }
+
+   for (i = 0; i < MAX_CLIENTS; i++)
+      if (clients[i].fd >= 0)
+         close(clients[i].fd);
+   close(listen_fd);
+   unlink(socket_path);
+   backend_close();
+
+   return 0;
+}
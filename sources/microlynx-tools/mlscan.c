@@ -0,0 +1,448 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <linux/videodev2.h>
+
+#include "mlscan.h"
+
+#ifdef __aarch64__
+   #include <arm_neon.h>
+#endif
+
+#ifndef V4L2_PIX_FMT_Y14
+   #define V4L2_PIX_FMT_Y14   v4l2_fourcc('Y', '1', '4', ' ')
+#endif
+#ifndef V4L2_PIX_FMT_Y14P
+   #define V4L2_PIX_FMT_Y14P  v4l2_fourcc('Y', '1', '4', 'P')
+#endif
+
+#define MLSCAN_MAX_BUFFERS 64
+
+struct mlscan {
+   int           fd;
+   unsigned int  nbufs;
+   unsigned int  width;
+   unsigned int  height;
+   uint32_t      pixelformat;
+   size_t        buf_size;      /* sizeimage of one V4L2 buffer */
+   size_t        v4l2_stride;   /* bytesperline of the V4L2 buffers */
+   uint8_t      *ring;          /* 2 * nbufs * buf_size, mirrored */
+
+   /* Y14P only: unpacked 16-bit lines, mirrored like the V4L2 ring */
+   int           unpack;
+   int           unpack_fd;
+   size_t        unpack_size;   /* One unpacked buffer */
+   uint8_t      *unpack_ring;
+
+   int           streaming;
+   int           have_sequence;
+   uint32_t      last_sequence;
+
+   uint64_t      lines;
+   uint64_t      frames;
+   uint64_t      frames_lost;
+   uint64_t      start_ns;
+   uint64_t      start_cpu_ns;
+};
+
+static uint64_t mono_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t cpu_ns(void)
+{
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+   return ((uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)) * 1000000000ull +
+          ((uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)) * 1000ull;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+/* ---- Y14P unpacking --------------------------------------------------- */
+
+static void unpack_y14p_scalar(const uint8_t *src, uint16_t *dst, unsigned int npix)
+{
+   unsigned int i;
+
+   for (i = 0; i + 4 <= npix; i += 4, src += 7, dst += 4) {
+      dst[0] = (src[0] << 6) | (src[4] & 0x3F);
+      dst[1] = (src[1] << 6) | (src[4] >> 6) | ((src[5] & 0x0F) << 2);
+      dst[2] = (src[2] << 6) | (src[5] >> 4) | ((src[6] & 0x03) << 4);
+      dst[3] = (src[3] << 6) | (src[6] >> 2);
+   }
+}
+
+void mlscan_unpack_y14p(const uint8_t *src, uint16_t *dst, unsigned int npix)
+{
+#ifdef __aarch64__
+   /*
+    * 8 pixels (14 bytes) per step: the MSB bytes are spread into the low
+    * byte of each lane, the byte pair holding each pixel's 6 LSBs is
+    * gathered into a lane and shifted into place.  Loads read 16 bytes,
+    * so the last groups are left to the scalar loop.
+    */
+   static const uint8_t idx_msb[16] = {
+      0, 255, 1, 255, 2, 255, 3, 255, 7, 255, 8, 255, 9, 255, 10, 255
+   };
+   static const uint8_t idx_lsb[16] = {
+      4, 5, 4, 5, 5, 6, 6, 6, 11, 12, 11, 12, 12, 13, 13, 13
+   };
+   static const int16_t lsb_shift[8] = { 0, -6, -4, -2, 0, -6, -4, -2 };
+   const uint8x16_t tbl_msb = vld1q_u8(idx_msb);
+   const uint8x16_t tbl_lsb = vld1q_u8(idx_lsb);
+   const int16x8_t shift = vld1q_s16(lsb_shift);
+   const uint16x8_t mask = vdupq_n_u16(0x3F);
+   unsigned int i;
+
+   for (i = 0; i + 8 < npix; i += 8, src += 14, dst += 8) {
+      uint8x16_t in = vld1q_u8(src);
+      uint16x8_t msb = vreinterpretq_u16_u8(vqtbl1q_u8(in, tbl_msb));
+      uint16x8_t lsb = vreinterpretq_u16_u8(vqtbl1q_u8(in, tbl_lsb));
+
+      lsb = vandq_u16(vshlq_u16(lsb, shift), mask);
+      vst1q_u16(dst, vorrq_u16(vshlq_n_u16(msb, 6), lsb));
+   }
+   unpack_y14p_scalar(src, dst, npix - i);
+#else
+   unpack_y14p_scalar(src, dst, npix);
+#endif
+}
+
+/* ---- Ring mapping ----------------------------------------------------- */
+
+static int select_format(struct mlscan *m)
+{
+   struct v4l2_fmtdesc desc = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   int has_y14 = 0;
+   int ret;
+
+   ret = xioctl(m->fd, VIDIOC_G_FMT, &fmt);
+   if (ret)
+      return ret;
+
+   /* Prefer the receiver repacking Y14P to Y14 over unpacking on the CPU */
+   if (fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_Y14P) {
+      for (desc.index = 0; !xioctl(m->fd, VIDIOC_ENUM_FMT, &desc); desc.index++)
+         if (desc.pixelformat == V4L2_PIX_FMT_Y14)
+            has_y14 = 1;
+      if (has_y14) {
+         fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_Y14;
+         ret = xioctl(m->fd, VIDIOC_S_FMT, &fmt);
+         if (ret)
+            return ret;
+      }
+   }
+
+   m->width = fmt.fmt.pix.width;
+   m->height = fmt.fmt.pix.height;
+   m->pixelformat = fmt.fmt.pix.pixelformat;
+   m->v4l2_stride = fmt.fmt.pix.bytesperline;
+   m->buf_size = fmt.fmt.pix.sizeimage;
+   m->unpack = m->pixelformat == V4L2_PIX_FMT_Y14P;
+
+   return 0;
+}
+
+/* Reserve 2 * nbufs * size bytes of address space */
+static uint8_t *reserve_ring(size_t size, unsigned int nbufs)
+{
+   void *p = mmap(NULL, 2 * nbufs * size, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+   return p == MAP_FAILED ? NULL : p;
+}
+
+static int map_ring(struct mlscan *m)
+{
+   long page = sysconf(_SC_PAGESIZE);
+   unsigned int i, k;
+
+   if (m->buf_size % page)
+      return -EINVAL;   /* Line height doesn't give page aligned buffers */
+
+   m->ring = reserve_ring(m->buf_size, m->nbufs);
+   if (!m->ring)
+      return -ENOMEM;
+
+   for (i = 0; i < m->nbufs; i++) {
+      struct v4l2_buffer buf = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .memory = V4L2_MEMORY_MMAP,
+         .index = i,
+      };
+      int ret = xioctl(m->fd, VIDIOC_QUERYBUF, &buf);
+
+      if (ret)
+         return ret;
+      if (buf.length != m->buf_size)
+         return -EINVAL;
+
+      /* Buffer i at slot i and at its mirror slot i + nbufs */
+      for (k = 0; k < 2; k++) {
+         void *slot = m->ring + (i + k * m->nbufs) * m->buf_size;
+
+         if (mmap(slot, m->buf_size, PROT_READ, MAP_SHARED | MAP_FIXED,
+                  m->fd, buf.m.offset) == MAP_FAILED)
+            return -errno;
+      }
+   }
+
+   if (!m->unpack)
+      return 0;
+
+   /* Unpacked ring, backed by a memfd mapped twice in the same way */
+   m->unpack_size = m->width * 2 * m->height;
+   if (m->unpack_size % page)
+      return -EINVAL;
+   m->unpack_fd = memfd_create("mlscan", MFD_CLOEXEC);
+   if (m->unpack_fd < 0)
+      return -errno;
+   if (ftruncate(m->unpack_fd, m->nbufs * m->unpack_size))
+      return -errno;
+   m->unpack_ring = reserve_ring(m->unpack_size, m->nbufs);
+   if (!m->unpack_ring)
+      return -ENOMEM;
+   for (k = 0; k < 2; k++) {
+      void *half = m->unpack_ring + k * m->nbufs * m->unpack_size;
+
+      if (mmap(half, m->nbufs * m->unpack_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_FIXED, m->unpack_fd, 0) == MAP_FAILED)
+         return -errno;
+   }
+
+   return 0;
+}
+
+/* ---- API -------------------------------------------------------------- */
+
+int mlscan_open(struct mlscan **pm, const char *video_dev, unsigned int nbufs)
+{
+   struct v4l2_requestbuffers req = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   struct mlscan *m;
+   int ret;
+
+   if (nbufs < 2 || nbufs > MLSCAN_MAX_BUFFERS)
+      return -EINVAL;
+
+   m = calloc(1, sizeof(*m));
+   if (!m)
+      return -ENOMEM;
+   m->unpack_fd = -1;
+
+   m->fd = open(video_dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (m->fd < 0) {
+      free(m);
+      return -errno;
+   }
+
+   ret = select_format(m);
+   if (ret)
+      goto error;
+
+   req.count = nbufs;
+   ret = xioctl(m->fd, VIDIOC_REQBUFS, &req);
+   if (ret)
+      goto error;
+   m->nbufs = req.count;
+
+   ret = map_ring(m);
+   if (ret)
+      goto error;
+
+   *pm = m;
+   return 0;
+
+error:
+   mlscan_close(m);
+   return ret;
+}
+
+void mlscan_close(struct mlscan *m)
+{
+   struct v4l2_requestbuffers req = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+
+   if (!m)
+      return;
+   if (m->streaming)
+      mlscan_stop(m);
+   if (m->ring)
+      munmap(m->ring, 2 * m->nbufs * m->buf_size);
+   if (m->unpack_ring)
+      munmap(m->unpack_ring, 2 * m->nbufs * m->unpack_size);
+   if (m->unpack_fd >= 0)
+      close(m->unpack_fd);
+   xioctl(m->fd, VIDIOC_REQBUFS, &req);
+   close(m->fd);
+   free(m);
+}
+
+int mlscan_start(struct mlscan *m)
+{
+   int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   unsigned int i;
+   int ret;
+
+   /* Queued in ring order, the DMA fills the ring in order */
+   for (i = 0; i < m->nbufs; i++) {
+      struct v4l2_buffer buf = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .memory = V4L2_MEMORY_MMAP,
+         .index = i,
+      };
+
+      ret = xioctl(m->fd, VIDIOC_QBUF, &buf);
+      if (ret)
+         return ret;
+   }
+
+   ret = xioctl(m->fd, VIDIOC_STREAMON, &type);
+   if (ret)
+      return ret;
+
+   m->streaming = 1;
+   m->have_sequence = 0;
+   m->lines = m->frames = m->frames_lost = 0;
+   m->start_ns = mono_ns();
+   m->start_cpu_ns = cpu_ns();
+   return 0;
+}
+
+int mlscan_stop(struct mlscan *m)
+{
+   int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+   m->streaming = 0;
+   return xioctl(m->fd, VIDIOC_STREAMOFF, &type);
+}
+
+int mlscan_next(struct mlscan *m, struct mlscan_chunk *chunk, int timeout_ms)
+{
+   struct v4l2_buffer buf = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   struct pollfd pfd = { .fd = m->fd, .events = POLLIN };
+   int ret;
+
+   for (;;) {
+      ret = xioctl(m->fd, VIDIOC_DQBUF, &buf);
+      if (ret != -EAGAIN)
+         break;
+      ret = poll(&pfd, 1, timeout_ms);
+      if (ret == 0)
+         return -ETIMEDOUT;
+      if (ret < 0 && errno != EINTR)
+         return -errno;
+   }
+   if (ret)
+      return ret;
+
+   chunk->index = buf.index;
+   chunk->nlines = m->height;
+   chunk->sequence = buf.sequence;
+   chunk->timestamp_ns = (uint64_t)buf.timestamp.tv_sec * 1000000000ull +
+                         buf.timestamp.tv_usec * 1000ull;
+
+   /* Gaps in the sequence are frames the receiver dropped */
+   chunk->frames_lost = m->have_sequence ? buf.sequence - m->last_sequence - 1 : 0;
+   m->have_sequence = 1;
+   m->last_sequence = buf.sequence;
+
+   if (m->unpack) {
+      uint8_t *dst = m->unpack_ring + buf.index * m->unpack_size;
+      const uint8_t *src = m->ring + buf.index * m->buf_size;
+      unsigned int y;
+
+      for (y = 0; y < m->height; y++)
+         mlscan_unpack_y14p(src + y * m->v4l2_stride,
+                            (uint16_t *)(dst + y * m->width * 2), m->width);
+      chunk->lines = dst;
+      chunk->stride = m->width * 2;
+   } else {
+      chunk->lines = m->ring + buf.index * m->buf_size;
+      chunk->stride = m->v4l2_stride;
+   }
+
+   m->frames++;
+   m->frames_lost += chunk->frames_lost;
+   m->lines += m->height;
+   return 0;
+}
+
+int mlscan_release(struct mlscan *m, const struct mlscan_chunk *chunk)
+{
+   struct v4l2_buffer buf = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = chunk->index,
+   };
+
+   return xioctl(m->fd, VIDIOC_QBUF, &buf);
+}
+
+unsigned int mlscan_nbufs(const struct mlscan *m)
+{
+   return m->nbufs;
+}
+
+unsigned int mlscan_width(const struct mlscan *m)
+{
+   return m->width;
+}
+
+unsigned int mlscan_bytes_per_pixel(const struct mlscan *m)
+{
+   (void)m;
+   return 2;
+}
+
+int mlscan_is_unpacking(const struct mlscan *m)
+{
+   return m->unpack;
+}
+
+void mlscan_get_stats(struct mlscan *m, struct mlscan_stats *stats)
+{
+   uint64_t elapsed = mono_ns() - m->start_ns;
+
+   stats->lines = m->lines;
+   stats->frames = m->frames;
+   stats->frames_lost = m->frames_lost;
+   stats->lines_per_s = elapsed ? m->lines * 1e9 / elapsed : 0;
+   stats->cpu_ns_per_line = m->lines ?
+      (double)(cpu_ns() - m->start_cpu_ns) / m->lines : 0;
+}
@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef MLSCAN_H
+#define MLSCAN_H
+
+/*
+ * Zero-copy line-scan stitching for Microlynx captures.
+ *
+ * The V4L2 MMAP buffers of the capture node are mapped back to back in one
+ * virtual memory area, twice, so the scan lines of consecutive buffers form
+ * one continuous ring: any window of up to nbufs buffers can be read with a
+ * single pointer, across buffer and ring boundaries, without copying.
+ *
+ * Y14P (MIPI packed 14-bit) is only unpacked, into a similar mirrored ring,
+ * when the receiver can't repack to Y14 itself.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct mlscan;
+
+struct mlscan_chunk {
+   const uint8_t *lines;       /* First line of the buffer in the ring */
+   unsigned int   nlines;      /* Lines in this buffer */
+   size_t         stride;      /* Bytes per line in the ring */
+   uint32_t       sequence;    /* V4L2 frame sequence number */
+   uint32_t       frames_lost; /* Frames lost just before this one */
+   uint64_t       timestamp_ns;
+   unsigned int   index;       /* Internal, V4L2 buffer index */
+};
+
+struct mlscan_stats {
+   uint64_t lines;
+   uint64_t frames;
+   uint64_t frames_lost;
+   double   lines_per_s;
+   double   cpu_ns_per_line;
+};
+
+/*
+ * Open the capture node and map @nbufs buffers as a ring, 0 or -errno.
+ * -EINVAL when the buffers (packed and unpacked) aren't a whole number of
+ * pages: pick a line height that makes them so.
+ */
+int mlscan_open(struct mlscan **m, const char *video_dev, unsigned int nbufs);
+void mlscan_close(struct mlscan *m);
+
+int mlscan_start(struct mlscan *m);
+int mlscan_stop(struct mlscan *m);
+
+/*
+ * Wait for the next buffer.  The lines stay valid, and contiguous with the
+ * lines of the previous chunks not yet released, until mlscan_release().
+ * Returns 0, -ETIMEDOUT or -errno.
+ */
+int mlscan_next(struct mlscan *m, struct mlscan_chunk *chunk, int timeout_ms);
+int mlscan_release(struct mlscan *m, const struct mlscan_chunk *chunk);
+
+/* Buffers in the ring, may be more than requested */
+unsigned int mlscan_nbufs(const struct mlscan *m);
+/* Width in pixels and bytes per pixel (always 2) of the ring lines */
+unsigned int mlscan_width(const struct mlscan *m);
+unsigned int mlscan_bytes_per_pixel(const struct mlscan *m);
+/* Non zero when Y14P is unpacked in software */
+int mlscan_is_unpacking(const struct mlscan *m);
+
+void mlscan_get_stats(struct mlscan *m, struct mlscan_stats *stats);
+
+/* MIPI RAW14 (4 pixels in 7 bytes) to 16-bit, NEON on aarch64 */
+void mlscan_unpack_y14p(const uint8_t *src, uint16_t *dst, unsigned int npix);
+
+#endif /* MLSCAN_H */
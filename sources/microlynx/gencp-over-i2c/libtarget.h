@@ -9,6 +9,7 @@
 // Data types
 #ifdef __KERNEL__ // automatically defined when building kernel modules
     #include <linux/types.h>
+    #include <linux/string.h>
     typedef u8  uint8_t;
     typedef u16 uint16_t;
     typedef u32 uint32_t;
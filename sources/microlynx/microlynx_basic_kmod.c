@@ -8,58 +8,28 @@
 #include <linux/delay.h>
 #include <linux/miscdevice.h>
 #include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/ktime.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include <media/v4l2-subdev.h>
 #include <media/v4l2-fwnode.h>
 #include <media/v4l2-mediabus.h>
+#include <media/mipi-csi2.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-event.h>
 
 #include "gencp-over-i2c/libunio.h"
 #include "gencp-over-i2c/gencp_client.h"
+#include "microlynx_ioctl.h"
+#include "microlynx_regs.h"
 
 #define PREFIX "Microlynx"
 #include "gencp-over-i2c/liblogger.h"
 
 /* ---- GenCP userspace chardev (/dev/microlynx-<bus>-<addr>) ------------- */
 
-/**
- * struct microlynx_reg_op - ioctl payload for 32-bit register read/write
- * @addr: GenCP register address
- * @val:  value written (WRITE_REG) or value returned (READ_REG)
- */
-struct microlynx_reg_op {
-	__u32 addr;
-	__u32 val;
-};
-
-#define MICROLYNX_STR_MAX 256
-
-/**
- * struct microlynx_str_op - ioctl payload for GenCP string read
- * @addr: GenCP register address of the string
- * @len:  number of bytes to read (clamped to MICROLYNX_STR_MAX)
- * @buf:  buffer filled with the string data on return
- */
-struct microlynx_str_op {
-	__u32 addr;
-	__u32 len;
-	__u8  buf[MICROLYNX_STR_MAX];
-};
-
-#define MICROLYNX_IOCTL_MAGIC    'M'
-/* _IOWR('M', 1, struct microlynx_reg_op) */
-#define MICROLYNX_IOCTL_READ_REG  _IOWR(MICROLYNX_IOCTL_MAGIC, 1, \
-					struct microlynx_reg_op)
-/* _IOW('M', 2, struct microlynx_reg_op) */
-#define MICROLYNX_IOCTL_WRITE_REG _IOW(MICROLYNX_IOCTL_MAGIC,  2, \
-					struct microlynx_reg_op)
-/* _IOWR('M', 3, struct microlynx_str_op) */
-#define MICROLYNX_IOCTL_READ_STR  _IOWR(MICROLYNX_IOCTL_MAGIC, 3, \
-					struct microlynx_str_op)
-
 /*
  * Module-level mutex: GENCPCLIENT uses process-global state (pRxBuffer,
  * pTxBuffer, unio_handle_ptr).  Serialise all GenCP calls behind this lock.
@@ -69,30 +39,54 @@ static DEFINE_MUTEX(microlynx_gencp_lock);
 // #define DEFAULT_WIDTH 1024
 // #define DEFAULT_HEIGHT 128
 
-#define REG_ACQ_START_W   0x500F0000
-#define REG_ACQ_STOP_W    0x500F0004
-#define REG_ACQ_STATUS_R  0x500F0008
-#define REG_IMG_HEIGHT_RW 0x500E000C
-#define REG_IMG_WIDTH_R   0x500E0008
-#define REG_MIPI_ENA_R    0x50ff0010
-#define REG_FIRW_VER_R    0x50FF0000
-#define REG_PIXEL_FORMAT  0x500e0018
-#define PIXEL_FORMAT_MONO16 0x01100007u
-#define PIXEL_FORMAT_MONO14 0x01100025u
-
-/* Mode : resolution and related config&values */
-struct sensor_mode {
-        u32 width; // Frame width in pixels
-        u32 height; // Frame height in pixels
-        u32 line_length; // Line length in pixels
+
+/* Time allowed for REG_ACQ_STATUS_R to follow a start/stop request */
+#define ACQ_STATUS_TIMEOUT_US 100000
+
+/*
+ * Acquisition restart policy at stream-on, DT property "acq-restart".
+ * The RP1 DPHY (RPi5) only locks when it sees the camera go through a
+ * LP->HS transition, so the acquisition has to be stopped before it is
+ * started again.  Unicam (RPi4) doesn't need it.
+ */
+enum microlynx_acq_restart {
+   ACQ_RESTART_AUTO   = 0, /* Restart only when the receiver is the RP1 CFE */
+   ACQ_RESTART_ALWAYS = 1,
+   ACQ_RESTART_NEVER  = 2,
+};
+
+/*
+ * Frame height (number of scan lines per V4L2 buffer) limits.  The camera
+ * accepts any height in this range; small values trade per-frame overhead
+ * for latency, large values the opposite.
+ */
+#define MICROLYNX_MIN_LINE_HEIGHT 16
+#define MICROLYNX_MAX_LINE_HEIGHT 4096
+#define MICROLYNX_DEF_LINE_HEIGHT 128
+
+/*
+ * Optional metadata stream of the camera, embedded data lines or a second
+ * data type, DT properties "metadata-lines", "metadata-bytes" (per line) and
+ * "metadata-dt". It's advertised on a second source pad, which the receiver
+ * captures on its metadata node.
+ */
+enum {
+   MICROLYNX_PAD_IMAGE,
+   MICROLYNX_PAD_METADATA,
+   MICROLYNX_NUM_PADS,
 };
 
+#ifndef MEDIA_BUS_FMT_SENSOR_DATA
+#define MEDIA_BUS_FMT_SENSOR_DATA 0x7002
+#endif
+
 struct sensor_def {
    struct i2c_client *i2c_client;
    struct v4l2_subdev sd;
    struct v4l2_mbus_framefmt fmt;
    struct v4l2_ctrl_handler ctrl_handler;
-   struct media_pad pad;
+   struct media_pad pad[MICROLYNX_NUM_PADS];
+   unsigned int num_pads;
    /*
     * Mutex for serialized access:
     * Protect eg_ec module set pad format and start/stop streaming safely.
@@ -101,6 +95,13 @@ struct sensor_def {
    u32 line_height;
    u32 native_width;
    u32 active_mbus_code;
+   bool streaming;
+   bool force_acq_restart;
+   u32 acq_start_latency_us;
+   /* Metadata stream, meta_lines is 0 when there's none */
+   u32 meta_lines;
+   u32 meta_bytes;
+   u8 meta_dt;
    struct unio_handle io_handle;
 
    /* GenCP chardev — /dev/microlynx-<bus>-<addr> */
@@ -108,20 +109,45 @@ struct sensor_def {
    char                 miscdev_name[32];
 };
 
-static const struct sensor_mode sensor_supported_modes[] = {
-        {
-               .width = 1024,
-               .height = 128, // NOTE: Value for testing
-               .line_length = 1024, // NOTE: Should be no extra padding
-        },
-};
-#define NUM_SUPPORTED_MODES ARRAY_SIZE(sensor_supported_modes)
-
 
 struct v4l2_fwnode_endpoint microlynx_ep_cfg = {
    .bus_type = V4L2_MBUS_CSI2_DPHY
 };
 
+/* Fixed format of the metadata pad */
+static void sensor_meta_fmt(struct sensor_def *sensor, struct v4l2_mbus_framefmt *fmt)
+{
+   memset(fmt, 0, sizeof(*fmt));
+   fmt->code = MEDIA_BUS_FMT_SENSOR_DATA;
+   fmt->width = sensor->meta_bytes;
+   fmt->height = sensor->meta_lines;
+   fmt->field = V4L2_FIELD_NONE;
+}
+
+/* Optional metadata stream of the camera, none unless its size is given */
+static void microlynx_read_metadata_cfg(struct device *dev, struct sensor_def *sensor)
+{
+   u32 dt = MIPI_CSI2_DT_EMBEDDED_8B;
+
+   if (device_property_read_u32(dev, "metadata-lines", &sensor->meta_lines) ||
+       device_property_read_u32(dev, "metadata-bytes", &sensor->meta_bytes) ||
+       !sensor->meta_lines || !sensor->meta_bytes) {
+      sensor->meta_lines = 0;
+      return;
+   }
+
+   device_property_read_u32(dev, "metadata-dt", &dt);
+   if (dt > 0x3f) {
+      dev_warn(dev, "invalid metadata data type 0x%x, using 0x%x\n",
+               dt, MIPI_CSI2_DT_EMBEDDED_8B);
+      dt = MIPI_CSI2_DT_EMBEDDED_8B;
+   }
+   sensor->meta_dt = dt;
+
+   dev_info(dev, "metadata: %u line(s) of %u bytes, data type 0x%x\n",
+            sensor->meta_lines, sensor->meta_bytes, sensor->meta_dt);
+}
+
 static void sensor_free_controls(struct sensor_def *sensor)
 {
    printk("DEBUG: sensor free controls");
@@ -129,6 +155,35 @@ static void sensor_free_controls(struct sensor_def *sensor)
    mutex_destroy(&sensor->mutex);
 }
 
+/* Decide if stream-on needs a stop/start cycle, from DT and the CSI-2 receiver */
+static bool microlynx_need_acq_restart(struct device *dev)
+{
+   struct fwnode_handle *endpoint;
+   struct fwnode_handle *receiver;
+   u32 mode = ACQ_RESTART_AUTO;
+   bool restart = true;
+
+   device_property_read_u32(dev, "acq-restart", &mode);
+   if (mode == ACQ_RESTART_ALWAYS)
+      return true;
+   if (mode == ACQ_RESTART_NEVER)
+      return false;
+
+   endpoint = fwnode_graph_get_next_endpoint(dev_fwnode(dev), NULL);
+   if (!endpoint)
+      return true;
+
+   receiver = fwnode_graph_get_remote_port_parent(endpoint);
+   if (receiver) {
+      restart = of_device_is_compatible(to_of_node(receiver),
+                                        "raspberrypi,rp1-cfe");
+      fwnode_handle_put(receiver);
+   }
+   fwnode_handle_put(endpoint);
+
+   return restart;
+}
+
 static int microlynx_check_hwcfg(struct device *dev) {
    struct fwnode_handle *endpoint;
 
@@ -225,19 +280,28 @@ static int microlynx_sensor_check(struct sensor_def *sensor) {
    }
 
    // Resolution
-   // Set Height
+   // Initial height comes from the DT overlay, it can be changed later
+   // through set_fmt.
+   sensor->line_height = MICROLYNX_DEF_LINE_HEIGHT;
    device_property_read_u32(&sensor->i2c_client->dev, "line-height", &sensor->line_height);
+   sensor->line_height = clamp_t(u32, sensor->line_height,
+                                 MICROLYNX_MIN_LINE_HEIGHT,
+                                 MICROLYNX_MAX_LINE_HEIGHT);
    printk("line height read: %u.\n", sensor->line_height);
 
-   // Height check
+   // Height check, program the camera if it doesn't match the driver
    status = GENCPCLIENT_ReadRegister(REG_IMG_HEIGHT_RW, &read_data);
    if (status == 0) {
       if (read_data == sensor->line_height){
          PRINT_INFO("Camera and driver line heights match, height = %#08x\n", read_data);
       } else {
-         // NOTE: Should driver program the camera if there is a missmatch?
-         PRINT_ERROR("Camera and drier line heights don't match. Make sure the correct line height is set on the device tree overlay or on the camera.\n");
-         PRINT_ERROR("Camera = %u, Driver = %u\n", read_data, sensor->line_height);
+         PRINT_INFO("Camera line height %u differs from driver, programming %u\n",
+                    read_data, sensor->line_height);
+         status = GENCPCLIENT_WriteRegister(REG_IMG_HEIGHT_RW, sensor->line_height);
+         if (status) {
+            PRINT_INFO("Line height write failed, keeping camera value %u\n", read_data);
+            sensor->line_height = read_data;
+         }
       }
    } else {
       PRINT_INFO("Register read failed\n");
@@ -355,6 +419,13 @@ static int sensor_init_state(struct v4l2_subdev *sd,
    crop->width  = sensor->fmt.width;
    crop->height = sensor->fmt.height;
 
+   if (sensor->num_pads > MICROLYNX_PAD_METADATA)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+      sensor_meta_fmt(sensor, v4l2_subdev_get_try_format(sd, state, MICROLYNX_PAD_METADATA));
+#else
+      sensor_meta_fmt(sensor, v4l2_subdev_state_get_format(state, MICROLYNX_PAD_METADATA));
+#endif
+
    return 0;
 }
 
@@ -385,6 +456,13 @@ static int sensor_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
    try_crop->width = try_img_fmt->width;
    try_crop->height = try_img_fmt->height;
 
+   if (sensor->num_pads > MICROLYNX_PAD_METADATA)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
+      sensor_meta_fmt(sensor, v4l2_subdev_get_try_format(sd, fh->state, MICROLYNX_PAD_METADATA));
+#else
+      sensor_meta_fmt(sensor, v4l2_subdev_state_get_format(fh->state, MICROLYNX_PAD_METADATA));
+#endif
+
    return 0;
 }
 
@@ -396,6 +474,10 @@ static int sensor_get_pad_format(struct v4l2_subdev *sd,
    struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
 
    // printk("DEBUG: GET sensor pad format called\n");
+   if (fmt->pad == MICROLYNX_PAD_METADATA && sensor->num_pads > MICROLYNX_PAD_METADATA) {
+      sensor_meta_fmt(sensor, &fmt->format);
+      return 0;
+   }
    if (fmt->pad)
       return -EINVAL;
 
@@ -420,17 +502,40 @@ static int sensor_get_pad_format(struct v4l2_subdev *sd,
    return 0;
 }
 
-static const struct sensor_mode *sensor_find_mode(u32 width, u32 height)
+/*
+ * Program the frame height (lines per buffer) on the camera.
+ * Must be called with sensor->mutex held and acquisition stopped.
+ */
+static int sensor_write_line_height(struct sensor_def *sensor, u32 height)
 {
-    int i;
-    for (i = 0; i < NUM_SUPPORTED_MODES; i++) {
-        if (sensor_supported_modes[i].width == width &&
-            sensor_supported_modes[i].height == height)
-            return &sensor_supported_modes[i];
-    }
-    return NULL;
-}
+   u32 read_data = 0;
+   int status;
+
+   if (height == sensor->line_height)
+      return 0;
 
+   mutex_lock(&microlynx_gencp_lock);
+   status = GENCPCLIENT_WriteRegister(REG_IMG_HEIGHT_RW, height);
+   if (status == 0)
+      status = GENCPCLIENT_ReadRegister(REG_IMG_HEIGHT_RW, &read_data);
+   mutex_unlock(&microlynx_gencp_lock);
+
+   if (status) {
+      dev_err(&sensor->i2c_client->dev,
+              "failed to program line height %u (GenCP status 0x%04x)\n",
+              height, status);
+      return -EIO;
+   }
+   if (read_data != height) {
+      dev_err(&sensor->i2c_client->dev,
+              "camera refused line height %u (reads back %u)\n",
+              height, read_data);
+      return -EINVAL;
+   }
+
+   sensor->line_height = height;
+   return 0;
+}
 
 static int sensor_set_pad_format(
       struct v4l2_subdev *sd,
@@ -439,37 +544,50 @@ static int sensor_set_pad_format(
 {
    struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
    struct v4l2_mbus_framefmt *format;
+   int ret = 0;
 
-   printk("DEBUG: SET sensor pad format called");
+   /* The metadata format is set by the camera */
+   if (fmt->pad == MICROLYNX_PAD_METADATA && sensor->num_pads > MICROLYNX_PAD_METADATA) {
+      sensor_meta_fmt(sensor, &fmt->format);
+      return 0;
+   }
    if (fmt->pad)
       return -EINVAL;
 
-   const struct sensor_mode *mode = sensor_find_mode(fmt->format.width, fmt->format.height);
-
-   if (!mode)
-      return -EINVAL;
-
-   fmt->format.width = mode->width;
-   // fmt->format.height = mode->height;
-   fmt->format.height = sensor->line_height;
+   /* Width is fixed by the detector, the height is the number of lines per frame */
+   fmt->format.width = sensor->native_width;
+   fmt->format.height = clamp_t(u32, fmt->format.height,
+                                MICROLYNX_MIN_LINE_HEIGHT,
+                                MICROLYNX_MAX_LINE_HEIGHT);
    fmt->format.code = sensor->active_mbus_code;
    fmt->format.field = V4L2_FIELD_NONE;
    fmt->format.colorspace = V4L2_COLORSPACE_RAW;
 
-
    if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0)
       format = v4l2_subdev_get_try_format(sd, sd_state, fmt->pad);
 #else
       format = v4l2_subdev_state_get_format(sd_state, fmt->pad);
 #endif
-   } else {
-      format = &sensor->fmt;
+      *format = fmt->format;
+      return 0;
    }
 
-   *format = fmt->format;
+   mutex_lock(&sensor->mutex);
+   if (sensor->streaming && fmt->format.height != sensor->line_height) {
+      ret = -EBUSY;
+      goto out;
+   }
 
-   return 0;
+   ret = sensor_write_line_height(sensor, fmt->format.height);
+   if (ret)
+      goto out;
+
+   sensor->fmt = fmt->format;
+
+out:
+   mutex_unlock(&sensor->mutex);
+   return ret;
 }
 
 
@@ -481,6 +599,10 @@ static int sensor_enum_mbus_code(struct v4l2_subdev *sd,
 
    if (code->index > 0)
       return -EINVAL;
+   if (code->pad == MICROLYNX_PAD_METADATA && sensor->num_pads > MICROLYNX_PAD_METADATA) {
+      code->code = MEDIA_BUS_FMT_SENSOR_DATA;
+      return 0;
+   }
    if (code->pad)
       return -EINVAL;
 
@@ -489,32 +611,85 @@ static int sensor_enum_mbus_code(struct v4l2_subdev *sd,
    return 0;
 }
 
+/*
+ * Poll REG_ACQ_STATUS_R until the running bit matches @running.
+ * Must be called with microlynx_gencp_lock held.
+ */
+static int sensor_wait_acq_status(bool running)
+{
+   ktime_t timeout = ktime_add_us(ktime_get(), ACQ_STATUS_TIMEOUT_US);
+   u32 read_data = 0;
+   int status;
+
+   for (;;) {
+      status = GENCPCLIENT_ReadRegister(REG_ACQ_STATUS_R, &read_data);
+      if (status)
+         return -EIO;
+      if (!!(read_data & ACQ_STATUS_RUNNING) == running)
+         return 0;
+      if (ktime_after(ktime_get(), timeout))
+         return -ETIMEDOUT;
+      usleep_range(100, 200);
+   }
+}
+
 static int sensor_set_stream(struct v4l2_subdev *sd, int enable)
 {
-   int status = 0;
+   struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
+   ktime_t start;
+   u32 read_data = 0;
+   int ret = 0;
 
+   mutex_lock(&sensor->mutex);
    mutex_lock(&microlynx_gencp_lock);
    if (enable) {
-      /*
-       * Force a stop/start cycle so the camera MIPI transmitter goes
-       * through a proper LP->HS transition.  The DW DPHY on RP1 (RPi5)
-       * requires seeing this transition to synchronise; without it the
-       * DPHY never locks and no frames are captured.
-       */
-      GENCPCLIENT_WriteRegister(REG_ACQ_STOP_W, 0x1);
-      usleep_range(5000, 10000);
-      status = GENCPCLIENT_WriteRegister(REG_ACQ_START_W, 0x1);
-      if (status)
+      start = ktime_get();
+
+      if (sensor->force_acq_restart) {
+         /*
+          * Force a stop/start cycle so the camera MIPI transmitter goes
+          * through a proper LP->HS transition.  The DW DPHY on RP1 (RPi5)
+          * requires seeing this transition to synchronise; without it the
+          * DPHY never locks and no frames are captured.
+          */
+         GENCPCLIENT_WriteRegister(REG_ACQ_STOP_W, 0x1);
+         if (sensor_wait_acq_status(false))
+            usleep_range(5000, 10000);
+      } else if (GENCPCLIENT_ReadRegister(REG_ACQ_STATUS_R, &read_data) == 0 &&
+                 (read_data & ACQ_STATUS_RUNNING)) {
+         /* Already acquiring and the receiver doesn't need a restart */
+         goto started;
+      }
+
+      if (GENCPCLIENT_WriteRegister(REG_ACQ_START_W, 0x1)) {
          PRINT_ERROR("Failed to start acquisition\n");
-//      else
-//         PRINT_INFO("Acquisition started\n");
+         ret = -EIO;
+         goto out;
+      }
+
+      ret = sensor_wait_acq_status(true);
+      if (ret) {
+         dev_err(&sensor->i2c_client->dev,
+                 "camera did not report acquisition running: %d\n", ret);
+         /* Don't leave a half started acquisition behind */
+         GENCPCLIENT_WriteRegister(REG_ACQ_STOP_W, 0x1);
+         goto out;
+      }
+
+started:
+      sensor->acq_start_latency_us = ktime_us_delta(ktime_get(), start);
+      dev_dbg(&sensor->i2c_client->dev, "acquisition start took %u us\n",
+              sensor->acq_start_latency_us);
    } else {
       GENCPCLIENT_WriteRegister(REG_ACQ_STOP_W, 0x1);
 //     PRINT_INFO("Acquisition stopped\n");
    }
+   sensor->streaming = enable;
+out:
    mutex_unlock(&microlynx_gencp_lock);
+   mutex_unlock(&sensor->mutex);
 
-   return 0;
+   return ret;
 }
 
 static int sensor_enum_frame_size(struct v4l2_subdev *sd,
@@ -523,8 +698,16 @@ static int sensor_enum_frame_size(struct v4l2_subdev *sd,
 {
    struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
 
-   if (fse->index >= NUM_SUPPORTED_MODES)
+   /* Single stepwise entry: fixed width, any height within camera limits */
+   if (fse->index > 0)
       return -EINVAL;
+   if (fse->pad == MICROLYNX_PAD_METADATA && sensor->num_pads > MICROLYNX_PAD_METADATA) {
+      if (fse->code != MEDIA_BUS_FMT_SENSOR_DATA)
+         return -EINVAL;
+      fse->min_width = fse->max_width = sensor->meta_bytes;
+      fse->min_height = fse->max_height = sensor->meta_lines;
+      return 0;
+   }
    if (fse->pad)
       return -EINVAL;
    if (fse->code != sensor->active_mbus_code)
@@ -532,8 +715,8 @@ static int sensor_enum_frame_size(struct v4l2_subdev *sd,
 
    fse->min_width  = sensor->native_width;
    fse->max_width  = sensor->native_width;
-   fse->min_height = sensor->line_height;
-   fse->max_height = sensor->line_height;
+   fse->min_height = MICROLYNX_MIN_LINE_HEIGHT;
+   fse->max_height = MICROLYNX_MAX_LINE_HEIGHT;
 
    return 0;
 }
@@ -587,6 +770,63 @@ static int sensor_get_selection(struct v4l2_subdev *sd,
    return -EINVAL;
 }
 
+static int sensor_get_frame_desc(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_frame_desc *fd)
+{
+   struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
+
+   if (pad >= sensor->num_pads)
+      return -EINVAL;
+
+   /*
+    * The image on virtual channel 0, RAW14 or RAW16 as read at probe, then
+    * the metadata when there's some. The stream of an entry is the index of
+    * its source pad.
+    */
+   memset(fd, 0, sizeof(*fd));
+   fd->type = V4L2_MBUS_FRAME_DESC_TYPE_CSI2;
+   fd->num_entries = 1;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+   fd->entry[0].stream = MICROLYNX_PAD_IMAGE;
+#endif
+   fd->entry[0].pixelcode = sensor->active_mbus_code;
+   fd->entry[0].bus.csi2.vc = 0;
+   fd->entry[0].bus.csi2.dt =
+      sensor->active_mbus_code == MEDIA_BUS_FMT_Y14_1X14 ?
+      MIPI_CSI2_DT_RAW14 : MIPI_CSI2_DT_RAW16;
+
+   if (sensor->num_pads > MICROLYNX_PAD_METADATA) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+      fd->entry[1].stream = MICROLYNX_PAD_METADATA;
+#endif
+      fd->entry[1].flags = V4L2_MBUS_FRAME_DESC_FL_LEN_MAX;
+      fd->entry[1].length = sensor->meta_bytes * sensor->meta_lines;
+      fd->entry[1].pixelcode = MEDIA_BUS_FMT_SENSOR_DATA;
+      fd->entry[1].bus.csi2.vc = 0;
+      fd->entry[1].bus.csi2.dt = sensor->meta_dt;
+      fd->num_entries = 2;
+   }
+
+   return 0;
+}
+
+static int sensor_get_mbus_config(struct v4l2_subdev *sd, unsigned int pad,
+      struct v4l2_mbus_config *config)
+{
+   struct sensor_def *sensor = container_of(sd, struct sensor_def, sd);
+
+   if (pad >= sensor->num_pads)
+      return -EINVAL;
+
+   memset(config, 0, sizeof(*config));
+   config->type = V4L2_MBUS_CSI2_DPHY;
+   config->bus.mipi_csi2.num_data_lanes =
+      microlynx_ep_cfg.bus.mipi_csi2.num_data_lanes;
+   config->bus.mipi_csi2.flags = microlynx_ep_cfg.bus.mipi_csi2.flags;
+
+   return 0;
+}
+
 static const struct v4l2_subdev_core_ops sensor_core_ops = {
    .subscribe_event = v4l2_ctrl_subdev_subscribe_event,
    .unsubscribe_event = v4l2_event_subdev_unsubscribe,
@@ -603,6 +843,8 @@ static const struct v4l2_subdev_pad_ops sensor_pad_ops = {
    .get_selection       = sensor_get_selection,
    .enum_frame_size     = sensor_enum_frame_size,
    .enum_frame_interval = sensor_enum_frame_interval,
+   .get_frame_desc      = sensor_get_frame_desc,
+   .get_mbus_config     = sensor_get_mbus_config,
 };
 
 static const struct v4l2_subdev_ops sensor_subdev_ops = {
@@ -616,6 +858,17 @@ static const struct v4l2_subdev_internal_ops sensor_internal_ops = {
    .open       = sensor_open,
 };
 
+/* ---- sysfs ------------------------------------------------------------ */
+
+static ssize_t acq_start_latency_us_show(struct device *dev,
+      struct device_attribute *attr, char *buf)
+{
+   struct sensor_def *sensor = i2c_get_clientdata(to_i2c_client(dev));
+
+   return sysfs_emit(buf, "%u\n", sensor->acq_start_latency_us);
+}
+static DEVICE_ATTR_RO(acq_start_latency_us);
+
 /* ---- GenCP chardev file operations ------------------------------------ */
 
 static int microlynx_cdev_open(struct inode *inode, struct file *file)
@@ -725,6 +978,12 @@ static int microlynx_probe(struct i2c_client *client)
    if (ret)
       return ret;
 
+   sensor->force_acq_restart = microlynx_need_acq_restart(dev);
+   dev_info(dev, "Acquisition restart at stream-on: %s\n",
+            sensor->force_acq_restart ? "enabled" : "disabled");
+
+   microlynx_read_metadata_cfg(dev, sensor);
+
    //Define the initial camera format
    // sensor->fmt.width = sensor_supported_modes[0].width;
    // sensor->fmt.height = sensor_supported_modes[0].height;
@@ -750,11 +1009,13 @@ static int microlynx_probe(struct i2c_client *client)
       V4L2_SUBDEV_FL_HAS_EVENTS;
    sensor->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR; // setup for cameras
 
-   /* Initialize source pads */
-   sensor->pad.flags = MEDIA_PAD_FL_SOURCE;
+   /* Initialize source pads, the image and the optional metadata */
+   sensor->pad[MICROLYNX_PAD_IMAGE].flags = MEDIA_PAD_FL_SOURCE;
+   sensor->pad[MICROLYNX_PAD_METADATA].flags = MEDIA_PAD_FL_SOURCE;
+   sensor->num_pads = sensor->meta_lines ? MICROLYNX_NUM_PADS : 1;
 
-   ret = media_entity_pads_init(&sensor->sd.entity, 1,
-         &sensor->pad);
+   ret = media_entity_pads_init(&sensor->sd.entity, sensor->num_pads,
+         sensor->pad);
    if (ret) {
       dev_err(dev, "failed to init entity pads: %d\n", ret);
       goto error_handler_free;
@@ -785,6 +1046,9 @@ static int microlynx_probe(struct i2c_client *client)
       dev_info(dev, "GenCP chardev registered at /dev/%s\n",
             sensor->miscdev_name);
 
+   if (device_create_file(dev, &dev_attr_acq_start_latency_us))
+      dev_warn(dev, "failed to create acq_start_latency_us sysfs entry\n");
+
    dev_info(&client->dev, "Minimal CSI sensor driver probed\n");
 
    dev_info(dev, "registered\n");
@@ -806,6 +1070,7 @@ static void microlynx_remove(struct i2c_client *client)
 {
     struct sensor_def *sensor = i2c_get_clientdata(client);
 
+    device_remove_file(&client->dev, &dev_attr_acq_start_latency_us);
     misc_deregister(&sensor->miscdev);
     v4l2_async_unregister_subdev(&sensor->sd);
     v4l2_subdev_cleanup(&sensor->sd);
@@ -0,0 +1,52 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef MICROLYNX_IOCTL_H
+#define MICROLYNX_IOCTL_H
+
+/*
+ * GenCP userspace chardev (/dev/microlynx-<bus>-<addr>) interface, shared by
+ * the kernel module and the userspace tools.
+ */
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct microlynx_reg_op - ioctl payload for 32-bit register read/write
+ * @addr: GenCP register address
+ * @val:  value written (WRITE_REG) or value returned (READ_REG)
+ */
+struct microlynx_reg_op {
+	__u32 addr;
+	__u32 val;
+};
+
+#define MICROLYNX_STR_MAX 256
+
+/**
+ * struct microlynx_str_op - ioctl payload for GenCP string read
+ * @addr: GenCP register address of the string
+ * @len:  number of bytes to read (clamped to MICROLYNX_STR_MAX)
+ * @buf:  buffer filled with the string data on return
+ */
+struct microlynx_str_op {
+	__u32 addr;
+	__u32 len;
+	__u8  buf[MICROLYNX_STR_MAX];
+};
+
+#define MICROLYNX_IOCTL_MAGIC    'M'
+/* _IOWR('M', 1, struct microlynx_reg_op) */
+#define MICROLYNX_IOCTL_READ_REG  _IOWR(MICROLYNX_IOCTL_MAGIC, 1, \
+					struct microlynx_reg_op)
+/* _IOW('M', 2, struct microlynx_reg_op) */
+#define MICROLYNX_IOCTL_WRITE_REG _IOW(MICROLYNX_IOCTL_MAGIC,  2, \
+					struct microlynx_reg_op)
+/* _IOWR('M', 3, struct microlynx_str_op) */
+#define MICROLYNX_IOCTL_READ_STR  _IOWR(MICROLYNX_IOCTL_MAGIC, 3, \
+					struct microlynx_str_op)
+
+#endif /* MICROLYNX_IOCTL_H */
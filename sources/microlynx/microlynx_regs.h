@@ -0,0 +1,23 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef MICROLYNX_REGS_H
+#define MICROLYNX_REGS_H
+
+/* Microlynx GenCP register map, shared by the kernel module and the userspace tools */
+
+#define REG_ACQ_START_W   0x500F0000
+#define REG_ACQ_STOP_W    0x500F0004
+#define REG_ACQ_STATUS_R  0x500F0008
+#define REG_IMG_HEIGHT_RW 0x500E000C
+#define REG_IMG_WIDTH_R   0x500E0008
+#define REG_MIPI_ENA_R    0x50ff0010
+#define REG_FIRW_VER_R    0x50FF0000
+#define REG_PIXEL_FORMAT  0x500e0018
+#define PIXEL_FORMAT_MONO16 0x01100007u
+#define PIXEL_FORMAT_MONO14 0x01100025u
+#define ACQ_STATUS_RUNNING  (1u << 0)
+
+#endif /* MICROLYNX_REGS_H */
@@ -0,0 +1,944 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * exo-multicam - synchronized capture of the Exosens cameras of a Pi 5.
+ *
+ * Finds the EngineCore, Dione and MicroLynx sensors on the two CFE
+ * instances (CAM/DISP 0 and 1), links each sensor to the first CSI-2 DMA
+ * channel of its CFE with the sensor format, captures both and publishes the
+ * frames as pairs in a shared memory ring (multicam_ring.h).
+ *
+ * Frames are paired on their frame start timestamps: both CFEs stamp the
+ * frame start interrupt with CLOCK_MONOTONIC, so the two are on the same
+ * clock. The oldest frames of the two cameras make a pair when they're less
+ * than the tolerance apart (half a frame period by default), otherwise the
+ * older one is dropped. With -S, the sequence numbers are used once the
+ * first pair is found, for cameras sharing a frame sync where the offset of
+ * the two CFE sequences then never changes.
+ *
+ * The skew (camera 1 - camera 0) statistics of the pairs are kept in the
+ * ring header and reported periodically.
+ *
+ * With -r, reads the ring and prints the pairs (an example of a reader).
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/media.h>
+#include <linux/v4l2-subdev.h>
+#include <linux/videodev2.h>
+
+#include "multicam_ring.h"
+
+#define NUM_BUFFERS    6
+#define NUM_SLOTS      8
+#define CFE_MODEL      "rp1-cfe"
+
+/* Pads of the rp1-cfe graph: csi2 sink, csi2 source of channel 0 */
+#define CSI2_PAD_SINK  0
+#define CSI2_PAD_CH0   4
+
+/* Sequence mode: back to timestamps after this many frames without a match */
+#define SEQ_RELOCK     8
+
+/* Tolerance until the frame period is known */
+#define DEFAULT_TOL_NS 8000000
+
+static const char *const sensor_names[] = { "eg-ec", "dioneir", "microlynx" };
+
+struct camera {
+   char     sensor[64];      /* Entity name */
+   char     subdev[128];     /* Sensor subdev node */
+   char     csi2[128];       /* CFE csi2 subdev node */
+   char     video[128];      /* rp1-cfe-csi2_ch0 node */
+   char     bus_info[32];
+   int      media;
+   uint32_t csi2_id, ch0_id, fe_id;
+   struct v4l2_mbus_framefmt mbus;
+
+   int      fd;
+   unsigned nbufs;
+   void    *map[NUM_BUFFERS];
+   size_t   len[NUM_BUFFERS];
+   struct v4l2_pix_format pix;
+   uint64_t offset;         /* Of the frames in the ring slots */
+
+   /* Dequeued, not paired yet, oldest first */
+   struct v4l2_buffer pending[NUM_BUFFERS];
+   unsigned npending;
+
+   int      have_seq;
+   uint32_t last_seq;
+   uint64_t last_ts;
+   double   period_ns;
+   uint32_t seq_offset;     /* From camera 0, with -S */
+};
+
+struct multicam {
+   struct camera cam[MULTICAM_MAX_CAMS];
+   unsigned ncams;
+   struct multicam_ring *ring;
+   size_t   ring_size;
+   uint64_t pairs;
+   int64_t  tol_ns;
+   int      seq_mode, seq_locked;
+   unsigned seq_misses;
+   double   m2;             /* Skew variance accumulator */
+   struct multicam_skew st;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+static double mono_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *fourcc_str(uint32_t f, char *buf)
+{
+   buf[0] = f & 0xff;
+   buf[1] = (f >> 8) & 0xff;
+   buf[2] = (f >> 16) & 0xff;
+   buf[3] = (f >> 24) & 0xff;
+   buf[4] = 0;
+   return buf;
+}
+
+static int stream(int fd, enum v4l2_buf_type type, int on)
+{
+   return xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type);
+}
+
+static uint64_t buf_ts_ns(const struct v4l2_buffer *buf)
+{
+   return buf->timestamp.tv_sec * 1000000000ull + buf->timestamp.tv_usec * 1000ull;
+}
+
+/* ---- Media graph ------------------------------------------------------ */
+
+struct topology {
+   struct media_v2_topology topo;
+   struct media_v2_entity *ents;
+   struct media_v2_interface *ifaces;
+   struct media_v2_link *links;
+};
+
+static void topology_free(struct topology *t)
+{
+   free(t->ents);
+   free(t->ifaces);
+   free(t->links);
+}
+
+static int topology_get(int fd, struct topology *t)
+{
+   int ret;
+
+   memset(t, 0, sizeof(*t));
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &t->topo);
+   if (ret)
+      return ret;
+   t->ents = calloc(t->topo.num_entities, sizeof(*t->ents));
+   t->ifaces = calloc(t->topo.num_interfaces, sizeof(*t->ifaces));
+   t->links = calloc(t->topo.num_links, sizeof(*t->links));
+   if (!t->ents || !t->ifaces || !t->links) {
+      topology_free(t);
+      return -ENOMEM;
+   }
+   t->topo.ptr_entities = (uintptr_t)t->ents;
+   t->topo.ptr_interfaces = (uintptr_t)t->ifaces;
+   t->topo.ptr_links = (uintptr_t)t->links;
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &t->topo);
+   if (ret)
+      topology_free(t);
+   return ret;
+}
+
+static const struct media_v2_entity *topology_entity(const struct topology *t,
+                                                     const char *name)
+{
+   unsigned i;
+
+   for (i = 0; i < t->topo.num_entities; i++)
+      if (!strcmp(t->ents[i].name, name))
+         return &t->ents[i];
+   return NULL;
+}
+
+/* /dev path of the character device @major:@minor */
+static int devnode_path(unsigned major, unsigned minor, char *path, size_t len)
+{
+   char uevent[64], line[128];
+   int ret = -ENOENT;
+   FILE *f;
+
+   snprintf(uevent, sizeof(uevent), "/sys/dev/char/%u:%u/uevent", major, minor);
+   f = fopen(uevent, "r");
+   if (!f)
+      return -errno;
+   while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, "DEVNAME=", 8)) {
+         line[strcspn(line, "\n")] = 0;
+         snprintf(path, len, "/dev/%s", line + 8);
+         ret = 0;
+         break;
+      }
+   }
+   fclose(f);
+   return ret;
+}
+
+/* Device node (video or subdev) of the entity @id */
+static int topology_devnode(const struct topology *t, uint32_t id, char *path, size_t len)
+{
+   unsigned i, j;
+
+   for (i = 0; i < t->topo.num_links; i++) {
+      if ((t->links[i].flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_INTERFACE_LINK ||
+          t->links[i].sink_id != id)
+         continue;
+      for (j = 0; j < t->topo.num_interfaces; j++)
+         if (t->ifaces[j].id == t->links[i].source_id)
+            return devnode_path(t->ifaces[j].devnode.major,
+                                t->ifaces[j].devnode.minor, path, len);
+   }
+   return -ENOENT;
+}
+
+static int is_exosens_sensor(const struct media_v2_entity *ent)
+{
+   unsigned i;
+
+   if (ent->function != MEDIA_ENT_F_CAM_SENSOR)
+      return 0;
+   for (i = 0; i < sizeof(sensor_names) / sizeof(sensor_names[0]); i++)
+      if (!strncmp(ent->name, sensor_names[i], strlen(sensor_names[i])))
+         return 1;
+   return 0;
+}
+
+/* Camera of the CFE media device @fd, -ENODEV without an Exosens sensor */
+static int camera_probe(struct camera *cam, int fd, const char *bus_info)
+{
+   const struct media_v2_entity *sensor = NULL, *csi2, *ch0, *fe;
+   struct topology t;
+   unsigned i;
+   int ret;
+
+   ret = topology_get(fd, &t);
+   if (ret)
+      return ret;
+   for (i = 0; i < t.topo.num_entities && !sensor; i++)
+      if (is_exosens_sensor(&t.ents[i]))
+         sensor = &t.ents[i];
+   csi2 = topology_entity(&t, "csi2");
+   ch0 = topology_entity(&t, "rp1-cfe-csi2_ch0");
+   fe = topology_entity(&t, "pisp-fe");
+   if (!sensor || !csi2 || !ch0) {
+      ret = -ENODEV;
+      goto out;
+   }
+
+   memset(cam, 0, sizeof(*cam));
+   cam->fd = -1;
+   cam->media = fd;
+   snprintf(cam->sensor, sizeof(cam->sensor), "%s", sensor->name);
+   snprintf(cam->bus_info, sizeof(cam->bus_info), "%s", bus_info);
+   cam->csi2_id = csi2->id;
+   cam->ch0_id = ch0->id;
+   cam->fe_id = fe ? fe->id : 0;
+   ret = topology_devnode(&t, sensor->id, cam->subdev, sizeof(cam->subdev));
+   if (!ret)
+      ret = topology_devnode(&t, csi2->id, cam->csi2, sizeof(cam->csi2));
+   if (!ret)
+      ret = topology_devnode(&t, ch0->id, cam->video, sizeof(cam->video));
+
+out:
+   topology_free(&t);
+   return ret;
+}
+
+/* All the cameras, in the order of the CFE instances (CAM/DISP 0 first) */
+static int cameras_find(struct multicam *mc)
+{
+   char path[32];
+   int i, fd;
+
+   for (i = 0; i < 64 && mc->ncams < MULTICAM_MAX_CAMS; i++) {
+      struct media_device_info info;
+      struct camera *cam = &mc->cam[mc->ncams];
+
+      snprintf(path, sizeof(path), "/dev/media%d", i);
+      fd = open(path, O_RDWR | O_CLOEXEC);
+      if (fd < 0)
+         continue;
+      if (xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info) || strcmp(info.model, CFE_MODEL) ||
+          camera_probe(cam, fd, info.bus_info)) {
+         close(fd);
+         continue;
+      }
+      mc->ncams++;
+   }
+
+   /* Media devices are numbered in probe order, the bus addresses are fixed */
+   if (mc->ncams == 2 && strcmp(mc->cam[0].bus_info, mc->cam[1].bus_info) > 0) {
+      struct camera tmp = mc->cam[0];
+
+      mc->cam[0] = mc->cam[1];
+      mc->cam[1] = tmp;
+   }
+   return mc->ncams;
+}
+
+static int setup_link(int fd, uint32_t src, uint16_t src_pad, uint32_t sink,
+                      uint16_t sink_pad, int enable)
+{
+   struct media_link_desc link = {
+      .source = { .entity = src, .index = src_pad },
+      .sink = { .entity = sink, .index = sink_pad },
+      .flags = enable ? MEDIA_LNK_FL_ENABLED : 0,
+   };
+
+   return xioctl(fd, MEDIA_IOC_SETUP_LINK, &link);
+}
+
+static int subdev_format(const char *node, unsigned pad, struct v4l2_mbus_framefmt *mbus,
+                         int set)
+{
+   struct v4l2_subdev_format fmt = {
+      .which = V4L2_SUBDEV_FORMAT_ACTIVE,
+      .pad = pad,
+   };
+   int fd, ret;
+
+   fd = open(node, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return -errno;
+   if (set)
+      fmt.format = *mbus;
+   ret = xioctl(fd, set ? VIDIOC_SUBDEV_S_FMT : VIDIOC_SUBDEV_G_FMT, &fmt);
+   if (!ret)
+      *mbus = fmt.format;
+   close(fd);
+   return ret;
+}
+
+/*
+ * What eg_media_configure_rp1_cfe.sh does: sensor -> csi2 -> csi2_ch0, the
+ * sensor format on the csi2 pads. The sensor format is the one it streams.
+ */
+static int camera_configure(struct camera *cam, int keep)
+{
+   struct v4l2_mbus_framefmt mbus;
+   int ret;
+
+   ret = subdev_format(cam->subdev, 0, &cam->mbus, 0);
+   if (ret) {
+      fprintf(stderr, "%s: sensor format: %s\n", cam->sensor, strerror(-ret));
+      return ret;
+   }
+   if (keep)
+      return 0;
+
+   if (cam->fe_id)
+      setup_link(cam->media, cam->csi2_id, CSI2_PAD_CH0, cam->fe_id, 0, 0);
+   ret = setup_link(cam->media, cam->csi2_id, CSI2_PAD_CH0, cam->ch0_id, 0, 1);
+   if (ret) {
+      fprintf(stderr, "%s: csi2 -> rp1-cfe-csi2_ch0 link: %s\n", cam->sensor,
+              strerror(-ret));
+      return ret;
+   }
+
+   mbus = cam->mbus;
+   mbus.field = V4L2_FIELD_NONE;
+   ret = subdev_format(cam->csi2, CSI2_PAD_SINK, &mbus, 1);
+   if (!ret) {
+      mbus = cam->mbus;
+      mbus.field = V4L2_FIELD_NONE;
+      ret = subdev_format(cam->csi2, CSI2_PAD_CH0, &mbus, 1);
+   }
+   if (!ret && (mbus.code != cam->mbus.code || mbus.width != cam->mbus.width ||
+                mbus.height != cam->mbus.height))
+      ret = -EINVAL;
+   if (ret)
+      fprintf(stderr, "%s: csi2 format 0x%04x %ux%u: %s\n", cam->sensor,
+              cam->mbus.code, cam->mbus.width, cam->mbus.height, strerror(-ret));
+   return ret;
+}
+
+/* ---- Capture ---------------------------------------------------------- */
+
+static int capture_open(struct camera *cam, int keep)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_fmtdesc desc = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .mbus_code = cam->mbus.code,
+   };
+   struct v4l2_requestbuffers req = {
+      .count = NUM_BUFFERS,
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   unsigned i;
+   int ret;
+
+   cam->fd = open(cam->video, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (cam->fd < 0)
+      return -errno;
+
+   ret = xioctl(cam->fd, VIDIOC_G_FMT, &fmt);
+   if (!ret && !keep) {
+      /* First pixel format of the bus format: unpacked, uncompressed */
+      ret = xioctl(cam->fd, VIDIOC_ENUM_FMT, &desc);
+      if (!ret) {
+         fmt.fmt.pix.width = cam->mbus.width;
+         fmt.fmt.pix.height = cam->mbus.height;
+         fmt.fmt.pix.pixelformat = desc.pixelformat;
+         fmt.fmt.pix.bytesperline = 0;
+         fmt.fmt.pix.sizeimage = 0;
+         fmt.fmt.pix.field = V4L2_FIELD_NONE;
+         ret = xioctl(cam->fd, VIDIOC_S_FMT, &fmt);
+      }
+   }
+   if (ret)
+      return ret;
+   cam->pix = fmt.fmt.pix;
+
+   ret = xioctl(cam->fd, VIDIOC_REQBUFS, &req);
+   if (ret)
+      return ret;
+   cam->nbufs = req.count;
+   for (i = 0; i < cam->nbufs; i++) {
+      struct v4l2_buffer buf = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .memory = V4L2_MEMORY_MMAP,
+         .index = i,
+      };
+
+      ret = xioctl(cam->fd, VIDIOC_QUERYBUF, &buf);
+      if (ret)
+         return ret;
+      cam->map[i] = mmap(NULL, buf.length, PROT_READ, MAP_SHARED, cam->fd,
+                         buf.m.offset);
+      if (cam->map[i] == MAP_FAILED) {
+         cam->map[i] = NULL;
+         return -errno;
+      }
+      cam->len[i] = buf.length;
+   }
+   return 0;
+}
+
+static void capture_close(struct camera *cam)
+{
+   unsigned i;
+
+   if (cam->fd < 0)
+      return;
+   stream(cam->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+   for (i = 0; i < cam->nbufs; i++)
+      if (cam->map[i])
+         munmap(cam->map[i], cam->len[i]);
+   close(cam->fd);
+   cam->fd = -1;
+}
+
+static int capture_queue(struct camera *cam, unsigned index)
+{
+   struct v4l2_buffer buf = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = index,
+   };
+
+   return xioctl(cam->fd, VIDIOC_QBUF, &buf);
+}
+
+/* Dequeue all the frames ready into the pending list */
+static void capture_dequeue(struct camera *cam, struct multicam_skew *st, unsigned n)
+{
+   struct v4l2_buffer buf;
+
+   for (;;) {
+      uint64_t ts;
+
+      memset(&buf, 0, sizeof(buf));
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      if (xioctl(cam->fd, VIDIOC_DQBUF, &buf))
+         return;
+
+      if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+         capture_queue(cam, buf.index);
+         continue;
+      }
+
+      /* Frame period, per frame when the CFE lost some */
+      ts = buf_ts_ns(&buf);
+      if (cam->have_seq) {
+         uint32_t frames = buf.sequence - cam->last_seq;
+
+         if (frames > 1)
+            st->seq_gaps[n] += frames - 1;
+         if (frames && ts > cam->last_ts) {
+            double period = (double)(ts - cam->last_ts) / frames;
+
+            cam->period_ns = cam->period_ns ? cam->period_ns * 0.9 + period * 0.1 : period;
+         }
+      }
+      cam->have_seq = 1;
+      cam->last_seq = buf.sequence;
+      cam->last_ts = ts;
+
+      /* One buffer always left to the CFE, the other camera may have stopped */
+      if (cam->npending == cam->nbufs - 1) {
+         capture_queue(cam, cam->pending[0].index);
+         memmove(&cam->pending[0], &cam->pending[1],
+                 --cam->npending * sizeof(cam->pending[0]));
+         st->unpaired[n]++;
+      }
+      cam->pending[cam->npending++] = buf;
+   }
+}
+
+/* ---- Ring ------------------------------------------------------------- */
+
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((uint64_t)(a) - 1))
+
+static int ring_create(struct multicam *mc, const char *name, unsigned slots)
+{
+   uint64_t slot_size = ALIGN(sizeof(struct multicam_slot), 64);
+   uint64_t header = ALIGN(sizeof(struct multicam_ring), 4096);
+   struct multicam_ring *r;
+   unsigned i;
+   int fd;
+
+   for (i = 0; i < mc->ncams; i++) {
+      mc->cam[i].offset = slot_size;
+      slot_size += ALIGN(mc->cam[i].pix.sizeimage, 64);
+   }
+   slot_size = ALIGN(slot_size, 4096);
+   mc->ring_size = header + slots * slot_size;
+
+   /* A new object each time, readers of the previous one see it go away */
+   shm_unlink(name);
+   fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+   if (fd < 0)
+      return -errno;
+   if (ftruncate(fd, mc->ring_size)) {
+      close(fd);
+      return -errno;
+   }
+   r = mmap(NULL, mc->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (r == MAP_FAILED)
+      return -errno;
+
+   r->version = MULTICAM_RING_VERSION;
+   r->num_cams = mc->ncams;
+   r->num_slots = slots;
+   r->slot_size = slot_size;
+   r->slots_offset = header;
+   for (i = 0; i < mc->ncams; i++) {
+      const struct camera *cam = &mc->cam[i];
+      struct multicam_cam_info *info = &r->cam[i];
+
+      snprintf(info->name, sizeof(info->name), "%s", cam->sensor);
+      snprintf(info->bus_info, sizeof(info->bus_info), "%s", cam->bus_info);
+      info->width = cam->pix.width;
+      info->height = cam->pix.height;
+      info->pixelformat = cam->pix.pixelformat;
+      info->bytesperline = cam->pix.bytesperline;
+      info->sizeimage = cam->pix.sizeimage;
+   }
+   /* Readers check the magic last */
+   atomic_thread_fence(memory_order_release);
+   r->magic = MULTICAM_RING_MAGIC;
+   mc->ring = r;
+   return 0;
+}
+
+static void ring_publish(struct multicam *mc, int64_t skew)
+{
+   struct multicam_ring *r = mc->ring;
+   struct multicam_slot *s = multicam_slot(r, mc->pairs);
+   uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+   unsigned i;
+
+   atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+
+   s->index = mc->pairs;
+   s->skew_ns = skew;
+   for (i = 0; i < mc->ncams; i++) {
+      const struct camera *cam = &mc->cam[i];
+      const struct v4l2_buffer *buf = &cam->pending[0];
+      struct multicam_frame *f = &s->frame[i];
+
+      f->timestamp_ns = buf_ts_ns(buf);
+      f->sequence = buf->sequence;
+      f->bytesused = buf->bytesused < cam->pix.sizeimage ? buf->bytesused
+                                                         : cam->pix.sizeimage;
+      f->offset = cam->offset;
+      memcpy((uint8_t *)s + f->offset, cam->map[buf->index], f->bytesused);
+   }
+
+   atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+   atomic_store_explicit(&r->written, ++mc->pairs, memory_order_release);
+}
+
+static void stats_publish(struct multicam *mc)
+{
+   struct multicam_ring *r = mc->ring;
+   uint32_t seq = atomic_load_explicit(&r->stats_seq, memory_order_relaxed);
+
+   atomic_store_explicit(&r->stats_seq, seq + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+   r->stats = mc->st;
+   atomic_store_explicit(&r->stats_seq, seq + 2, memory_order_release);
+}
+
+/* ---- Pairing ---------------------------------------------------------- */
+
+static void skew_account(struct multicam *mc, int64_t skew)
+{
+   struct multicam_skew *st = &mc->st;
+   double delta;
+
+   /* Welford */
+   st->pairs++;
+   delta = skew - st->mean_ns;
+   st->mean_ns += delta / st->pairs;
+   mc->m2 += delta * (skew - st->mean_ns);
+   st->stddev_ns = st->pairs > 1 ? sqrt(mc->m2 / (st->pairs - 1)) : 0;
+   st->last_ns = skew;
+   if (st->pairs == 1 || skew < st->min_ns)
+      st->min_ns = skew;
+   if (st->pairs == 1 || skew > st->max_ns)
+      st->max_ns = skew;
+}
+
+static int64_t tolerance_ns(const struct multicam *mc)
+{
+   double period = 0;
+   unsigned i;
+
+   if (mc->tol_ns)
+      return mc->tol_ns;
+   for (i = 0; i < mc->ncams; i++)
+      if (mc->cam[i].period_ns && (!period || mc->cam[i].period_ns < period))
+         period = mc->cam[i].period_ns;
+   return period ? (int64_t)(period / 2) : DEFAULT_TOL_NS;
+}
+
+static void pending_pop(struct camera *cam)
+{
+   capture_queue(cam, cam->pending[0].index);
+   memmove(&cam->pending[0], &cam->pending[1], --cam->npending * sizeof(cam->pending[0]));
+}
+
+/* Pair the oldest frames of the cameras while they all have one */
+static void pair_frames(struct multicam *mc)
+{
+   for (;;) {
+      int64_t lo = 0, hi = 0, skew;
+      unsigned i, oldest = 0;
+      int match;
+
+      for (i = 0; i < mc->ncams; i++)
+         if (!mc->cam[i].npending)
+            return;
+
+      /* Frame position: timestamp, or sequence less the offset to camera 0 */
+      for (i = 0; i < mc->ncams; i++) {
+         const struct camera *cam = &mc->cam[i];
+         int64_t pos = mc->seq_locked
+            ? (int32_t)(cam->pending[0].sequence - mc->cam[0].pending[0].sequence -
+                        cam->seq_offset)
+            : (int64_t)buf_ts_ns(&cam->pending[0]);
+
+         if (!i || pos < lo) {
+            lo = pos;
+            oldest = i;
+         }
+         if (!i || pos > hi)
+            hi = pos;
+      }
+      match = mc->seq_locked ? lo == hi : hi - lo <= tolerance_ns(mc);
+
+      if (!match) {
+         mc->st.unpaired[oldest]++;
+         pending_pop(&mc->cam[oldest]);
+         if (mc->seq_locked && ++mc->seq_misses >= SEQ_RELOCK) {
+            fprintf(stderr, "exo-multicam: sequences out of step, pairing on timestamps\n");
+            mc->seq_locked = 0;
+         }
+         continue;
+      }
+
+      if (mc->seq_mode && !mc->seq_locked) {
+         for (i = 0; i < mc->ncams; i++)
+            mc->cam[i].seq_offset = mc->cam[i].pending[0].sequence -
+                                    mc->cam[0].pending[0].sequence;
+         mc->seq_locked = 1;
+      }
+      mc->seq_misses = 0;
+
+      skew = mc->ncams > 1 ? (int64_t)(buf_ts_ns(&mc->cam[1].pending[0]) -
+                                       buf_ts_ns(&mc->cam[0].pending[0])) : 0;
+      skew_account(mc, skew);
+      ring_publish(mc, skew);
+      for (i = 0; i < mc->ncams; i++)
+         pending_pop(&mc->cam[i]);
+   }
+}
+
+static void report(const struct multicam *mc, double seconds, uint64_t pairs)
+{
+   const struct multicam_skew *st = &mc->st;
+
+   printf("pairs %llu (%.1f/s) skew us: last %+.1f mean %+.1f sd %.1f min %+.1f max %+.1f"
+          " | unpaired %llu/%llu lost %llu/%llu\n",
+          (unsigned long long)st->pairs, pairs / seconds, st->last_ns * 1e-3,
+          st->mean_ns * 1e-3, st->stddev_ns * 1e-3, st->min_ns * 1e-3, st->max_ns * 1e-3,
+          (unsigned long long)st->unpaired[0], (unsigned long long)st->unpaired[1],
+          (unsigned long long)st->seq_gaps[0], (unsigned long long)st->seq_gaps[1]);
+   fflush(stdout);
+}
+
+/* ---- Reader ----------------------------------------------------------- */
+
+static int reader(const char *name, int seconds)
+{
+   const struct multicam_ring *r;
+   struct multicam_skew st;
+   uint64_t n, lost = 0;
+   double end = mono_s() + seconds;
+   struct stat sb;
+   unsigned i;
+   char fcc[5];
+   int fd;
+
+   fd = shm_open(name, O_RDONLY, 0);
+   if (fd < 0 || fstat(fd, &sb)) {
+      fprintf(stderr, "%s: %s\n", name, strerror(errno));
+      return 1;
+   }
+   r = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (r == MAP_FAILED || (size_t)sb.st_size < sizeof(*r) ||
+       r->magic != MULTICAM_RING_MAGIC || r->version != MULTICAM_RING_VERSION) {
+      fprintf(stderr, "%s: not an exo-multicam ring\n", name);
+      return 1;
+   }
+
+   for (i = 0; i < r->num_cams; i++)
+      printf("cam%u: %s on %s, %ux%u %s\n", i, r->cam[i].name, r->cam[i].bus_info,
+             r->cam[i].width, r->cam[i].height, fourcc_str(r->cam[i].pixelformat, fcc));
+
+   n = atomic_load_explicit(&r->written, memory_order_acquire);
+   while (!quit && (!seconds || mono_s() < end)) {
+      struct multicam_slot s;
+
+      if (n + r->num_slots <= atomic_load_explicit(&r->written, memory_order_acquire)) {
+         uint64_t next = atomic_load_explicit(&r->written, memory_order_acquire) - 1;
+
+         lost += next - n;
+         n = next;
+      }
+      if (multicam_read(r, n, &s, NULL)) {
+         usleep(1000);
+         continue;
+      }
+      printf("pair %llu skew %+.1f us", (unsigned long long)s.index, s.skew_ns * 1e-3);
+      for (i = 0; i < r->num_cams; i++)
+         printf(" | cam%u seq %u ts %.3f ms", i, s.frame[i].sequence,
+                s.frame[i].timestamp_ns * 1e-6);
+      printf("\n");
+      n++;
+   }
+
+   multicam_stats(r, &st);
+   printf("pairs %llu skew us: mean %+.1f sd %.1f min %+.1f max %+.1f, %llu missed here\n",
+          (unsigned long long)st.pairs, st.mean_ns * 1e-3, st.stddev_ns * 1e-3,
+          st.min_ns * 1e-3, st.max_ns * 1e-3, (unsigned long long)lost);
+   return 0;
+}
+
+/* ---- Main ------------------------------------------------------------- */
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: exo-multicam [-m NAME] [-n SLOTS] [-t USEC] [-S] [-k] [-i SECONDS]\n"
+      "                    [-T SECONDS]\n"
+      "       exo-multicam -r [-m NAME] [-T SECONDS]\n"
+      "  -m NAME    shared memory ring (default: " MULTICAM_RING_NAME ")\n"
+      "  -n SLOTS   pairs in the ring (default: %d)\n"
+      "  -t USEC    pairing tolerance (default: half the frame period)\n"
+      "  -S         pair on sequence numbers once the first pair is found\n"
+      "             (cameras sharing a frame sync)\n"
+      "  -k         keep the media graphs and the video formats as configured\n"
+      "  -i SECONDS skew report period, 0: none (default: 5)\n"
+      "  -T SECONDS run time, 0: until interrupted (default: 0)\n"
+      "  -r         read the ring and print the pairs\n", NUM_SLOTS);
+}
+
+int main(int argc, char **argv)
+{
+   struct multicam mc = { 0 };
+   const char *name = MULTICAM_RING_NAME;
+   unsigned slots = NUM_SLOTS, i;
+   int keep = 0, read_ring = 0, interval = 5, seconds = 0, ret = 1, opt;
+   double start, last, end;
+   uint64_t last_pairs = 0;
+   char fcc[5];
+
+   while ((opt = getopt(argc, argv, "m:n:t:Ski:T:rh")) != -1) {
+      switch (opt) {
+         case 'm': name = optarg; break;
+         case 'n': slots = atoi(optarg); break;
+         case 't': mc.tol_ns = atoll(optarg) * 1000; break;
+         case 'S': mc.seq_mode = 1; break;
+         case 'k': keep = 1; break;
+         case 'i': interval = atoi(optarg); break;
+         case 'T': seconds = atoi(optarg); break;
+         case 'r': read_ring = 1; break;
+         default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+      }
+   }
+   if (!slots || name[0] != '/') {
+      usage();
+      return 1;
+   }
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+
+   if (read_ring)
+      return reader(name, seconds);
+
+   if (cameras_find(&mc) < 2) {
+      fprintf(stderr, "exo-multicam: %u Exosens camera(s) found on the CFEs, 2 needed\n",
+              mc.ncams);
+      goto out;
+   }
+
+   for (i = 0; i < mc.ncams; i++) {
+      struct camera *cam = &mc.cam[i];
+
+      if (camera_configure(cam, keep))
+         goto out;
+      ret = capture_open(cam, keep);
+      if (ret) {
+         fprintf(stderr, "%s: %s: %s\n", cam->sensor, cam->video, strerror(-ret));
+         ret = 1;
+         goto out;
+      }
+      printf("cam%u: %s on %s, %s %ux%u %s\n", i, cam->sensor, cam->bus_info, cam->video,
+             cam->pix.width, cam->pix.height, fourcc_str(cam->pix.pixelformat, fcc));
+   }
+
+   ret = ring_create(&mc, name, slots);
+   if (ret) {
+      fprintf(stderr, "%s: %s\n", name, strerror(-ret));
+      ret = 1;
+      goto out;
+   }
+   printf("ring %s: %u slots of %llu bytes\n", name, slots,
+          (unsigned long long)mc.ring->slot_size);
+
+   /* Both queued first, then started back to back */
+   for (i = 0; i < mc.ncams; i++) {
+      unsigned b;
+
+      for (b = 0; b < mc.cam[i].nbufs; b++)
+         capture_queue(&mc.cam[i], b);
+   }
+   for (i = 0; i < mc.ncams; i++) {
+      ret = stream(mc.cam[i].fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+      if (ret) {
+         fprintf(stderr, "%s: stream on: %s\n", mc.cam[i].sensor, strerror(-ret));
+         ret = 1;
+         goto out;
+      }
+   }
+
+   start = last = mono_s();
+   end = start + seconds;
+   while (!quit && (!seconds || mono_s() < end)) {
+      struct pollfd pfd[MULTICAM_MAX_CAMS];
+      double now;
+
+      for (i = 0; i < mc.ncams; i++) {
+         pfd[i].fd = mc.cam[i].fd;
+         pfd[i].events = POLLIN;
+      }
+      if (poll(pfd, mc.ncams, 1000) < 0 && errno != EINTR)
+         break;
+      for (i = 0; i < mc.ncams; i++)
+         if (pfd[i].revents & POLLIN)
+            capture_dequeue(&mc.cam[i], &mc.st, i);
+      pair_frames(&mc);
+      stats_publish(&mc);
+
+      now = mono_s();
+      if (interval && now - last >= interval) {
+         report(&mc, now - last, mc.st.pairs - last_pairs);
+         last = now;
+         last_pairs = mc.st.pairs;
+      }
+   }
+   report(&mc, mono_s() - start, mc.st.pairs);
+   ret = 0;
+
+out:
+   for (i = 0; i < mc.ncams; i++) {
+      capture_close(&mc.cam[i]);
+      close(mc.cam[i].media);
+   }
+   if (mc.ring) {
+      munmap(mc.ring, mc.ring_size);
+      shm_unlink(name);
+   }
+   return ret;
+}
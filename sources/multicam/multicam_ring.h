@@ -0,0 +1,124 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef MULTICAM_RING_H
+#define MULTICAM_RING_H
+
+/*
+ * Shared memory ring of exo-multicam: time-aligned frame pairs of the
+ * cameras of both CFE instances of the Pi 5.
+ *
+ * The ring is a POSIX shared memory object (/exo-multicam by default): the
+ * header below, then num_slots slots of slot_size bytes from slots_offset.
+ * Each slot holds a struct multicam_slot and the frames of its pair, at
+ * frame[].offset from the start of the slot.
+ *
+ * There's a single writer, readers don't take any lock. Pair n is in slot
+ * n % num_slots; the slot sequence count is odd while it's written, a copy
+ * is good when the count was even and unchanged around it and the slot
+ * still holds pair n. Readers falling num_slots pairs behind lose pairs.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MULTICAM_RING_NAME     "/exo-multicam"
+#define MULTICAM_RING_MAGIC    0x4d434d58   /* "XMCM" */
+#define MULTICAM_RING_VERSION  1
+#define MULTICAM_MAX_CAMS      2
+
+struct multicam_cam_info {
+   char     name[64];         /* Sensor entity */
+   char     bus_info[32];     /* CFE instance, e.g. platform:1f00128000.csi */
+   uint32_t width, height;
+   uint32_t pixelformat;      /* V4L2 fourcc */
+   uint32_t bytesperline;
+   uint32_t sizeimage;
+   uint32_t reserved;
+};
+
+/* Start of frame skew of the pairs, camera 1 - camera 0 */
+struct multicam_skew {
+   uint64_t pairs;
+   int64_t  last_ns, min_ns, max_ns;
+   double   mean_ns, stddev_ns;
+   uint64_t unpaired[MULTICAM_MAX_CAMS];   /* Frames dropped without a match */
+   uint64_t seq_gaps[MULTICAM_MAX_CAMS];   /* Frames lost by the CFE */
+};
+
+struct multicam_frame {
+   uint64_t timestamp_ns;     /* Frame start, CLOCK_MONOTONIC */
+   uint32_t sequence;         /* V4L2 sequence of the CFE */
+   uint32_t bytesused;
+   uint64_t offset;           /* Of the data, from the start of the slot */
+};
+
+struct multicam_slot {
+   _Atomic uint32_t seq;      /* Odd while written */
+   uint32_t reserved;
+   uint64_t index;            /* Pair number */
+   int64_t  skew_ns;
+   struct multicam_frame frame[MULTICAM_MAX_CAMS];
+};
+
+struct multicam_ring {
+   uint32_t magic, version;
+   uint32_t num_cams, num_slots;
+   uint64_t slot_size;
+   uint64_t slots_offset;
+   struct multicam_cam_info cam[MULTICAM_MAX_CAMS];
+   _Atomic uint64_t written;  /* Pairs published, the last one is written - 1 */
+   _Atomic uint32_t stats_seq;
+   uint32_t reserved;
+   struct multicam_skew stats;
+};
+
+static inline struct multicam_slot *multicam_slot(const struct multicam_ring *r, uint64_t n)
+{
+   return (struct multicam_slot *)((uint8_t *)r + r->slots_offset +
+                                   (n % r->num_slots) * r->slot_size);
+}
+
+/*
+ * Copy pair @n: its slot header in @hdr and, when @data isn't NULL, the slot
+ * (header and frames, slot_size bytes) in @data.
+ * Returns 0, or -1 when the pair isn't written yet or was overwritten.
+ */
+static inline int multicam_read(const struct multicam_ring *r, uint64_t n,
+                                struct multicam_slot *hdr, void *data)
+{
+   struct multicam_slot *s = multicam_slot(r, n);
+   uint32_t seq;
+
+   if (n >= atomic_load_explicit(&r->written, memory_order_acquire))
+      return -1;
+   seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+   if (seq & 1)
+      return -1;
+   memcpy(hdr, s, sizeof(*hdr));
+   if (data)
+      memcpy(data, s, r->slot_size);
+   atomic_thread_fence(memory_order_acquire);
+   if (atomic_load_explicit(&s->seq, memory_order_relaxed) != seq || hdr->index != n)
+      return -1;
+   return 0;
+}
+
+/* Consistent copy of the skew statistics */
+static inline void multicam_stats(const struct multicam_ring *r, struct multicam_skew *st)
+{
+   uint32_t seq;
+
+   do {
+      while ((seq = atomic_load_explicit(&r->stats_seq, memory_order_acquire)) & 1)
+         ;
+      memcpy(st, &r->stats, sizeof(*st));
+      atomic_thread_fence(memory_order_acquire);
+   } while (atomic_load_explicit(&r->stats_seq, memory_order_relaxed) != seq);
+}
+
+#endif /* MULTICAM_RING_H */
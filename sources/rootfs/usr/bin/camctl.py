@@ -0,0 +1,213 @@
+"""camctl.py — Python bindings of libcamctl (sources/camctl).
+
+One Camctl object keeps the control channel of a Dione or Microlynx camera
+open.  The I2C is paced by the readiness of the camera rather than fixed
+sleeps, and read_regs()/write_regs()/batch() run several registers per call:
+Dione register messages are grouped in one I2C transfer, GenCP requests are
+kept in flight and matched on their request ID.
+
+Types:
+    dione          Dione register protocol on /dev/i2c-<bus>
+    dione-gencp    Dione GenCP on /dev/i2c-<bus>
+    microlynx-i2c  Microlynx GenCP on /dev/i2c-<bus>, without the kernel module
+    microlynx      microlynx kernel chardev (/dev/microlynx-<bus>-<addr>)
+
+Example:
+    import camctl
+
+    with camctl.Camctl('dione', bus=9, addr=0x5b, depth=4) as cam:
+        width, height = cam.read_regs([0x20001004, 0x20001008])
+        cam.write_reg32(0x00080118, 33333)
+        print(cam.stats())
+
+    # Registers/s for several depths
+    camctl.Camctl('microlynx').bench(0x50FF0000, 1000, [1, 4, 16])
+"""
+
+import ctypes
+import errno
+import os
+import struct
+import time
+
+TYPES = {
+    'dione':         0,
+    'dione-gencp':   1,
+    'microlynx-i2c': 2,
+    'microlynx':     3,
+}
+
+MAX_DEPTH = 32
+
+
+class _Op(ctypes.Structure):
+    _fields_ = [('addr', ctypes.c_uint32),
+                ('val', ctypes.c_uint32),
+                ('write', ctypes.c_int),
+                ('status', ctypes.c_int)]
+
+
+class _Stats(ctypes.Structure):
+    _fields_ = [('ops', ctypes.c_uint64),
+                ('transactions', ctypes.c_uint64),
+                ('retries', ctypes.c_uint64),
+                ('errors', ctypes.c_uint64),
+                ('wait_us', ctypes.c_double),
+                ('us_per_op', ctypes.c_double)]
+
+
+_lib = None
+
+
+def _load():
+    global _lib
+    if _lib is None:
+        lib = ctypes.CDLL('libcamctl.so')
+        lib.camctl_open.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_int,
+                                    ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+        lib.camctl_close.argtypes = [ctypes.c_void_p]
+        lib.camctl_close.restype = None
+        lib.camctl_set_depth.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+        lib.camctl_set_timeout.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+        lib.camctl_set_timeout.restype = None
+        lib.camctl_batch.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Op), ctypes.c_uint]
+        lib.camctl_read_buf.argtypes = [ctypes.c_void_p, ctypes.c_uint32,
+                                        ctypes.c_char_p, ctypes.c_size_t]
+        lib.camctl_write_buf.argtypes = [ctypes.c_void_p, ctypes.c_uint32,
+                                         ctypes.c_char_p, ctypes.c_size_t]
+        lib.camctl_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Stats)]
+        lib.camctl_get_stats.restype = None
+        lib.camctl_reset_stats.argtypes = [ctypes.c_void_p]
+        lib.camctl_reset_stats.restype = None
+        _lib = lib
+    return _lib
+
+
+def available():
+    """True when libcamctl.so can be loaded."""
+    try:
+        _load()
+        return True
+    except OSError:
+        return False
+
+
+def _check(status, what):
+    if status < 0:
+        raise OSError(-status, f"{what}: {os.strerror(-status)}")
+    if status > 0:
+        raise OSError(errno.EIO, f"{what}: GenCP status 0x{status:04X}")
+
+
+class Camctl(object):
+
+    def __init__(self, type='microlynx', path=None, bus=9, addr=None, depth=1, timeout_ms=0):
+        """Open the camera, see the module doc for <type>.
+
+        <addr> defaults to 0x5b for Dione and 0x51 for Microlynx.
+        """
+        self._h = None
+        lib = _load()
+        if addr is None:
+            addr = 0x5b if type.startswith('dione') else 0x51
+        h = ctypes.c_void_p()
+        ret = lib.camctl_open(ctypes.byref(h), TYPES[type],
+                              path.encode() if path else None, bus, addr)
+        _check(ret, f"camctl open {type}")
+        self._h = h
+        self.type = type
+        self.set_depth(depth)
+        lib.camctl_set_timeout(self._h, timeout_ms)
+
+    def close(self):
+        if self._h:
+            _lib.camctl_close(self._h)
+            self._h = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def set_depth(self, depth):
+        """Operations per I2C transfer or GenCP requests in flight."""
+        _check(_lib.camctl_set_depth(self._h, depth), f"depth {depth}")
+
+    def batch(self, ops):
+        """Run [(addr, val or None)...]: None reads, a value writes.
+
+        Returns the values, those written for the writes.
+        """
+        arr = (_Op * len(ops))()
+        for op, (addr, val) in zip(arr, ops):
+            op.addr = addr
+            op.write = val is not None
+            op.val = (val or 0) & 0xFFFFFFFF
+        ret = _lib.camctl_batch(self._h, arr, len(ops))
+        if ret:
+            index = next(i for i, op in enumerate(arr) if op.status)
+            _check(ret, f"register 0x{arr[index].addr:08X} (operation {index})")
+        return [op.val for op in arr]
+
+    def read_regs(self, addrs):
+        return self.batch([(a, None) for a in addrs])
+
+    def write_regs(self, pairs):
+        """Write [(addr, val)...]."""
+        self.batch(list(pairs))
+
+    def read_reg32(self, addr):
+        return self.read_regs([addr])[0]
+
+    def write_reg32(self, addr, val):
+        self.batch([(addr, val)])
+
+    def read_reg32f(self, addr):
+        return struct.unpack('<f', struct.pack('<I', self.read_reg32(addr)))[0]
+
+    def write_reg32f(self, addr, fval):
+        self.write_reg32(addr, struct.unpack('<I', struct.pack('<f', float(fval)))[0])
+
+    def read_buf(self, addr, length):
+        buf = ctypes.create_string_buffer(length)
+        _check(_lib.camctl_read_buf(self._h, addr, buf, length), f"buffer 0x{addr:08X}")
+        return buf.raw
+
+    def write_buf(self, addr, data):
+        data = bytes(data)
+        _check(_lib.camctl_write_buf(self._h, addr, data, len(data)), f"buffer 0x{addr:08X}")
+
+    def stats(self):
+        st = _Stats()
+        _lib.camctl_get_stats(self._h, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in _Stats._fields_}
+
+    def reset_stats(self):
+        _lib.camctl_reset_stats(self._h)
+
+    def bench(self, addr, count=1000, depths=(1, 4, 16), write=False):
+        """Read (and write back with <write>) <addr> <count> times per depth.
+
+        Prints and returns {depth: registers/s}.
+        """
+        results = {}
+        val = self.read_reg32(addr)
+        for depth in depths:
+            self.set_depth(depth)
+            self.reset_stats()
+            start = time.monotonic()
+            done = 0
+            while done < count:
+                n = min(depth, count - done)
+                self.batch([(addr, val if write and i & 1 else None) for i in range(n)])
+                done += n
+            rate = count / (time.monotonic() - start)
+            st = self.stats()
+            print(f"depth {depth:2}: {rate:8.0f} regs/s  {st['us_per_op']:7.1f} us/reg  "
+                  f"{st['transactions']:6} transfers  {st['retries']:5} not ready")
+            results[depth] = rate
+        return results
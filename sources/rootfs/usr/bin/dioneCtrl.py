@@ -37,9 +37,16 @@ Constructor Parameters
     com_device   : str   (default: "COM0") - Serial port (Windows only, e.g., "COM20")
     device_type  : str   (default: "I2C")  - Communication type: "I2C" or "USB"
     gencp_enable : bool  (default: False)  - Enable GenCP protocol
+    native       : bool  (default: True)   - Use libcamctl when installed (I2C only)
 
 Note: On Windows, device_type is automatically set to "USB".
 
+With native, the registers are accessed through camctl.py/libcamctl: the I2C
+stays open, is paced by the readiness of the camera instead of 10 ms sleeps
+and write_regs() runs up to <depth> registers in one I2C transfer (default 1,
+reads and writes that trigger an action, such as FileOperationExecute, are
+always one transfer each) or several GenCP requests in flight.
+
 Register Access Methods
 -----------------------
 
@@ -55,6 +62,23 @@ Writing Registers:
     write_reg32f(reg_addr, val) Write a 32-bit float
     write_buf(reg_addr, buf)    Write a byte buffer
 
+Batches (one I2C transfer per <depth> written registers with native):
+
+    read_regs(addrs)            Read several 32-bit integers
+    write_regs(pairs)           Write [(reg_addr, val)...]
+    native.bench(reg_addr)      Registers/s for batch depths 1, 4 and 16
+
+File Transfers
+--------------
+
+    save_file(idx, dst)         Read Dione file <idx> to <dst>, 4 KB per step
+    update_file(idx, src)       Write <src> to Dione file <idx>, 4 KB per step
+
+    chnod_save_file(idx, dst)   Same, done by the dione_ir driver through its
+    chnod_update_file(idx, src) chnod (/dev/dione_ir-i2c-*): batched I2C, no
+                                sleeps, CRC-32 verify instead of a read-back
+                                per chunk, progress printed while running
+
 Examples
 --------
     # Read image width
@@ -138,10 +162,20 @@ import time
 import serial
 import numpy as np
 import ctypes
+try:
+    import camctl
+except ImportError:
+    camctl = None
 
 IOCTL_I2C_SLAVE=0x0703
 IOCTL_I2C_TIMEOUT=0x0702
 
+# dione_ir chnod file transfers, see dione-ir/dioneir_ioctl.h
+DIONE_IR_FILE_XFER_FMT='<QIIIIIIII'
+DIONE_IR_FILE_WRITE=(3 << 30) | (struct.calcsize(DIONE_IR_FILE_XFER_FMT) << 16) | (ord('d') << 8) | 0x10
+DIONE_IR_FILE_READ=(3 << 30) | (struct.calcsize(DIONE_IR_FILE_XFER_FMT) << 16) | (ord('d') << 8) | 0x11
+DIONE_IR_FILE_VERIFY=1
+
 GencpStatus = {
                'GENCP_SUCCESS':0x0000,
                'GENCP_NOT_IMPLEMENTED':0x8001,
@@ -158,13 +192,19 @@ GencpStatus = {
 
 class dioneCtrl(object):
 
-  def __init__(self, bus=6, dev_addr=0x5a, com_device="COM0", device_type="I2C", gencp_enable=False):
+  def __init__(self, bus=6, dev_addr=0x5a, com_device="COM0", device_type="I2C", gencp_enable=False,
+               native=True, depth=1):
 
     self.device_type = device_type
     if (platform.system() == "Windows") :
         self.device_type = "USB"
 
-    if (self.device_type == "I2C") :
+    self.native = None
+    if native and self.device_type == "I2C" and camctl and camctl.available() :
+        self.native = camctl.Camctl('dione-gencp' if gencp_enable else 'dione',
+                                    bus=bus, addr=dev_addr, depth=depth)
+
+    if (self.device_type == "I2C" and not self.native) :
         self.fr=io.open("/dev/i2c-"+str(bus), "rb", buffering=0)
         self.fw=io.open("/dev/i2c-"+str(bus), "wb", buffering=0)
 
@@ -204,6 +244,9 @@ class dioneCtrl(object):
     return ret
 
   def read_reg32(self, reg_addr):
+    if self.native:
+        return self.native.read_reg32(reg_addr)
+
     self.open_device()
     time.sleep(0.01)
 
@@ -232,6 +275,9 @@ class dioneCtrl(object):
     return val[0]
 
   def read_reg32f(self, reg_addr):
+    if self.native:
+        return self.native.read_reg32f(reg_addr)
+
     self.open_device()
     time.sleep(0.01)
 
@@ -263,6 +309,10 @@ class dioneCtrl(object):
        return struct.unpack('!f', bytes.fromhex(f'{val[0]:x}'))[0]
 
   def write_reg32(self, reg_addr, val):
+    if self.native:
+        self.native.write_reg32(reg_addr, val)
+        return 'GENCP_SUCCESS' if self.gencp_enable else 10
+
     self.open_device()
     time.sleep(0.01)
 
@@ -287,6 +337,10 @@ class dioneCtrl(object):
     return ret
 
   def write_reg32f(self, reg_addr, val):
+    if self.native:
+        self.native.write_reg32f(reg_addr, val)
+        return 'GENCP_SUCCESS' if self.gencp_enable else 10
+
     self.open_device()
     time.sleep(0.01)
 
@@ -311,6 +365,26 @@ class dioneCtrl(object):
     return ret
 
 
+  def read_regs(self, reg_addrs):
+    """! reads the 32-bit registers of <reg_addrs>, in one batch with native
+    """
+
+    if self.native:
+        return self.native.read_regs(reg_addrs)
+    return [self.read_reg32(a) for a in reg_addrs]
+
+
+  def write_regs(self, pairs):
+    """! writes [(reg_addr, val)...], in one batch with native
+    """
+
+    if self.native:
+        self.native.write_regs(pairs)
+        return
+    for a, v in pairs:
+        self.write_reg32(a, v)
+
+
   def ack_stop(self):
     self.write_reg32(0x80104,2)
     print(hex(self.read_reg32(0x8010c)))
@@ -335,6 +409,9 @@ class dioneCtrl(object):
     """! reads <length> bytes from <reg_addr>
     """
 
+    if self.native:
+        return b'\x00\x00' + self.native.read_buf(reg_addr, length)
+
     self.open_device()
     time.sleep(0.01)
 
@@ -363,6 +440,10 @@ class dioneCtrl(object):
     """! writes <buf> to <reg_addr>
     """
 
+    if self.native:
+        self.native.write_buf(reg_addr, buf)
+        return
+
     self.open_device()
     time.sleep(0.01)
 
@@ -744,6 +825,109 @@ class dioneCtrl(object):
     print(f'Written {ofs} bytes')
 
 
+  def chnod_file_xfer(self, cmd, idx, buf, ofs, length, flags, chnod=None):
+    """! transfer a Dione file with the dione_ir driver chnod ioctls
+
+    @param cmd      DIONE_IR_FILE_WRITE or DIONE_IR_FILE_READ
+    @param buf      bytearray, data to write or read into
+    @param chnod    optional - /dev/dione_ir-i2c-* (default: the first one)
+
+    returns the (crc32, verify_crc32, file_size, transferred) tuple, or
+    raises OSError. Progress is printed from sysfs while the ioctl runs.
+    """
+
+    import glob, threading
+
+    if chnod is None:
+      nodes = sorted(glob.glob('/dev/dione_ir-i2c-*'))
+      if not nodes:
+        raise OSError('No dione_ir chnod')
+      chnod = nodes[0]
+    name = os.path.basename(chnod)
+    progress = f'/sys/class/{name}/{name}/file_progress'
+
+    data = (ctypes.c_char * max(len(buf), 1)).from_buffer(buf) if len(buf) else None
+    addr = ctypes.addressof(data) if data is not None else 0
+    arg = bytearray(struct.pack(DIONE_IR_FILE_XFER_FMT, addr, idx, ofs, length, flags,
+                                0, 0, 0, 0))
+
+    done = threading.Event()
+    def show_progress():
+      while not done.wait(0.5):
+        try:
+          with open(progress) as f:
+            cur, total = [int(v) for v in f.read().split()]
+          if total:
+            print( f'\r{cur}/{total} bytes ({100 * cur // total}%)', end='', flush=True)
+        except (OSError, ValueError):
+          pass
+
+    t = threading.Thread(target=show_progress, daemon=True)
+    t.start()
+    fd = os.open(chnod, os.O_RDWR)
+    try:
+      fcntl.ioctl(fd, cmd, arg)
+    finally:
+      os.close(fd)
+      done.set()
+      t.join()
+      print()
+      del data
+
+    crc, verify_crc, size, transferred = struct.unpack(DIONE_IR_FILE_XFER_FMT, arg)[5:]
+    return crc, verify_crc, size, transferred
+
+
+  def chnod_save_file(self, idx, dst, max_len=0, ofs=0, chnod=None):
+    """! save Dione file no. <idx> to <dst>, through the driver
+
+    @param max_len  optional - no. of bytes, 0 up to the end of the file
+    """
+
+    import zlib
+
+    length = max_len
+    if length == 0:
+      # The driver reads up to the end of the file, size it first
+      crc, verify_crc, size, transferred = self.chnod_file_xfer(DIONE_IR_FILE_READ, idx,
+                                                                 bytearray(), ofs, 0, 0, chnod)
+      length = max(size - ofs, 0)
+    buf = bytearray(length)
+    crc, verify_crc, size, transferred = self.chnod_file_xfer(DIONE_IR_FILE_READ, idx,
+                                                               buf, ofs, length, 0, chnod)
+    if zlib.crc32(buf[:transferred]) != crc:
+      print( 'CRC error' )
+      return -1
+    with io.open(dst, "wb") as f_dst:
+      f_dst.write(buf[:transferred])
+    print( f'Saved {transferred} bytes, crc32 {crc:#010x}' )
+    return transferred
+
+
+  def chnod_update_file(self, idx, src, verify=True, chnod=None):
+    """! update Dione file no. <idx> with <src>, through the driver
+
+    @param verify  optional - read back in the driver and compare CRC-32
+    """
+
+    import zlib
+
+    with io.open(src, "rb") as f_src:
+      buf = bytearray(f_src.read())
+    flags = DIONE_IR_FILE_VERIFY if verify else 0
+    try:
+      crc, verify_crc, size, transferred = self.chnod_file_xfer(DIONE_IR_FILE_WRITE, idx,
+                                                                 buf, 0, len(buf), flags, chnod)
+    except OSError as e:
+      print( f'Update failed: {e}' )
+      return -1
+    if crc != zlib.crc32(buf):
+      print( 'CRC error' )
+      return -1
+    print( f'Updated {transferred} bytes, crc32 {crc:#010x}' + (' (verified)' if verify else '') )
+    return transferred
+
+
   def ComputeCrc(self, Data, ScdDataNumber):
     ComputedCrc_u32 = np.uint32(0)
     test = 0
@@ -1,24 +1,12 @@
 #!/bin/bash
-
-media=$(v4l2-ctl --list-devices | egrep "rp1-cfe.*1f00128000" -A 20 | grep -m1 /dev/media)
-if [[ x$media != x ]]
-then
-   echo media = $media
-   fmt_line=$(media-ctl -p -d $media | awk '/subtype Sensor/{f=1} f && /\[.*fmt:/{print; exit}')
-   echo fmt = $fmt_line
-
-   # Extract only the mbus format code (e.g. Y16_1X16/640x480).
-   # media-ctl -p output includes "stream:N " and "colorspace:..." since kernel 6.12.47,
-   # but media-ctl -V does not accept those attributes inside the brackets.
-   fmt_code=$(echo "$fmt_line" | grep -oP '(?<=fmt:)[^ ]+')
-   fmt="[fmt:${fmt_code} field:none]"
-
-   media-ctl -d $media -l '"csi2":4 -> "rp1-cfe-csi2_ch0":0 [1]'
-   media-ctl -d $media -V '"csi2":0 '"$fmt"
-   media-ctl -d $media -V '"csi2":4 '"$fmt"
-
-   media-ctl -p -d $media
-
-   #media-ctl -d $media --print-dot >config.dot
-   #dot -Tpng config.dot -o config.png
-fi
+# Usage: eg_media_configure_rp1_cfe.sh [comp1|fe]
+#   comp1: capture the mono 14/16-bit formats PISP_COMP1 compressed (PC1M,
+#          8 bits per pixel) on rp1-cfe-csi2_ch0, decompress with libexoy16
+#   fe:    capture through the PiSP front end, Y16 on rp1-cfe-fe_image0 and
+#          the histogram of each frame on rp1-cfe-fe_stats (fe-agc)
+#
+# Kept for the existing command lines: the cameras of both CFEs are
+# configured by eg-media-config (sources/media-config), from the profiles of
+# /etc/eg-media-config.conf without argument.
+
+exec eg-media-config -v ${1:+-m $1}
@@ -6,12 +6,21 @@ The microlynx kernel driver exposes a chardev at /dev/microlynx-<bus>-<addr>
 GENCPCLIENT_ReadRegister, GENCPCLIENT_WriteRegister and GENCPCLIENT_ReadString
 from userspace without any I2C_SLAVE_FORCE tricks.
 
+When the microlynxd daemon is running, its socket
+(/run/microlynxd-<device>.sock) is used instead: the control channel stays
+open, static registers are cached and several registers can be accessed in
+one request.
+
+The chardev stays open between calls.  When libcamctl is installed (see
+camctl.py) it is used for the chardev, and "bench" reports registers/s.
+
 Usage:
     microlynxCtrl.py [DEVICE] COMMAND [ARGS...]
 
 DEVICE (optional):
-    Path to the GenCP chardev.
-    Default: first /dev/microlynx-* device found automatically.
+    Path to the GenCP chardev or to a microlynxd socket.
+    Default: first /run/microlynxd-*.sock socket, else first /dev/microlynx-*
+    device found automatically.
 
 Commands:
     read_reg32  ADDR              Read a 32-bit register (hex + decimal output)
@@ -19,6 +28,9 @@ Commands:
     write_reg32  ADDR VAL         Write a 32-bit register (integer value)
     write_reg32f ADDR VAL         Write a 32-bit register (float value)
     read_string  ADDR [LENGTH]    Read a GenCP string register (default LENGTH=64)
+    read_regs    ADDR [ADDR...]   Read several 32-bit registers in one request
+    bench        [ADDR] [COUNT]   Registers/s reading ADDR COUNT times
+                                  (default: firmware version, 1000)
 
     ADDR  register address, hex (0x...) or decimal
     VAL   value to write, hex (0x...) or decimal
@@ -45,16 +57,27 @@ Examples:
 
     # Read serial number
     microlynxCtrl.py read_string 0x00000144
+
+    # Firmware version, width and pixel format in one daemon request
+    microlynxCtrl.py read_regs 0x50FF0000 0x500E0008 0x500E0018
 """
 
 import fcntl
 import glob
 import os
+import socket
+import stat
 import struct
 import sys
+import time
+
+try:
+    import camctl
+except ImportError:
+    camctl = None
 
 # ---------------------------------------------------------------------------
-# IOCTL constants  (must match kernel definitions in microlynx_core.c)
+# IOCTL constants  (must match kernel definitions in microlynx_ioctl.h)
 #
 # Computed via the standard Linux _IOC macro on ARM64:
 #   _IOC(dir, type, nr, size) = (dir<<30) | (size<<16) | (type<<8) | nr
@@ -98,6 +121,9 @@ _STR_FMT = f'<II{MICROLYNX_STR_MAX}s'  # addr, len, buf
 # ---------------------------------------------------------------------------
 
 def _auto_detect():
+    sockets = sorted(glob.glob('/run/microlynxd-*.sock'))
+    if sockets:
+        return sockets[0]
     devices = sorted(glob.glob('/dev/microlynx-*'))
     if not devices:
         raise FileNotFoundError(
@@ -108,19 +134,71 @@ def _auto_detect():
     return devices[0]
 
 
+def _is_daemon(dev_path):
+    try:
+        return stat.S_ISSOCK(os.stat(dev_path).st_mode)
+    except OSError:
+        return False
+
+
+_daemon_conns = {}
+
+
+def _daemon_request(sock_path, line):
+    """Send one request line to microlynxd and return the response fields."""
+    conn = _daemon_conns.get(sock_path)
+    if conn is None:
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        s.connect(sock_path)
+        conn = s.makefile('rw', buffering=1)
+        _daemon_conns[sock_path] = conn
+    conn.write(line + '\n')
+    conn.flush()
+    fields = conn.readline().split()
+    if not fields:
+        del _daemon_conns[sock_path]
+        raise OSError(f"microlynxd closed the connection ({sock_path})")
+    if fields[0] != 'ok':
+        raise OSError(f"microlynxd: request '{line}' failed, status "
+                      f"{' '.join(fields[1:])}")
+    return fields[1:]
+
+
+_chardev_files = {}
+_native = {}
+
+
+def _chardev(dev_path):
+    """The chardev, opened once per process."""
+    f = _chardev_files.get(dev_path)
+    if f is None:
+        f = open(dev_path, 'rb+', buffering=0)
+        _chardev_files[dev_path] = f
+    return f
+
+
+def _native_handle(dev_path):
+    """libcamctl handle of the chardev, None without the library."""
+    if camctl is None or not camctl.available():
+        return None
+    h = _native.get(dev_path)
+    if h is None:
+        h = camctl.Camctl('microlynx', path=dev_path)
+        _native[dev_path] = h
+    return h
+
+
 def _ioctl_rw(dev_path, ioctl_code, fmt, *pack_args):
     """Pack args into a bytearray, call ioctl (mutates buf in-place), unpack result."""
     buf = bytearray(struct.pack(fmt, *pack_args))
-    with open(dev_path, 'rb+', buffering=0) as f:
-        fcntl.ioctl(f.fileno(), ioctl_code, buf)  # returns int; buf is mutated
+    fcntl.ioctl(_chardev(dev_path).fileno(), ioctl_code, buf)  # returns int; buf is mutated
     return struct.unpack(fmt, buf)
 
 
 def _ioctl_w(dev_path, ioctl_code, fmt, *pack_args):
     """Pack args into a bytearray and call a write-only ioctl (no result needed)."""
     buf = bytearray(struct.pack(fmt, *pack_args))
-    with open(dev_path, 'rb+', buffering=0) as f:
-        fcntl.ioctl(f.fileno(), ioctl_code, buf)
+    fcntl.ioctl(_chardev(dev_path).fileno(), ioctl_code, buf)
 
 
 # ---------------------------------------------------------------------------
@@ -129,8 +207,26 @@ def _ioctl_w(dev_path, ioctl_code, fmt, *pack_args):
 
 def read_reg32(dev_path, addr):
     """Read a 32-bit GenCP register.  Returns the integer value."""
-    _, val = _ioctl_rw(dev_path, MICROLYNX_IOCTL_READ_REG, _REG_FMT, addr, 0)
-    return val
+    return read_regs(dev_path, [addr])[0]
+
+
+def read_regs(dev_path, addrs):
+    """Read several 32-bit GenCP registers.  Returns a list of integers.
+
+    Through microlynxd this is a single request; with the chardev it is one
+    ioctl per register.
+    """
+    if _is_daemon(dev_path):
+        vals = _daemon_request(dev_path, 'r ' + ' '.join(f'0x{a:x}' for a in addrs))
+        return [int(v, 0) for v in vals]
+    native = _native_handle(dev_path)
+    if native:
+        return native.read_regs(addrs)
+    vals = []
+    for addr in addrs:
+        _, val = _ioctl_rw(dev_path, MICROLYNX_IOCTL_READ_REG, _REG_FMT, addr, 0)
+        vals.append(val)
+    return vals
 
 
 def read_reg32f(dev_path, addr):
@@ -141,6 +237,13 @@ def read_reg32f(dev_path, addr):
 
 def write_reg32(dev_path, addr, val):
     """Write a 32-bit integer value to a GenCP register."""
+    if _is_daemon(dev_path):
+        _daemon_request(dev_path, f'w 0x{addr:x} 0x{val & 0xFFFFFFFF:x}')
+        return
+    native = _native_handle(dev_path)
+    if native:
+        native.write_reg32(addr, val)
+        return
     _ioctl_w(dev_path, MICROLYNX_IOCTL_WRITE_REG, _REG_FMT, addr, val & 0xFFFFFFFF)
 
 
@@ -153,16 +256,32 @@ def write_reg32f(dev_path, addr, fval):
 def read_string(dev_path, addr, length=64):
     """Read a GenCP string register.  Returns a decoded ASCII string."""
     length = min(int(length), MICROLYNX_STR_MAX)
-    _, _, raw = _ioctl_rw(
-        dev_path, MICROLYNX_IOCTL_READ_STR, _STR_FMT,
-        addr, length, b'\x00' * MICROLYNX_STR_MAX
-    )
+    if _is_daemon(dev_path):
+        raw = bytes.fromhex(_daemon_request(dev_path, f's 0x{addr:x} {length}')[0])
+    else:
+        _, _, raw = _ioctl_rw(
+            dev_path, MICROLYNX_IOCTL_READ_STR, _STR_FMT,
+            addr, length, b'\x00' * MICROLYNX_STR_MAX
+        )
     # Strip padding: kernel GENCPCLIENT_ReadString may fill unused bytes with
     # 0xff (GenCP "unused" marker) or leave them as 0x00.
     s = raw[:length].rstrip(b'\xff').rstrip(b'\x00')
     return s.decode('ascii', errors='replace')
 
 
+def bench(dev_path, addr=0x50FF0000, count=1000):
+    """Read <addr> <count> times, print and return the registers/s."""
+    native = None if _is_daemon(dev_path) else _native_handle(dev_path)
+    if native:
+        return native.bench(addr, count, [1])[1]
+    start = time.monotonic()
+    for _ in range(count):
+        read_reg32(dev_path, addr)
+    rate = count / (time.monotonic() - start)
+    print(f"{rate:.0f} regs/s  {1e6 / rate:.1f} us/reg")
+    return rate
+
+
 # ---------------------------------------------------------------------------
 # CLI
 # ---------------------------------------------------------------------------
@@ -171,7 +290,8 @@ def main():
     args = sys.argv[1:]
 
     # First argument may be an explicit device path
-    if args and (args[0].startswith('/dev/') or args[0].startswith('microlynx')):
+    if args and (args[0].startswith('/dev/') or args[0].startswith('/run/')
+                 or args[0].startswith('microlynx')):
         dev_path = args[0]
         args = args[1:]
     else:
@@ -227,6 +347,18 @@ def main():
             s = read_string(dev_path, addr, length)
             print(f"0x{addr:08X} = '{s}'")
 
+        elif cmd == 'read_regs':
+            if len(cmd_args) < 1:
+                raise ValueError("read_regs requires ADDR [ADDR...]")
+            addrs = [int(a, 0) for a in cmd_args]
+            for addr, val in zip(addrs, read_regs(dev_path, addrs)):
+                print(f"0x{addr:08X} = 0x{val:08X}  ({val})")
+
+        elif cmd == 'bench':
+            addr  = int(cmd_args[0], 0) if len(cmd_args) > 0 else 0x50FF0000
+            count = int(cmd_args[1], 0) if len(cmd_args) > 1 else 1000
+            bench(dev_path, addr, count)
+
         else:
             print(f"Unknown command: {cmd!r}", file=sys.stderr)
             print(__doc__)
@@ -0,0 +1,1211 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * thermal-be - Y16 thermal frames tone mapped and scaled by the PiSP back end.
+ *
+ * Frames captured by the CFE (Y16, or PISP_COMP1 from the CFE compression)
+ * are handed as DMABUFs to a pispbe node group, memory to memory. The back
+ * end maps the 16-bit range lo..hi to 8 bits with a gamma curve, downscales
+ * and writes YUV420 (I420), ready for an H.264 encoder (x264enc on the Pi 5,
+ * which has no hardware encoder). The CPU doesn't touch the pixels.
+ *
+ * -m cpu does the same on the CPU (libexoy16 for PISP_COMP1, 64K entry LUT,
+ * nearest neighbour scaling) and -m both runs both paths one after the other
+ * and reports the CPU and latency saved per stream. Without a camera
+ * (-d none) a synthetic frame measures the conversion alone.
+ *
+ * -c FILE only writes the pispbe-config buffer (struct pisp_be_tiles_config)
+ * for the given sizes.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <linux/media.h>
+#include <linux/videodev2.h>
+
+#include "thermal_be_config.h"
+#include "y16conv.h"
+
+#ifndef V4L2_PIX_FMT_PISP_COMP1_MONO
+#define V4L2_PIX_FMT_PISP_COMP1_MONO v4l2_fourcc('P', 'C', '1', 'M')
+#endif
+
+#define MAX_BUFFERS    16
+#define OUT_BUFFERS    4
+#define CFG_BUFFERS    4
+#define SYNTH_BUFFERS  4
+
+struct capture {
+   int      fd;                 /* -1: synthetic input */
+   unsigned nbufs;
+   int      dmabuf[MAX_BUFFERS];
+   void    *map[MAX_BUFFERS];
+   size_t   len[MAX_BUFFERS];
+   struct v4l2_pix_format pix;
+   unsigned fe_version;
+};
+
+struct backend {
+   int      input_fd, output_fd, config_fd;
+   unsigned version;
+   int      in_memory;          /* V4L2_MEMORY_DMABUF from the capture, MMAP synthetic */
+   unsigned in_nbufs;
+   void    *in_map[SYNTH_BUFFERS];
+   size_t   in_len[SYNTH_BUFFERS];
+   void    *out_map[OUT_BUFFERS];
+   size_t   out_len[OUT_BUFFERS];
+   void    *cfg_map[CFG_BUFFERS];
+   size_t   cfg_len[CFG_BUFFERS];
+   struct v4l2_pix_format_mplane out;
+};
+
+struct stats {
+   unsigned frames;
+   unsigned dropped;            /* Capture sequence gaps, or no free back end job */
+   double   latency_sum_ms;
+   double   latency_max_ms;
+   double   fps;
+   double   cpu_pct;
+};
+
+/* Start times of the jobs in flight, the back end completes them in order */
+struct fifo {
+   double   ts[MAX_BUFFERS];
+   unsigned head, count;
+};
+
+struct options {
+   const char *video;
+   const char *output;
+   unsigned    out_width, out_height;
+   unsigned    synth_width, synth_height;
+   uint32_t    synth_fourcc;
+   unsigned    comp_mode, comp_offset;
+   int         lo, hi;
+   float       gamma;
+   int         seconds;
+   int         group;
+};
+
+static volatile sig_atomic_t quit;
+
+/* Reports, on stderr when the frames go to stdout */
+static FILE *info;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+static double mono_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static double cpu_s(void)
+{
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+   return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+          (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static int is_compressed(const struct capture *cap)
+{
+   return cap->pix.pixelformat == V4L2_PIX_FMT_PISP_COMP1_MONO;
+}
+
+static void fifo_push(struct fifo *f, double ts)
+{
+   f->ts[(f->head + f->count++) % MAX_BUFFERS] = ts;
+}
+
+static double fifo_pop(struct fifo *f)
+{
+   double ts = f->ts[f->head];
+
+   f->head = (f->head + 1) % MAX_BUFFERS;
+   f->count--;
+   return ts;
+}
+
+static void account(struct stats *st, double start_ms)
+{
+   double latency = mono_ms() - start_ms;
+
+   st->frames++;
+   st->latency_sum_ms += latency;
+   if (latency > st->latency_max_ms)
+      st->latency_max_ms = latency;
+}
+
+static int stream(int fd, enum v4l2_buf_type type, int on)
+{
+   return xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type);
+}
+
+/* ---- Media graph ------------------------------------------------------ */
+
+/* /dev path of the character device @major:@minor */
+static int devnode_path(unsigned major, unsigned minor, char *path, size_t len)
+{
+   char uevent[64], line[128];
+   int ret = -ENOENT;
+   FILE *f;
+
+   snprintf(uevent, sizeof(uevent), "/sys/dev/char/%u:%u/uevent", major, minor);
+   f = fopen(uevent, "r");
+   if (!f)
+      return -errno;
+   while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, "DEVNAME=", 8)) {
+         line[strcspn(line, "\n")] = 0;
+         snprintf(path, len, "/dev/%s", line + 8);
+         ret = 0;
+         break;
+      }
+   }
+   fclose(f);
+   return ret;
+}
+
+/* Video node of the entity @name of the media device @fd */
+static int media_video_node(int fd, const char *name, char *path, size_t len)
+{
+   struct media_v2_topology topo = { 0 };
+   struct media_v2_entity *ents = NULL;
+   struct media_v2_interface *ifaces = NULL;
+   struct media_v2_link *links = NULL;
+   uint32_t ent_id = 0;
+   unsigned i, j;
+   int ret;
+
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &topo);
+   if (ret)
+      return ret;
+   ents = calloc(topo.num_entities, sizeof(*ents));
+   ifaces = calloc(topo.num_interfaces, sizeof(*ifaces));
+   links = calloc(topo.num_links, sizeof(*links));
+   if (!ents || !ifaces || !links) {
+      ret = -ENOMEM;
+      goto out;
+   }
+   topo.ptr_entities = (uintptr_t)ents;
+   topo.ptr_interfaces = (uintptr_t)ifaces;
+   topo.ptr_links = (uintptr_t)links;
+   ret = xioctl(fd, MEDIA_IOC_G_TOPOLOGY, &topo);
+   if (ret)
+      goto out;
+
+   ret = -ENOENT;
+   for (i = 0; i < topo.num_entities && !ent_id; i++)
+      if (!strcmp(ents[i].name, name))
+         ent_id = ents[i].id;
+   for (i = 0; i < topo.num_links && ent_id; i++) {
+      if ((links[i].flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_INTERFACE_LINK ||
+          links[i].sink_id != ent_id)
+         continue;
+      for (j = 0; j < topo.num_interfaces; j++)
+         if (ifaces[j].id == links[i].source_id) {
+            ret = devnode_path(ifaces[j].devnode.major, ifaces[j].devnode.minor,
+                               path, len);
+            goto out;
+         }
+   }
+
+out:
+   free(ents);
+   free(ifaces);
+   free(links);
+   return ret;
+}
+
+/* Media device @index (among those of @model), its hw_revision in @version */
+static int media_open(const char *model, int index, unsigned *version)
+{
+   char path[32];
+   int i, fd;
+
+   for (i = 0; i < 64; i++) {
+      struct media_device_info info;
+
+      snprintf(path, sizeof(path), "/dev/media%d", i);
+      fd = open(path, O_RDWR | O_CLOEXEC);
+      if (fd < 0)
+         continue;
+      if (!xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info) && !strcmp(info.model, model) &&
+          index-- == 0) {
+         *version = info.hw_revision;
+         return fd;
+      }
+      close(fd);
+   }
+   return -ENODEV;
+}
+
+/* hw_revision of the media device of the video node @video (the CFE) */
+static unsigned video_media_version(const char *video)
+{
+   const char *base = strrchr(video, '/');
+   struct media_device_info info;
+   unsigned version = 0;
+   char pattern[128];
+   glob_t g;
+   int fd;
+
+   snprintf(pattern, sizeof(pattern), "/sys/class/video4linux/%s/device/media*",
+            base ? base + 1 : video);
+   if (glob(pattern, 0, NULL, &g))
+      return 0;
+   snprintf(pattern, sizeof(pattern), "/dev/%s", strrchr(g.gl_pathv[0], '/') + 1);
+   globfree(&g);
+
+   fd = open(pattern, O_RDWR | O_CLOEXEC);
+   if (fd < 0)
+      return 0;
+   if (!xioctl(fd, MEDIA_IOC_DEVICE_INFO, &info))
+      version = info.hw_revision;
+   close(fd);
+   return version;
+}
+
+/* ---- Capture ---------------------------------------------------------- */
+
+static int capture_open(struct capture *cap, const char *dev)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_requestbuffers req = {
+      .count = 6,
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   unsigned i;
+   int ret;
+
+   cap->fd = open(dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (cap->fd < 0)
+      return -errno;
+   ret = xioctl(cap->fd, VIDIOC_G_FMT, &fmt);
+   if (ret)
+      return ret;
+   if (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_Y16 &&
+       fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_PISP_COMP1_MONO)
+      return -EINVAL;
+   cap->pix = fmt.fmt.pix;
+   cap->fe_version = video_media_version(dev);
+
+   ret = xioctl(cap->fd, VIDIOC_REQBUFS, &req);
+   if (ret)
+      return ret;
+   cap->nbufs = req.count < MAX_BUFFERS ? req.count : MAX_BUFFERS;
+
+   /* Exported for the back end, mapped for the first frame and -m cpu */
+   for (i = 0; i < cap->nbufs; i++) {
+      struct v4l2_exportbuffer exp = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .index = i,
+         .flags = O_RDWR | O_CLOEXEC,
+      };
+      struct v4l2_buffer buf = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .memory = V4L2_MEMORY_MMAP,
+         .index = i,
+      };
+
+      ret = xioctl(cap->fd, VIDIOC_EXPBUF, &exp);
+      if (ret)
+         return ret;
+      cap->dmabuf[i] = exp.fd;
+      ret = xioctl(cap->fd, VIDIOC_QUERYBUF, &buf);
+      if (ret)
+         return ret;
+      cap->map[i] = mmap(NULL, buf.length, PROT_READ, MAP_SHARED, cap->fd, buf.m.offset);
+      if (cap->map[i] == MAP_FAILED)
+         return -errno;
+      cap->len[i] = buf.length;
+   }
+   return 0;
+}
+
+/* Synthetic input: a horizontal ramp with a warm spot, compressed or not */
+static int synth_open(struct capture *cap, const struct options *o)
+{
+   uint16_t *line;
+   unsigned x, y;
+
+   cap->fd = -1;
+   cap->nbufs = 1;
+   cap->pix.width = o->synth_width;
+   cap->pix.height = o->synth_height;
+   cap->pix.pixelformat = o->synth_fourcc;
+   /* rp1-cfe line alignment */
+   cap->pix.bytesperline = (o->synth_width * (is_compressed(cap) ? 1 : 2) + 15) & ~15u;
+   cap->pix.sizeimage = cap->pix.bytesperline * o->synth_height;
+   cap->len[0] = cap->pix.sizeimage;
+   cap->map[0] = calloc(1, cap->len[0]);
+   line = malloc(o->synth_width * 2);
+   if (!cap->map[0] || !line)
+      return -ENOMEM;
+
+   for (y = 0; y < o->synth_height; y++) {
+      uint8_t *dst = (uint8_t *)cap->map[0] + y * cap->pix.bytesperline;
+
+      for (x = 0; x < o->synth_width; x++) {
+         int dx = x - o->synth_width / 2, dy = y - o->synth_height / 2;
+
+         line[x] = 20000 + x * 8000 / o->synth_width +
+                   (dx * dx + dy * dy < 2500 ? 6000 : 0);
+      }
+      if (is_compressed(cap)) {
+         /* Not a PISP_COMP1 encoder: the bytes only need to be valid blocks */
+         for (x = 0; x < o->synth_width; x++)
+            dst[x] = line[x] >> 8;
+      } else {
+         memcpy(dst, line, o->synth_width * 2);
+      }
+   }
+   free(line);
+   return 0;
+}
+
+static int capture_queue(struct capture *cap, unsigned index)
+{
+   struct v4l2_buffer buf = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = index,
+   };
+
+   return xioctl(cap->fd, VIDIOC_QBUF, &buf);
+}
+
+static int capture_start(struct capture *cap)
+{
+   unsigned i;
+
+   for (i = 0; i < cap->nbufs; i++)
+      capture_queue(cap, i);
+   return stream(cap->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+}
+
+/* Capture one frame, index in @index, -errno on timeout */
+static int capture_wait(struct capture *cap, struct v4l2_buffer *buf, int timeout_ms)
+{
+   struct pollfd pfd = { .fd = cap->fd, .events = POLLIN };
+
+   if (poll(&pfd, 1, timeout_ms) <= 0)
+      return -ETIMEDOUT;
+   memset(buf, 0, sizeof(*buf));
+   buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+   buf->memory = V4L2_MEMORY_MMAP;
+   return xioctl(cap->fd, VIDIOC_DQBUF, buf);
+}
+
+static double buf_ts_ms(const struct v4l2_buffer *buf)
+{
+   return buf->timestamp.tv_sec * 1e3 + buf->timestamp.tv_usec * 1e-3;
+}
+
+/* Line @y of the frame in @map as 16-bit values, decoded into @tmp if needed */
+static const uint16_t *frame_line(const struct capture *cap, const void *map, unsigned y,
+                                  uint16_t *tmp, const struct options *o)
+{
+   const uint8_t *src = (const uint8_t *)map + y * cap->pix.bytesperline;
+
+   if (!is_compressed(cap))
+      return (const uint16_t *)src;
+   y16_comp1_decode(src, tmp, cap->pix.width, o->comp_mode, o->comp_offset);
+   return tmp;
+}
+
+/* Tone mapping window of the first frame, 1 to 99 % */
+static void auto_window(const struct capture *cap, const void *map, struct options *o)
+{
+   struct y16_agc *agc = malloc(sizeof(*agc));
+   uint16_t *tmp = malloc(cap->pix.width * 2);
+   uint8_t *dst = malloc(cap->pix.width);
+   unsigned y;
+
+   if (agc && tmp && dst) {
+      y16_agc_init(agc, 1, 99, 1);
+      for (y = 0; y < cap->pix.height; y++)
+         y16_agc_convert(agc, frame_line(cap, map, y, tmp, o), dst, cap->pix.width, 0);
+      y16_agc_update(agc);
+      if (o->lo < 0)
+         o->lo = agc->lo;
+      if (o->hi < 0)
+         o->hi = agc->hi;
+   }
+   if (o->lo < 0)
+      o->lo = 0;
+   if (o->hi <= o->lo)
+      o->hi = 65535;
+   free(agc);
+   free(tmp);
+   free(dst);
+}
+
+/* ---- Back end --------------------------------------------------------- */
+
+static void be_params(const struct capture *cap, const struct backend *be,
+                      const struct options *o, struct thermal_be_params *p)
+{
+   memset(p, 0, sizeof(*p));
+   p->width = cap->pix.width;
+   p->height = cap->pix.height;
+   p->stride = cap->pix.bytesperline;
+   p->compressed = is_compressed(cap);
+   p->comp_mode = o->comp_mode;
+   p->comp_offset = o->comp_offset;
+   p->out_width = o->out_width;
+   p->out_height = o->out_height;
+   p->out_stride = be->out.plane_fmt[0].bytesperline;
+   p->lo = o->lo;
+   p->hi = o->hi;
+   p->gamma = o->gamma;
+   p->fe_version = cap->fe_version;
+   p->be_version = be->version;
+}
+
+static int be_node(int media, const char *name, int *fd)
+{
+   char path[128];
+   int ret;
+
+   ret = media_video_node(media, name, path, sizeof(path));
+   if (ret)
+      return ret;
+   *fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   return *fd < 0 ? -errno : 0;
+}
+
+static int be_reqbufs(int fd, enum v4l2_buf_type type, enum v4l2_memory memory,
+                      unsigned count)
+{
+   struct v4l2_requestbuffers req = { .count = count, .type = type, .memory = memory };
+   int ret;
+
+   ret = xioctl(fd, VIDIOC_REQBUFS, &req);
+   if (!ret && req.count < count)
+      ret = -ENOMEM;
+   return ret;
+}
+
+/* Map buffer @index of @fd, one plane */
+static void *be_map(int fd, enum v4l2_buf_type type, unsigned index, size_t *len)
+{
+   struct v4l2_plane plane = { 0 };
+   struct v4l2_buffer buf = {
+      .type = type,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = index,
+   };
+   void *map;
+
+   if (V4L2_TYPE_IS_MULTIPLANAR(type)) {
+      buf.m.planes = &plane;
+      buf.length = 1;
+   }
+   if (xioctl(fd, VIDIOC_QUERYBUF, &buf))
+      return NULL;
+   *len = V4L2_TYPE_IS_MULTIPLANAR(type) ? plane.length : buf.length;
+   map = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+              V4L2_TYPE_IS_MULTIPLANAR(type) ? plane.m.mem_offset : buf.m.offset);
+   return map == MAP_FAILED ? NULL : map;
+}
+
+static int be_queue(int fd, enum v4l2_buf_type type, enum v4l2_memory memory,
+                    unsigned index, int dmabuf, size_t length, size_t bytesused)
+{
+   struct v4l2_plane plane = { .length = length, .bytesused = bytesused };
+   struct v4l2_buffer buf = {
+      .type = type,
+      .memory = memory,
+      .index = index,
+   };
+
+   if (V4L2_TYPE_IS_MULTIPLANAR(type)) {
+      if (memory == V4L2_MEMORY_DMABUF)
+         plane.m.fd = dmabuf;
+      buf.m.planes = &plane;
+      buf.length = 1;
+   } else {
+      buf.bytesused = bytesused;
+   }
+   return xioctl(fd, VIDIOC_QBUF, &buf);
+}
+
+static int be_dequeue(int fd, enum v4l2_buf_type type, enum v4l2_memory memory,
+                      unsigned *index)
+{
+   struct v4l2_plane plane = { 0 };
+   struct v4l2_buffer buf = { .type = type, .memory = memory };
+   int ret;
+
+   if (V4L2_TYPE_IS_MULTIPLANAR(type)) {
+      buf.m.planes = &plane;
+      buf.length = 1;
+   }
+   ret = xioctl(fd, VIDIOC_DQBUF, &buf);
+   if (!ret)
+      *index = buf.index;
+   return ret;
+}
+
+static void be_close(struct backend *be)
+{
+   unsigned i;
+
+   for (i = 0; i < OUT_BUFFERS; i++)
+      if (be->out_map[i])
+         munmap(be->out_map[i], be->out_len[i]);
+   for (i = 0; i < CFG_BUFFERS; i++)
+      if (be->cfg_map[i])
+         munmap(be->cfg_map[i], be->cfg_len[i]);
+   for (i = 0; i < SYNTH_BUFFERS; i++)
+      if (be->in_map[i])
+         munmap(be->in_map[i], be->in_len[i]);
+   if (be->input_fd >= 0)
+      close(be->input_fd);
+   if (be->output_fd >= 0)
+      close(be->output_fd);
+   if (be->config_fd >= 0)
+      close(be->config_fd);
+   memset(be, 0, sizeof(*be));
+   be->input_fd = be->output_fd = be->config_fd = -1;
+}
+
+/* Set up the node group @group of the back end for @cap */
+static int be_open(struct backend *be, int group, const struct capture *cap,
+                   const struct options *o)
+{
+   struct v4l2_format in = { .type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE };
+   struct v4l2_format out = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE };
+   struct v4l2_format meta = { .type = V4L2_BUF_TYPE_META_OUTPUT };
+   struct thermal_be_params p;
+   unsigned i;
+   int media, ret;
+
+   media = media_open("pispbe", group, &be->version);
+   if (media < 0)
+      return media;
+   ret = be_node(media, "pispbe-input", &be->input_fd);
+   if (!ret)
+      ret = be_node(media, "pispbe-output0", &be->output_fd);
+   if (!ret)
+      ret = be_node(media, "pispbe-config", &be->config_fd);
+   close(media);
+   if (ret)
+      return ret;
+
+   /* The back end reads the capture buffers as they are, stride included */
+   in.fmt.pix_mp.width = cap->pix.width;
+   in.fmt.pix_mp.height = cap->pix.height;
+   in.fmt.pix_mp.pixelformat = cap->pix.pixelformat;
+   in.fmt.pix_mp.num_planes = 1;
+   in.fmt.pix_mp.plane_fmt[0].bytesperline = cap->pix.bytesperline;
+   ret = xioctl(be->input_fd, VIDIOC_S_FMT, &in);
+   if (ret)
+      return ret;
+   if (in.fmt.pix_mp.pixelformat != cap->pix.pixelformat ||
+       in.fmt.pix_mp.plane_fmt[0].bytesperline != cap->pix.bytesperline)
+      return -EINVAL;
+
+   out.fmt.pix_mp.width = o->out_width;
+   out.fmt.pix_mp.height = o->out_height;
+   out.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_YUV420;
+   out.fmt.pix_mp.num_planes = 1;
+   ret = xioctl(be->output_fd, VIDIOC_S_FMT, &out);
+   if (ret)
+      return ret;
+   if (out.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_YUV420 ||
+       out.fmt.pix_mp.width != o->out_width || out.fmt.pix_mp.height != o->out_height)
+      return -EINVAL;
+   be->out = out.fmt.pix_mp;
+
+   ret = xioctl(be->config_fd, VIDIOC_G_FMT, &meta);
+   if (ret)
+      return ret;
+
+   /* Node group in use (libcamera): -EBUSY here */
+   be->in_memory = cap->fd >= 0 ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP;
+   be->in_nbufs = cap->fd >= 0 ? cap->nbufs : SYNTH_BUFFERS;
+   ret = be_reqbufs(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, be->in_memory,
+                    be->in_nbufs);
+   if (!ret)
+      ret = be_reqbufs(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+                       V4L2_MEMORY_MMAP, OUT_BUFFERS);
+   if (!ret)
+      ret = be_reqbufs(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, V4L2_MEMORY_MMAP,
+                       CFG_BUFFERS);
+   if (ret)
+      return ret;
+
+   for (i = 0; cap->fd < 0 && i < SYNTH_BUFFERS; i++) {
+      be->in_map[i] = be_map(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, i,
+                             &be->in_len[i]);
+      if (!be->in_map[i])
+         return -ENOMEM;
+      memcpy(be->in_map[i], cap->map[0],
+             be->in_len[i] < cap->len[0] ? be->in_len[i] : cap->len[0]);
+   }
+   for (i = 0; i < OUT_BUFFERS; i++) {
+      be->out_map[i] = be_map(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, i,
+                              &be->out_len[i]);
+      if (!be->out_map[i])
+         return -ENOMEM;
+   }
+
+   /* Same configuration for every job */
+   be_params(cap, be, o, &p);
+   for (i = 0; i < CFG_BUFFERS; i++) {
+      be->cfg_map[i] = be_map(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, i,
+                              &be->cfg_len[i]);
+      if (!be->cfg_map[i])
+         return -ENOMEM;
+      ret = thermal_be_config(&p, be->cfg_map[i], meta.fmt.meta.buffersize);
+      if (ret < 0)
+         return ret;
+   }
+   return 0;
+}
+
+static int be_start(struct backend *be)
+{
+   unsigned i;
+   int ret;
+
+   for (i = 0; i < OUT_BUFFERS; i++) {
+      ret = be_queue(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP,
+                     i, -1, be->out_len[i], 0);
+      if (ret)
+         return ret;
+   }
+   ret = stream(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 1);
+   if (!ret)
+      ret = stream(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, 1);
+   if (!ret)
+      ret = stream(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 1);
+   return ret;
+}
+
+static void be_stop(struct backend *be)
+{
+   stream(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, 0);
+   stream(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, 0);
+   stream(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, 0);
+}
+
+static void write_frame(int out_fd, const void *data, size_t len)
+{
+   if (out_fd >= 0 && write(out_fd, data, len) < 0)
+      perror("thermal-be: write");
+}
+
+/* I420 without line padding, as x264enc/ffmpeg read it from a file or pipe */
+static void write_yuv420(int out_fd, const uint8_t *src, unsigned stride, unsigned w,
+                         unsigned h)
+{
+   unsigned y;
+
+   if (out_fd < 0)
+      return;
+   if (stride == w) {
+      write_frame(out_fd, src, w * h * 3 / 2);
+      return;
+   }
+   for (y = 0; y < h; y++)
+      write_frame(out_fd, src + y * stride, w);
+   src += stride * h;
+   for (y = 0; y < h; y++)
+      write_frame(out_fd, src + y * (stride / 2), w / 2);
+}
+
+static int run_be(struct capture *cap, struct backend *be, const struct options *o,
+                  int out_fd, struct stats *st)
+{
+   unsigned free_cfg[CFG_BUFFERS], nfree_cfg = CFG_BUFFERS;
+   unsigned free_in[SYNTH_BUFFERS], nfree_in = 0;
+   struct fifo jobs = { 0 };
+   int have_seq = 0;
+   uint32_t last_seq = 0;
+   double t0, cpu0;
+   unsigned i, index;
+   int ret;
+
+   for (i = 0; i < CFG_BUFFERS; i++)
+      free_cfg[i] = i;
+   if (cap->fd < 0)
+      for (nfree_in = 0; nfree_in < SYNTH_BUFFERS; nfree_in++)
+         free_in[nfree_in] = nfree_in;
+
+   ret = be_start(be);
+   if (!ret && cap->fd >= 0)
+      ret = capture_start(cap);
+   if (ret)
+      return ret;
+
+   t0 = mono_ms();
+   cpu0 = cpu_s();
+   while (!quit && mono_ms() - t0 < o->seconds * 1e3) {
+      struct pollfd pfd[4] = {
+         { .fd = be->output_fd, .events = POLLIN },
+         { .fd = be->input_fd, .events = POLLOUT },
+         { .fd = be->config_fd, .events = POLLOUT },
+         { .fd = cap->fd, .events = POLLIN },
+      };
+      struct v4l2_buffer buf;
+
+      /* Synthetic input: keep every free input buffer in a job */
+      while (cap->fd < 0 && nfree_in && nfree_cfg) {
+         index = free_in[--nfree_in];
+         be_queue(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, V4L2_MEMORY_MMAP,
+                  free_cfg[--nfree_cfg], -1, 0, be->cfg_len[0]);
+         be_queue(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, V4L2_MEMORY_MMAP,
+                  index, -1, 0, cap->pix.sizeimage);
+         fifo_push(&jobs, mono_ms());
+      }
+
+      if (poll(pfd, cap->fd >= 0 ? 4 : 3, 1000) <= 0)
+         continue;
+
+      if (pfd[3].revents & POLLIN) {
+         memset(&buf, 0, sizeof(buf));
+         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+         buf.memory = V4L2_MEMORY_MMAP;
+         if (!xioctl(cap->fd, VIDIOC_DQBUF, &buf)) {
+            if (have_seq && buf.sequence != last_seq + 1)
+               st->dropped += buf.sequence - last_seq - 1;
+            have_seq = 1;
+            last_seq = buf.sequence;
+
+            /* Same DMABUF, same index on the back end input */
+            if (!nfree_cfg || jobs.count == MAX_BUFFERS) {
+               st->dropped++;
+               capture_queue(cap, buf.index);
+            } else {
+               be_queue(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, V4L2_MEMORY_MMAP,
+                        free_cfg[--nfree_cfg], -1, 0, be->cfg_len[0]);
+               if (be_queue(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+                            V4L2_MEMORY_DMABUF, buf.index, cap->dmabuf[buf.index],
+                            cap->len[buf.index], buf.bytesused))
+                  capture_queue(cap, buf.index);
+               else
+                  fifo_push(&jobs, buf_ts_ms(&buf));
+            }
+         }
+      }
+
+      /* Back end done reading an input: back to the receiver */
+      if ((pfd[1].revents & POLLOUT) &&
+          !be_dequeue(be->input_fd, V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE, be->in_memory,
+                      &index)) {
+         if (cap->fd >= 0)
+            capture_queue(cap, index);
+         else
+            free_in[nfree_in++] = index;
+      }
+
+      if ((pfd[2].revents & POLLOUT) &&
+          !be_dequeue(be->config_fd, V4L2_BUF_TYPE_META_OUTPUT, V4L2_MEMORY_MMAP, &index))
+         free_cfg[nfree_cfg++] = index;
+
+      if ((pfd[0].revents & POLLIN) &&
+          !be_dequeue(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP,
+                      &index)) {
+         if (jobs.count)
+            account(st, fifo_pop(&jobs));
+         write_yuv420(out_fd, be->out_map[index], be->out.plane_fmt[0].bytesperline,
+                      o->out_width, o->out_height);
+         be_queue(be->output_fd, V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE, V4L2_MEMORY_MMAP,
+                  index, -1, be->out_len[index], 0);
+      }
+   }
+   st->fps = st->frames / ((mono_ms() - t0) * 1e-3);
+   st->cpu_pct = (cpu_s() - cpu0) / ((mono_ms() - t0) * 1e-3) * 100;
+
+   if (cap->fd >= 0)
+      stream(cap->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+   be_stop(be);
+   return 0;
+}
+
+/* ---- CPU reference ---------------------------------------------------- */
+
+struct cpu_conv {
+   uint8_t  *lut;               /* 16 to 8 bits, same curve as the gamma block */
+   unsigned *xmap;              /* Source column of each output column */
+   uint16_t *line;
+   uint8_t  *yuv;
+   unsigned  stride;
+};
+
+static int cpu_init(struct cpu_conv *c, const struct capture *cap, const struct options *o)
+{
+   struct thermal_be_params p = {
+      .lo = o->lo,
+      .hi = o->hi,
+      .gamma = o->gamma,
+   };
+   unsigned x;
+
+   c->stride = o->out_width;
+   c->lut = malloc(65536);
+   c->xmap = malloc(o->out_width * sizeof(*c->xmap));
+   c->line = malloc(cap->pix.width * 2);
+   c->yuv = malloc(o->out_width * o->out_height * 3 / 2);
+   if (!c->lut || !c->xmap || !c->line || !c->yuv)
+      return -ENOMEM;
+   thermal_be_tone_lut(&p, c->lut);
+   for (x = 0; x < o->out_width; x++)
+      c->xmap[x] = x * cap->pix.width / o->out_width;
+   return 0;
+}
+
+static void cpu_free(struct cpu_conv *c)
+{
+   free(c->lut);
+   free(c->xmap);
+   free(c->line);
+   free(c->yuv);
+}
+
+static void cpu_convert(struct cpu_conv *c, const struct capture *cap, const void *map,
+                        const struct options *o)
+{
+   unsigned x, y;
+
+   /* Only the source lines used are read (and decoded) */
+   for (y = 0; y < o->out_height; y++) {
+      const uint16_t *src = frame_line(cap, map, y * cap->pix.height / o->out_height,
+                                       c->line, o);
+      uint8_t *dst = c->yuv + y * o->out_width;
+
+      for (x = 0; x < o->out_width; x++)
+         dst[x] = c->lut[src[c->xmap[x]]];
+   }
+   memset(c->yuv + o->out_width * o->out_height, 128, o->out_width * o->out_height / 2);
+}
+
+static int run_cpu(struct capture *cap, const struct options *o, int out_fd,
+                   struct stats *st)
+{
+   struct cpu_conv c = { 0 };
+   int have_seq = 0;
+   uint32_t last_seq = 0;
+   double t0, cpu0;
+   int ret;
+
+   ret = cpu_init(&c, cap, o);
+   if (!ret && cap->fd >= 0)
+      ret = capture_start(cap);
+   if (ret) {
+      cpu_free(&c);
+      return ret;
+   }
+
+   t0 = mono_ms();
+   cpu0 = cpu_s();
+   while (!quit && mono_ms() - t0 < o->seconds * 1e3) {
+      struct v4l2_buffer buf;
+      double start;
+
+      if (cap->fd < 0) {
+         start = mono_ms();
+         cpu_convert(&c, cap, cap->map[0], o);
+      } else {
+         if (capture_wait(cap, &buf, 1000))
+            continue;
+         if (have_seq && buf.sequence != last_seq + 1)
+            st->dropped += buf.sequence - last_seq - 1;
+         have_seq = 1;
+         last_seq = buf.sequence;
+         start = buf_ts_ms(&buf);
+         cpu_convert(&c, cap, cap->map[buf.index], o);
+         capture_queue(cap, buf.index);
+      }
+      account(st, start);
+      write_yuv420(out_fd, c.yuv, c.stride, o->out_width, o->out_height);
+   }
+   st->fps = st->frames / ((mono_ms() - t0) * 1e-3);
+   st->cpu_pct = (cpu_s() - cpu0) / ((mono_ms() - t0) * 1e-3) * 100;
+
+   if (cap->fd >= 0)
+      stream(cap->fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+   cpu_free(&c);
+   return 0;
+}
+
+/* ---- Main ------------------------------------------------------------- */
+
+static void report(const char *path, const struct capture *cap, const struct options *o,
+                   const struct stats *st)
+{
+   fprintf(info, "%-3s %ux%u %s -> %ux%u YUV420 frames %u fps %.1f dropped %u "
+          "latency avg %.2f max %.2f ms cpu %.1f %%\n", path, cap->pix.width,
+          cap->pix.height, is_compressed(cap) ? "PC1M" : "Y16", o->out_width,
+          o->out_height, st->frames, st->fps, st->dropped,
+          st->frames ? st->latency_sum_ms / st->frames : 0, st->latency_max_ms,
+          st->cpu_pct);
+}
+
+static int parse_size(const char *s, unsigned *w, unsigned *h)
+{
+   return sscanf(s, "%ux%u", w, h) == 2 && *w && *h ? 0 : -1;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: thermal-be [-d VIDEO] [-s WxH] [-l LO] [-H HI] [-g GAMMA] [-m be|cpu|both]\n"
+      "                  [-t SECONDS] [-o FILE] [-G GROUP] [-M MODE] [-O OFFSET]\n"
+      "                  [-i WxH[:PC1M]] [-c FILE]\n"
+      "  -d VIDEO   CFE node, Y16 or PC1M (default: /dev/video0), 'none' synthetic\n"
+      "  -s WxH     output size, even (default: input size)\n"
+      "  -l, -H     16-bit range mapped to 0..255 (default: 1 and 99 %% of the first frame)\n"
+      "  -g GAMMA   tone curve gamma (default: 1.0)\n"
+      "  -m PATH    be: PiSP back end, cpu: CPU reference, both: compare (default: be)\n"
+      "  -t SECONDS run time per path (default: 10)\n"
+      "  -o FILE    I420 frames, '-' for stdout (e.g. to x264enc through fdsrc)\n"
+      "  -G GROUP   pispbe node group (default: first free)\n"
+      "  -M, -O     rp1-cfe compression_mode and compression_offset of PC1M input\n"
+      "             (default: 1 and 0)\n"
+      "  -i WxH     synthetic input size with -d none (default: 640x480), :PC1M compressed\n"
+      "  -c FILE    write the pispbe-config buffer for the input and output sizes, exit\n");
+}
+
+int main(int argc, char **argv)
+{
+   struct options o = {
+      .video = "/dev/video0",
+      .synth_width = 640,
+      .synth_height = 480,
+      .synth_fourcc = V4L2_PIX_FMT_Y16,
+      .comp_mode = 1,
+      .lo = -1,
+      .hi = -1,
+      .gamma = 1.0f,
+      .seconds = 10,
+      .group = -1,
+   };
+   struct capture cap = { .fd = -1 };
+   struct backend be = { .input_fd = -1, .output_fd = -1, .config_fd = -1 };
+   struct stats st_be = { 0 }, st_cpu = { 0 };
+   const char *config_file = NULL;
+   const char *path = "be";
+   int out_fd = -1;
+   int do_be, do_cpu;
+   char *colon;
+   unsigned i;
+   int opt, ret;
+
+   while ((opt = getopt(argc, argv, "d:s:l:H:g:m:t:o:G:M:O:i:c:h")) != -1) {
+      switch (opt) {
+      case 'd':
+         o.video = strcmp(optarg, "none") ? optarg : NULL;
+         break;
+      case 's':
+         if (parse_size(optarg, &o.out_width, &o.out_height)) {
+            usage();
+            return 1;
+         }
+         break;
+      case 'l':
+         o.lo = strtol(optarg, NULL, 0);
+         break;
+      case 'H':
+         o.hi = strtol(optarg, NULL, 0);
+         break;
+      case 'g':
+         o.gamma = strtof(optarg, NULL);
+         break;
+      case 'm':
+         path = optarg;
+         break;
+      case 't':
+         o.seconds = strtol(optarg, NULL, 0);
+         break;
+      case 'o':
+         o.output = optarg;
+         break;
+      case 'G':
+         o.group = strtol(optarg, NULL, 0);
+         break;
+      case 'M':
+         o.comp_mode = strtoul(optarg, NULL, 0);
+         break;
+      case 'O':
+         o.comp_offset = strtoul(optarg, NULL, 0);
+         break;
+      case 'i':
+         colon = strchr(optarg, ':');
+         if (colon) {
+            *colon = 0;
+            o.synth_fourcc = V4L2_PIX_FMT_PISP_COMP1_MONO;
+         }
+         if (parse_size(optarg, &o.synth_width, &o.synth_height)) {
+            usage();
+            return 1;
+         }
+         break;
+      case 'c':
+         config_file = optarg;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+   info = o.output && !strcmp(o.output, "-") ? stderr : stdout;
+   do_be = !strcmp(path, "be") || !strcmp(path, "both");
+   do_cpu = !strcmp(path, "cpu") || !strcmp(path, "both");
+   if ((!do_be && !do_cpu) || o.comp_mode < 1 || o.comp_mode > 3) {
+      usage();
+      return 1;
+   }
+
+   ret = o.video ? capture_open(&cap, o.video) : synth_open(&cap, &o);
+   if (ret) {
+      fprintf(stderr, "thermal-be: %s: %s\n", o.video ? o.video : "synthetic input",
+              ret == -EINVAL ? "not a Y16 or PC1M capture" : strerror(-ret));
+      return 1;
+   }
+   if (!o.out_width) {
+      o.out_width = cap.pix.width;
+      o.out_height = cap.pix.height;
+   }
+   o.out_width &= ~1u;
+   o.out_height &= ~1u;
+
+   /* Tone mapping window from the first frame when not given */
+   if (o.lo < 0 || o.hi < 0) {
+      struct v4l2_buffer buf;
+
+      if (cap.fd < 0) {
+         auto_window(&cap, cap.map[0], &o);
+      } else if (!capture_start(&cap) && !capture_wait(&cap, &buf, 2000)) {
+         auto_window(&cap, cap.map[buf.index], &o);
+         stream(cap.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+      } else {
+         fprintf(stderr, "thermal-be: no frame from %s\n", o.video);
+         return 1;
+      }
+   }
+   fprintf(info, "tone mapping %d..%d gamma %.2f\n", o.lo, o.hi, o.gamma);
+
+   if (config_file) {
+      struct thermal_be_params p;
+      static uint8_t buf[512 * 1024];
+      FILE *f;
+
+      /* Strides as the Pi 5 pispbe nodes would set them (64-byte aligned output) */
+      be.version = 0;
+      be.out.plane_fmt[0].bytesperline = (o.out_width + 63) & ~63u;
+      be_params(&cap, &be, &o, &p);
+      ret = thermal_be_config(&p, buf, sizeof(buf));
+      if (ret < 0)
+         return 1;
+      f = fopen(config_file, "wb");
+      if (!f || fwrite(buf, 1, ret, f) != (size_t)ret) {
+         perror(config_file);
+         return 1;
+      }
+      fclose(f);
+      fprintf(info, "%s: %d bytes\n", config_file, ret);
+      return 0;
+   }
+
+   if (do_be) {
+      /* First node group not used by libcamera, or the one given */
+      for (i = o.group < 0 ? 0 : o.group; ; i++) {
+         ret = be_open(&be, i, &cap, &o);
+         if (!ret || o.group >= 0 || ret == -ENODEV)
+            break;
+         be_close(&be);
+      }
+      if (ret) {
+         fprintf(stderr, "thermal-be: PiSP back end: %s\n", strerror(-ret));
+         return 1;
+      }
+   }
+
+   if (o.output) {
+      out_fd = strcmp(o.output, "-") ? open(o.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) :
+                                       STDOUT_FILENO;
+      if (out_fd < 0) {
+         perror(o.output);
+         return 1;
+      }
+   }
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+
+   if (do_be) {
+      ret = run_be(&cap, &be, &o, out_fd, &st_be);
+      if (ret) {
+         fprintf(stderr, "thermal-be: back end stream: %s\n", strerror(-ret));
+         return 1;
+      }
+      report("be", &cap, &o, &st_be);
+   }
+   if (do_cpu && !quit) {
+      ret = run_cpu(&cap, &o, out_fd, &st_cpu);
+      if (ret) {
+         fprintf(stderr, "thermal-be: CPU path: %s\n", strerror(-ret));
+         return 1;
+      }
+      report("cpu", &cap, &o, &st_cpu);
+   }
+   if (do_be && do_cpu && st_be.frames && st_cpu.frames)
+      fprintf(info, "saved per stream: %.1f %% of a core, %.2f ms latency\n",
+             st_cpu.cpu_pct - st_be.cpu_pct,
+             st_cpu.latency_sum_ms / st_cpu.frames - st_be.latency_sum_ms / st_be.frames);
+
+   be_close(&be);
+   for (i = 0; i < cap.nbufs; i++) {
+      if (cap.fd < 0) {
+         free(cap.map[i]);
+         continue;
+      }
+      munmap(cap.map[i], cap.len[i]);
+      close(cap.dmabuf[i]);
+   }
+   if (cap.fd >= 0)
+      close(cap.fd);
+   if (out_fd > STDOUT_FILENO)
+      close(out_fd);
+   return 0;
+}
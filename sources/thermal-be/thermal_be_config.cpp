@@ -0,0 +1,146 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include <libpisp/backend/backend.hpp>
+#include <libpisp/variants/variant.hpp>
+
+#include "thermal_be_config.h"
+
+/*
+ * Gamma block: 64 segments, 32 of 512 input codes, 16 of 1024 and 16 of
+ * 2048, the last one ending at 65535 (as libcamera's PiSP IPA programs it).
+ * Each entry holds the output at the start of the segment (high 16 bits)
+ * and its increase over the segment (low 16 bits), the block interpolates
+ * linearly in between. The curve maps lo..hi to the full range, so it does
+ * the whole 16 to 8-bit tone mapping; the output keeps the top 8 bits.
+ */
+static double tone_curve(const thermal_be_params *p, double x)
+{
+   double v = (x - p->lo) / (p->hi > p->lo ? p->hi - p->lo : 1);
+
+   v = v < 0 ? 0 : v > 1 ? 1 : v;
+   if (p->gamma > 0 && p->gamma != 1)
+      v = std::pow(v, 1 / p->gamma);
+   return v * 65535;
+}
+
+/* Input code at the start of gamma segment @i, 0 to PISP_BE_GAMMA_LUT_SIZE */
+static uint32_t gamma_x(unsigned int i)
+{
+   if (i < 32)
+      return i * 512;
+   if (i < 48)
+      return 16384 + (i - 32) * 1024;
+   return std::min(65535u, 32768 + (i - 48) * 2048);
+}
+
+static uint32_t gamma_y(const thermal_be_params *p, unsigned int i)
+{
+   return std::lround(tone_curve(p, gamma_x(i)));
+}
+
+static void tone_map(const thermal_be_params *p, pisp_be_gamma_config &gamma)
+{
+   for (unsigned int i = 0; i < PISP_BE_GAMMA_LUT_SIZE; i++) {
+      uint32_t y0 = gamma_y(p, i);
+      uint32_t y1 = gamma_y(p, i + 1);
+
+      gamma.lut[i] = (y0 << 16) | ((y1 - y0) & 0xffff);
+   }
+}
+
+void thermal_be_tone_lut(const struct thermal_be_params *p, uint8_t *lut)
+{
+   for (unsigned int i = 0; i < PISP_BE_GAMMA_LUT_SIZE; i++) {
+      uint32_t x0 = gamma_x(i), x1 = gamma_x(i + 1);
+      uint32_t y0 = gamma_y(p, i), y1 = gamma_y(p, i + 1);
+      uint32_t end = i == PISP_BE_GAMMA_LUT_SIZE - 1 ? x1 : x1 - 1;
+
+      for (uint32_t x = x0; x <= end; x++)
+         lut[x] = (y0 + (uint64_t)(y1 - y0) * (x - x0) / (x1 - x0)) >> 8;
+   }
+}
+
+int thermal_be_config(const struct thermal_be_params *p, void *buf, size_t size)
+{
+   if (size < sizeof(pisp_be_tiles_config))
+      return -EINVAL;
+
+   try {
+      /* No device to ask (config file only): the Pi 5 one */
+      const libpisp::PiSPVariant &variant =
+         p->be_version ? libpisp::get_variant(p->fe_version, p->be_version)
+                       : libpisp::BCM2712_HW;
+      libpisp::BackEnd be(libpisp::BackEnd::Config(0, 0, 0), variant);
+      pisp_be_tiles_config config = {};
+      pisp_be_global_config global;
+      pisp_image_format_config input = {};
+      pisp_be_output_format_config output = {};
+      pisp_be_gamma_config gamma;
+      pisp_be_ccm_config csc;
+
+      be.GetGlobal(global);
+      global.bayer_order = PISP_BAYER_ORDER_GREYSCALE;
+      global.bayer_enables = PISP_BE_BAYER_ENABLE_INPUT | PISP_BE_BAYER_ENABLE_DEMOSAIC;
+      global.rgb_enables = PISP_BE_RGB_ENABLE_GAMMA | PISP_BE_RGB_ENABLE_CSC0 |
+                           PISP_BE_RGB_ENABLE_OUTPUT0;
+
+      input.width = p->width;
+      input.height = p->height;
+      input.stride = p->stride;
+      if (p->compressed) {
+         pisp_decompress_config decompress = {};
+
+         input.format = PISP_IMAGE_FORMAT_BPS_8 +
+                        p->comp_mode * PISP_IMAGE_FORMAT_COMPRESSION_MODE_1;
+         decompress.offset = p->comp_offset;
+         decompress.mode = p->comp_mode;
+         be.SetDecompress(decompress);
+         global.bayer_enables |= PISP_BE_BAYER_ENABLE_DECOMPRESS;
+      } else {
+         input.format = PISP_IMAGE_FORMAT_BPS_16;
+      }
+      be.SetInputFormat(input);
+
+      tone_map(p, gamma);
+      be.SetGamma(gamma);
+
+      /* Grey in, so Y is the tone mapped value and the chroma is neutral */
+      be.InitialiseYcbcr(csc, "jpeg");
+      be.SetCsc(0, csc);
+
+      output.image.width = p->out_width;
+      output.image.height = p->out_height;
+      output.image.format = PISP_IMAGE_FORMAT_BPS_8 | PISP_IMAGE_FORMAT_SAMPLING_420 |
+                            PISP_IMAGE_FORMAT_PLANARITY_PLANAR;
+      output.image.stride = p->out_stride;
+      output.image.stride2 = p->out_stride / 2;
+      output.lo = 0;
+      output.hi = 65535;
+      output.lo2 = 0;
+      output.hi2 = 65535;
+      be.SetOutputFormat(0, output);
+
+      /* Downscale and resample chosen by libpisp */
+      if (p->out_width != p->width || p->out_height != p->height)
+         be.SetSmartResize(0, { (uint16_t)p->out_width, (uint16_t)p->out_height });
+
+      be.SetGlobal(global);
+      be.Prepare(&config);
+      std::memcpy(buf, &config, sizeof(config));
+   } catch (std::exception const &e) {
+      fprintf(stderr, "thermal-be: PiSP back end configuration: %s\n", e.what());
+      return -EINVAL;
+   }
+
+   return sizeof(pisp_be_tiles_config);
+}
@@ -0,0 +1,59 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef THERMAL_BE_CONFIG_H
+#define THERMAL_BE_CONFIG_H
+
+/*
+ * PiSP back end configuration of the thermal path: 16-bit mono in (Y16, or
+ * PISP_COMP1 from the CFE), tone mapping by the gamma block, optional
+ * downscale, 8-bit YUV420 out.
+ *
+ * The configuration and its tiles are computed by libpisp and written as
+ * the struct pisp_be_tiles_config expected by the pispbe-config node.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct thermal_be_params {
+   /* Input, as captured by the CFE */
+   unsigned int width, height;
+   unsigned int stride;            /* bytesperline */
+   int          compressed;        /* PISP_COMP1_MONO instead of Y16 */
+   unsigned int comp_mode;         /* rp1-cfe compression_mode/offset */
+   unsigned int comp_offset;
+   /* Output YUV420, stride of the Y plane, chroma strides are half */
+   unsigned int out_width, out_height;
+   unsigned int out_stride;
+   /* Tone mapping: lo..hi mapped to 0..255 with gamma */
+   uint16_t     lo, hi;
+   float        gamma;
+   /* MEDIA_IOC_DEVICE_INFO hw_revision of the CFE and of the back end, 0: Pi 5 */
+   unsigned int fe_version, be_version;
+};
+
+/*
+ * Fill @buf (the pispbe-config buffer, @size bytes) from @p.
+ * Returns the size of the configuration written or -errno.
+ */
+int thermal_be_config(const struct thermal_be_params *p, void *buf, size_t size);
+
+/*
+ * 8-bit output of the gamma block for each of the 65536 input codes, the
+ * piecewise-linear curve thermal_be_config() programs, from the lo, hi and
+ * gamma of @p. For the CPU path, so that both paths give the same levels.
+ */
+void thermal_be_tone_lut(const struct thermal_be_params *p, uint8_t *lut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* THERMAL_BE_CONFIG_H */
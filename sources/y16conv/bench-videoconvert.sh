@@ -0,0 +1,24 @@
+#!/bin/bash
+# Compare exoy16conv with videoconvert on GRAY16_BE frames.
+# Usage: bench-videoconvert.sh [WIDTH] [HEIGHT] [FRAMES]
+
+WIDTH=${1:-1280}
+HEIGHT=${2:-1024}
+FRAMES=${3:-1000}
+SRC="videotestsrc num-buffers=$FRAMES ! video/x-raw,format=GRAY16_BE,width=$WIDTH,height=$HEIGHT"
+
+run()
+{
+   local name=$1
+   shift
+   # user+sys CPU seconds of the whole pipeline, videotestsrc included
+   local t=$( { /usr/bin/time -f "%e %U %S" gst-launch-1.0 -q $SRC ! "$@" ! fakesink sync=false >/dev/null; } 2>&1 | tail -1)
+   echo "$name $t" | awk -v n=$FRAMES '{ printf "%-28s %6.2f ms/frame wall %6.2f ms/frame CPU\n", $1, $2 * 1000 / n, ($3 + $4) * 1000 / n }'
+}
+
+echo "${WIDTH}x${HEIGHT}, $FRAMES frames"
+run baseline identity
+run videoconvert-GRAY16_LE videoconvert ! video/x-raw,format=GRAY16_LE
+run exoy16conv-GRAY16_LE exoy16conv ! video/x-raw,format=GRAY16_LE
+run videoconvert-GRAY8 videoconvert ! video/x-raw,format=GRAY8
+run exoy16conv-GRAY8 exoy16conv ! video/x-raw,format=GRAY8
@@ -0,0 +1,264 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * comp1-bench - PISP_COMP1 capture on the Pi 5: memory saved and decode cost.
+ *
+ * For each resolution, reports the buffer size and DRAM write bandwidth of
+ * the Y16 capture against the PISP_COMP1 one at the given frame rate, and
+ * the time per frame of the NEON decompression (y16_comp1_decode) and of
+ * the plain C one. On aarch64, the NEON output is checked against the C
+ * reference; elsewhere y16_comp1_decode is the C one and the check is skipped.
+ *
+ * With -i, decodes a captured PC1M frame instead of random blocks (first
+ * resolution only) and writes it as Y16 with -o. With -r, compares it with
+ * a Y16 capture of the same static scene: the error includes the sensor
+ * noise between the two frames.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "y16conv.h"
+
+/* Line alignment of the rp1-cfe buffers */
+#define CFE_BPL_ALIGN 16
+
+static double now_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t align(size_t v, size_t a)
+{
+   return (v + a - 1) / a * a;
+}
+
+static int load(const char *path, void *buf, size_t size)
+{
+   FILE *f = fopen(path, "rb");
+   size_t n;
+
+   if (!f) {
+      perror(path);
+      return -1;
+   }
+   n = fread(buf, 1, size, f);
+   fclose(f);
+   if (n != size) {
+      fprintf(stderr, "comp1-bench: %s: %zu bytes, %zu expected\n", path, n, size);
+      return -1;
+   }
+   return 0;
+}
+
+static void decode_frame(const uint8_t *src, size_t bpl, uint16_t *dst,
+                         unsigned int width, unsigned int height,
+                         unsigned int mode, unsigned int offset, int neon)
+{
+   unsigned int y;
+
+   for (y = 0; y < height; y++) {
+      if (neon)
+         y16_comp1_decode(src + y * bpl, dst + (size_t)y * width, width, mode, offset);
+      else
+         y16_comp1_decode_c(src + y * bpl, dst + (size_t)y * width, width, mode, offset);
+   }
+}
+
+static double time_decode(const uint8_t *src, size_t bpl, uint16_t *dst,
+                          unsigned int width, unsigned int height, unsigned int mode,
+                          unsigned int offset, int neon, int frames)
+{
+   double t = now_s();
+   int f;
+
+   for (f = 0; f < frames; f++)
+      decode_frame(src, bpl, dst, width, height, mode, offset, neon);
+   return (now_s() - t) / frames;
+}
+
+static void compare(const uint16_t *ref, const uint16_t *dec, size_t npix)
+{
+   double sum2 = 0, sum = 0, mse;
+   unsigned int maxerr = 0;
+   size_t i;
+
+   for (i = 0; i < npix; i++) {
+      int d = (int)dec[i] - ref[i];
+      unsigned int a = d < 0 ? -d : d;
+
+      sum += a;
+      sum2 += (double)d * d;
+      if (a > maxerr)
+         maxerr = a;
+   }
+   mse = sum2 / npix;
+   printf("  against the Y16 reference: mean error %.1f, max %u, PSNR %.1f dB\n",
+          sum / npix, maxerr, mse ? 10 * log10(65535.0 * 65535.0 / mse) : INFINITY);
+}
+
+static int run(unsigned int width, unsigned int height, int frames, int fps,
+               unsigned int mode, unsigned int offset, const char *in,
+               const char *ref, const char *out)
+{
+   size_t bpl = align(width, CFE_BPL_ALIGN);
+   size_t bpl16 = align(width * 2, CFE_BPL_ALIGN);
+   size_t npix = (size_t)width * height;
+   uint16_t *dst, *dst_c, *y16 = NULL;
+   double t_neon, t_c;
+   size_t size, size16, i;
+   uint8_t *src;
+   int ret = -1;
+
+   src = malloc(bpl * height);
+   dst = malloc(npix * 2);
+   dst_c = malloc(npix * 2);
+   if (!src || !dst || !dst_c)
+      goto out;
+
+   if (in) {
+      /* v4l2-ctl --stream-to output: lines padded to bytesperline */
+      if (load(in, src, bpl * height))
+         goto out;
+   } else {
+      srand(width * height);
+      for (i = 0; i < bpl * height; i++)
+         src[i] = rand();
+   }
+
+   size = bpl * height;
+   size16 = bpl16 * height;
+   printf("%ux%u: Y16 %zu B/frame, PISP_COMP1 %zu B/frame, %.1f %% saved, "
+          "%.1f -> %.1f MB/s at %d fps\n", width, height, size16, size,
+          100.0 * (size16 - size) / size16, size16 * fps * 1e-6, size * fps * 1e-6, fps);
+
+   t_neon = time_decode(src, bpl, dst, width, height, mode, offset, 1, frames);
+   t_c = time_decode(src, bpl, dst_c, width, height, mode, offset, 0, frames);
+   printf("  decode: %.3f ms/frame (%.1f %% core at %d fps), C %.3f ms/frame, %.1f Mpix/s\n",
+          t_neon * 1e3, t_neon * fps * 100, fps, t_c * 1e3, npix / t_neon * 1e-6);
+
+#ifdef __aarch64__
+   if (memcmp(dst, dst_c, npix * 2)) {
+      fprintf(stderr, "comp1-bench: %ux%u: NEON and C decodes differ\n", width, height);
+      goto out;
+   }
+   printf("  NEON output identical to the C reference\n");
+#else
+   printf("  NEON check skipped, no NEON on this host\n");
+#endif
+
+   if (ref) {
+      y16 = malloc(bpl16 * height);
+      if (!y16 || load(ref, y16, bpl16 * height))
+         goto out;
+      for (i = 1; i < height; i++)
+         memmove(y16 + i * width, (uint8_t *)y16 + i * bpl16, width * 2);
+      compare(y16, dst, npix);
+   }
+
+   if (out) {
+      FILE *f = fopen(out, "wb");
+
+      if (!f || fwrite(dst, 2, npix, f) != npix) {
+         perror(out);
+         if (f)
+            fclose(f);
+         goto out;
+      }
+      fclose(f);
+   }
+   ret = 0;
+
+out:
+   free(src);
+   free(dst);
+   free(dst_c);
+   free(y16);
+   return ret;
+}
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: comp1-bench [-s WxH[,WxH...]] [-n FRAMES] [-f FPS] [-m MODE] [-O OFFSET]\n"
+      "                   [-i PC1M_FILE [-r Y16_FILE] [-o OUT_FILE]]\n"
+      "  -s SIZES   resolutions (default: 320x240,640x480,640x512,1024x768,1280x1024)\n"
+      "  -n FRAMES  decoded frames per resolution (default: 200)\n"
+      "  -f FPS     frame rate of the bandwidth and CPU figures (default: 60)\n"
+      "  -m MODE    rp1-cfe compression_mode: 1 delta, 2 simple, 3 combined (default: 1)\n"
+      "  -O OFFSET  rp1-cfe compression_offset (default: 0)\n"
+      "  -i FILE    captured PC1M frame, lines of bytesperline, instead of random blocks\n"
+      "  -r FILE    Y16 capture of the same static scene, to measure the error\n"
+      "  -o FILE    decoded frame, Y16 without line padding\n");
+}
+
+int main(int argc, char **argv)
+{
+   char sizes[256] = "320x240,640x480,640x512,1024x768,1280x1024";
+   const char *in = NULL, *ref = NULL, *out = NULL;
+   unsigned int mode = 1, offset = 0;
+   int frames = 200, fps = 60;
+   unsigned int width, height;
+   char *tok, *save;
+   int opt, ret = 0;
+
+   while ((opt = getopt(argc, argv, "s:n:f:m:O:i:r:o:h")) != -1) {
+      switch (opt) {
+      case 's':
+         snprintf(sizes, sizeof(sizes), "%s", optarg);
+         break;
+      case 'n':
+         frames = strtol(optarg, NULL, 0);
+         break;
+      case 'f':
+         fps = strtol(optarg, NULL, 0);
+         break;
+      case 'm':
+         mode = strtoul(optarg, NULL, 0);
+         break;
+      case 'O':
+         offset = strtoul(optarg, NULL, 0);
+         break;
+      case 'i':
+         in = optarg;
+         break;
+      case 'r':
+         ref = optarg;
+         break;
+      case 'o':
+         out = optarg;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+   if (mode < 1 || mode > 3 || frames < 1 || (!in && (ref || out))) {
+      usage();
+      return 1;
+   }
+
+   printf("PISP_COMP1 mode %u offset %u, %d frames\n", mode, offset, frames);
+   for (tok = strtok_r(sizes, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+      if (sscanf(tok, "%ux%u", &width, &height) != 2 || !width || !height) {
+         fprintf(stderr, "comp1-bench: bad size %s\n", tok);
+         return 1;
+      }
+      ret = run(width, height, frames, fps, mode, offset, in, ref, out);
+      /* A captured frame has one size */
+      if (ret || in)
+         break;
+   }
+   return ret ? 1 : 0;
+}
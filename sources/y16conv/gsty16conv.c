@@ -0,0 +1,248 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * exoy16conv - GStreamer element converting GRAY16_BE (unicam Y16_BE) to
+ * GRAY16_LE, byte-swapped in place, or to GRAY8 with automatic gain.
+ *
+ * Works on any mappable memory, including the dmabuf buffers of
+ * v4l2src io-mode=dmabuf. In-place swapping needs a writable buffer:
+ * upstream buffers still referenced elsewhere are copied by GstBaseTransform.
+ *
+ *   gst-launch-1.0 v4l2src io-mode=dmabuf ! video/x-raw,format=GRAY16_BE ! \
+ *     exoy16conv ! video/x-raw,format=GRAY8 ! autovideosink
+ */
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "y16conv.h"
+
+#define DEFAULT_AGC_LOW    1.0
+#define DEFAULT_AGC_HIGH   99.0
+#define DEFAULT_AGC_SPEED  0.2
+
+#define GST_TYPE_EXO_Y16CONV (gst_exo_y16conv_get_type())
+G_DECLARE_FINAL_TYPE(GstExoY16Conv, gst_exo_y16conv, GST, EXO_Y16CONV, GstVideoFilter)
+
+struct _GstExoY16Conv {
+   GstVideoFilter parent;
+
+   gfloat         agc_low;
+   gfloat         agc_high;
+   gfloat         agc_speed;
+
+   gboolean       to_gray8;
+   struct y16_agc agc;
+};
+
+enum {
+   PROP_0,
+   PROP_AGC_LOW,
+   PROP_AGC_HIGH,
+   PROP_AGC_SPEED,
+};
+
+G_DEFINE_TYPE(GstExoY16Conv, gst_exo_y16conv, GST_TYPE_VIDEO_FILTER);
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink",
+   GST_PAD_SINK, GST_PAD_ALWAYS,
+   GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("GRAY16_BE")));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+   GST_PAD_SRC, GST_PAD_ALWAYS,
+   GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ GRAY16_LE, GRAY8 }")));
+
+static GstCaps *gst_exo_y16conv_transform_caps(GstBaseTransform *trans,
+   GstPadDirection direction, GstCaps *caps, GstCaps *filter)
+{
+   /* Native 16 bits first, GRAY8 only when downstream asks for it */
+   static const char *const src_formats[] = { "GRAY16_LE", "GRAY8" };
+   GstCaps *res = gst_caps_new_empty();
+   guint i, j;
+
+   for (i = 0; i < gst_caps_get_size(caps); i++) {
+      const GstStructure *s = gst_caps_get_structure(caps, i);
+
+      if (direction == GST_PAD_SINK) {
+         for (j = 0; j < G_N_ELEMENTS(src_formats); j++) {
+            GstStructure *out = gst_structure_copy(s);
+
+            gst_structure_set(out, "format", G_TYPE_STRING, src_formats[j], NULL);
+            res = gst_caps_merge_structure(res, out);
+         }
+      } else {
+         GstStructure *out = gst_structure_copy(s);
+
+         gst_structure_set(out, "format", G_TYPE_STRING, "GRAY16_BE", NULL);
+         res = gst_caps_merge_structure(res, out);
+      }
+   }
+
+   if (filter) {
+      GstCaps *tmp = gst_caps_intersect_full(filter, res, GST_CAPS_INTERSECT_FIRST);
+
+      gst_caps_unref(res);
+      res = tmp;
+   }
+   return res;
+}
+
+static gboolean gst_exo_y16conv_set_info(GstVideoFilter *filter, GstCaps *incaps,
+   GstVideoInfo *in_info, GstCaps *outcaps, GstVideoInfo *out_info)
+{
+   GstExoY16Conv *self = GST_EXO_Y16CONV(filter);
+
+   self->to_gray8 = GST_VIDEO_INFO_FORMAT(out_info) == GST_VIDEO_FORMAT_GRAY8;
+   /* Swapping keeps the size: done in place, without an output buffer */
+   gst_base_transform_set_in_place(GST_BASE_TRANSFORM(filter), !self->to_gray8);
+
+   if (self->to_gray8)
+      y16_agc_init(&self->agc, self->agc_low, self->agc_high, self->agc_speed);
+
+   return TRUE;
+}
+
+static GstFlowReturn gst_exo_y16conv_transform_frame_ip(GstVideoFilter *filter,
+   GstVideoFrame *frame)
+{
+   guint width = GST_VIDEO_FRAME_WIDTH(frame);
+   guint height = GST_VIDEO_FRAME_HEIGHT(frame);
+   gint stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+   guint8 *data = GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+   guint y;
+
+   if (stride == (gint)width * 2) {
+      y16_swap((uint16_t *)data, (uint16_t *)data, (size_t)width * height);
+      return GST_FLOW_OK;
+   }
+   for (y = 0; y < height; y++, data += stride)
+      y16_swap((uint16_t *)data, (uint16_t *)data, width);
+
+   return GST_FLOW_OK;
+}
+
+static GstFlowReturn gst_exo_y16conv_transform_frame(GstVideoFilter *filter,
+   GstVideoFrame *in_frame, GstVideoFrame *out_frame)
+{
+   GstExoY16Conv *self = GST_EXO_Y16CONV(filter);
+   guint width = GST_VIDEO_FRAME_WIDTH(in_frame);
+   guint height = GST_VIDEO_FRAME_HEIGHT(in_frame);
+   gint in_stride = GST_VIDEO_FRAME_PLANE_STRIDE(in_frame, 0);
+   gint out_stride = GST_VIDEO_FRAME_PLANE_STRIDE(out_frame, 0);
+   const guint8 *in = GST_VIDEO_FRAME_PLANE_DATA(in_frame, 0);
+   guint8 *out = GST_VIDEO_FRAME_PLANE_DATA(out_frame, 0);
+   guint y;
+
+   for (y = 0; y < height; y++, in += in_stride, out += out_stride)
+      y16_agc_convert(&self->agc, (const uint16_t *)in, out, width, 1);
+   y16_agc_update(&self->agc);
+
+   return GST_FLOW_OK;
+}
+
+static void gst_exo_y16conv_set_property(GObject *object, guint prop_id,
+   const GValue *value, GParamSpec *pspec)
+{
+   GstExoY16Conv *self = GST_EXO_Y16CONV(object);
+
+   GST_OBJECT_LOCK(self);
+   switch (prop_id) {
+   case PROP_AGC_LOW:
+      self->agc_low = self->agc.low_pct = g_value_get_float(value);
+      break;
+   case PROP_AGC_HIGH:
+      self->agc_high = self->agc.high_pct = g_value_get_float(value);
+      break;
+   case PROP_AGC_SPEED:
+      self->agc_speed = self->agc.speed = g_value_get_float(value);
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+   }
+   GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_exo_y16conv_get_property(GObject *object, guint prop_id,
+   GValue *value, GParamSpec *pspec)
+{
+   GstExoY16Conv *self = GST_EXO_Y16CONV(object);
+
+   GST_OBJECT_LOCK(self);
+   switch (prop_id) {
+   case PROP_AGC_LOW:
+      g_value_set_float(value, self->agc_low);
+      break;
+   case PROP_AGC_HIGH:
+      g_value_set_float(value, self->agc_high);
+      break;
+   case PROP_AGC_SPEED:
+      g_value_set_float(value, self->agc_speed);
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+   }
+   GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_exo_y16conv_class_init(GstExoY16ConvClass *klass)
+{
+   GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+   GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+   GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS(klass);
+   GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+   gobject_class->set_property = gst_exo_y16conv_set_property;
+   gobject_class->get_property = gst_exo_y16conv_get_property;
+
+   g_object_class_install_property(gobject_class, PROP_AGC_LOW,
+      g_param_spec_float("agc-low", "AGC low percentile",
+         "GRAY8 output: percentile of the pixels mapped to black",
+         0.0, 100.0, DEFAULT_AGC_LOW, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+   g_object_class_install_property(gobject_class, PROP_AGC_HIGH,
+      g_param_spec_float("agc-high", "AGC high percentile",
+         "GRAY8 output: percentile of the pixels mapped to white",
+         0.0, 100.0, DEFAULT_AGC_HIGH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+   g_object_class_install_property(gobject_class, PROP_AGC_SPEED,
+      g_param_spec_float("agc-speed", "AGC speed",
+         "GRAY8 output: weight of the last frame in the range, 1 for no smoothing",
+         0.0, 1.0, DEFAULT_AGC_SPEED, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+   gst_element_class_set_static_metadata(element_class,
+      "Exosens Y16 converter", "Filter/Converter/Video",
+      "Converts big endian GRAY16 to native GRAY16 in place or to GRAY8 with AGC",
+      "Xenics Exosens");
+   gst_element_class_add_static_pad_template(element_class, &sink_template);
+   gst_element_class_add_static_pad_template(element_class, &src_template);
+
+   trans_class->transform_caps = gst_exo_y16conv_transform_caps;
+
+   filter_class->set_info = gst_exo_y16conv_set_info;
+   filter_class->transform_frame = gst_exo_y16conv_transform_frame;
+   filter_class->transform_frame_ip = gst_exo_y16conv_transform_frame_ip;
+}
+
+static void gst_exo_y16conv_init(GstExoY16Conv *self)
+{
+   self->agc_low = DEFAULT_AGC_LOW;
+   self->agc_high = DEFAULT_AGC_HIGH;
+   self->agc_speed = DEFAULT_AGC_SPEED;
+}
+
+static gboolean plugin_init(GstPlugin *plugin)
+{
+   return gst_element_register(plugin, "exoy16conv", GST_RANK_NONE,
+                               GST_TYPE_EXO_Y16CONV);
+}
+
+#define PACKAGE "exosens"
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, exoy16conv,
+   "Exosens Y16 big endian conversion", plugin_init, "1.0", "Proprietary",
+   PACKAGE, "https://www.exosens.com")
@@ -0,0 +1,103 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * y16-bench - CPU cost of the Y16_BE conversions of libexoy16.
+ *
+ * Reports the time per frame and the share of one core the conversion
+ * takes at the given frame rate, to compare with videoconvert (see
+ * bench-videoconvert.sh for the GStreamer side).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "y16conv.h"
+
+static double now_s(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double elapsed, int frames, size_t npix, int fps)
+{
+   double per_frame = elapsed / frames;
+
+   printf("%-16s %8.3f ms/frame %8.1f Mpix/s %6.1f %% core at %d fps\n",
+          name, per_frame * 1e3, npix / per_frame * 1e-6, per_frame * fps * 100, fps);
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int width = 1280, height = 1024;
+   int frames = 500, fps = 60;
+   struct y16_agc agc;
+   uint16_t *src, *dst;
+   uint8_t *dst8;
+   size_t npix, i;
+   double t;
+   int f, opt;
+
+   while ((opt = getopt(argc, argv, "w:h:n:f:")) != -1) {
+      switch (opt) {
+      case 'w':
+         width = strtoul(optarg, NULL, 0);
+         break;
+      case 'h':
+         height = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         frames = strtol(optarg, NULL, 0);
+         break;
+      case 'f':
+         fps = strtol(optarg, NULL, 0);
+         break;
+      default:
+         fprintf(stderr, "Usage: y16-bench [-w WIDTH] [-h HEIGHT] [-n FRAMES] [-f FPS]\n");
+         return 1;
+      }
+   }
+
+   npix = (size_t)width * height;
+   src = malloc(npix * 2);
+   dst = malloc(npix * 2);
+   dst8 = malloc(npix);
+   if (!src || !dst || !dst8)
+      return 1;
+   for (i = 0; i < npix; i++)
+      src[i] = __builtin_bswap16((uint16_t)(i * 7));
+
+   printf("%ux%u, %d frames\n", width, height, frames);
+
+   t = now_s();
+   for (f = 0; f < frames; f++)
+      y16_swap(src, src, npix);
+   report("swap in place", now_s() - t, frames, npix, fps);
+
+   t = now_s();
+   for (f = 0; f < frames; f++)
+      y16_swap(src, dst, npix);
+   report("swap copy", now_s() - t, frames, npix, fps);
+
+   y16_agc_init(&agc, 1, 99, 0.2f);
+   t = now_s();
+   for (f = 0; f < frames; f++) {
+      for (i = 0; i < height; i++)
+         y16_agc_convert(&agc, src + i * width, dst8 + i * width, width, 1);
+      y16_agc_update(&agc);
+   }
+   report("agc to 8 bits", now_s() - t, frames, npix, fps);
+
+   free(src);
+   free(dst);
+   free(dst8);
+   return 0;
+}
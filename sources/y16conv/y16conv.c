@@ -0,0 +1,403 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#include <endian.h>
+#include <string.h>
+
+#include "y16conv.h"
+
+#ifdef __aarch64__
+   #include <arm_neon.h>
+#endif
+
+/* Every Nth pixel feeds the histogram, plenty for percentiles */
+#define AGC_HIST_STEP 4
+
+void y16_swap(const uint16_t *src, uint16_t *dst, size_t n)
+{
+   size_t i = 0;
+
+#ifdef __aarch64__
+   for (; i + 32 <= n; i += 32) {
+      uint8x16x4_t v = vld1q_u8_x4((const uint8_t *)(src + i));
+
+      v.val[0] = vrev16q_u8(v.val[0]);
+      v.val[1] = vrev16q_u8(v.val[1]);
+      v.val[2] = vrev16q_u8(v.val[2]);
+      v.val[3] = vrev16q_u8(v.val[3]);
+      vst1q_u8_x4((uint8_t *)(dst + i), v);
+   }
+#endif
+   for (; i < n; i++)
+      dst[i] = __builtin_bswap16(src[i]);
+}
+
+static void agc_set_map(struct y16_agc *agc)
+{
+   uint32_t range;
+   unsigned int shift = 16;
+
+   agc->map_lo = (uint16_t)agc->lo;
+   range = agc->hi > agc->lo ? (uint32_t)(agc->hi - agc->lo) : 1;
+   if (range > 65535)
+      range = 65535;
+
+   /* Largest precision keeping the scale in 16 bits */
+   while (shift && (255u << shift) / range > 65535)
+      shift--;
+   agc->map_range = range;
+   agc->map_scale = (255u << shift) / range;
+   agc->map_shift = shift;
+}
+
+void y16_agc_init(struct y16_agc *agc, float low_pct, float high_pct, float speed)
+{
+   memset(agc, 0, sizeof(*agc));
+   agc->low_pct = low_pct;
+   agc->high_pct = high_pct;
+   agc->speed = speed;
+   agc->lo = 0;
+   agc->hi = 65535;
+   agc_set_map(agc);
+}
+
+static inline uint8_t agc_map(const struct y16_agc *agc, uint16_t v)
+{
+   uint32_t d = v > agc->map_lo ? v - agc->map_lo : 0;
+
+   if (d > agc->map_range)
+      d = agc->map_range;
+   d = (d * agc->map_scale) >> agc->map_shift;
+   return d > 255 ? 255 : d;
+}
+
+void y16_agc_convert(struct y16_agc *agc, const uint16_t *src, uint8_t *dst,
+                     size_t n, int big_endian)
+{
+   size_t i = 0;
+
+#ifdef __aarch64__
+   const uint16x8_t lo = vdupq_n_u16(agc->map_lo);
+   const uint16x8_t range = vdupq_n_u16(agc->map_range);
+   const uint16x4_t scale = vdup_n_u16(agc->map_scale);
+   const int32x4_t shift = vdupq_n_s32(-(int32_t)agc->map_shift);
+
+   for (; i + 8 <= n; i += 8) {
+      uint16x8_t v = vld1q_u16(src + i);
+      uint32x4_t l, h;
+
+      if (big_endian)
+         v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+      v = vminq_u16(vqsubq_u16(v, lo), range);
+      l = vshlq_u32(vmull_u16(vget_low_u16(v), scale), shift);
+      h = vshlq_u32(vmull_u16(vget_high_u16(v), scale), shift);
+      vst1_u8(dst + i, vqmovn_u16(vcombine_u16(vqmovn_u32(l), vqmovn_u32(h))));
+   }
+#endif
+   for (; i < n; i++)
+      dst[i] = agc_map(agc, big_endian ? __builtin_bswap16(src[i]) : src[i]);
+
+   for (i = 0; i < n; i += AGC_HIST_STEP) {
+      uint16_t v = big_endian ? __builtin_bswap16(src[i]) : src[i];
+
+      agc->hist[v >> Y16_AGC_HIST_SHIFT]++;
+      agc->hist_count++;
+   }
+}
+
+void y16_agc_update(struct y16_agc *agc)
+{
+   uint32_t low_count, high_count, sum = 0;
+   float lo = -1, hi = -1;
+   unsigned int i;
+
+   if (!agc->hist_count)
+      return;
+
+   low_count = agc->hist_count * (agc->low_pct / 100.0f);
+   high_count = agc->hist_count * (agc->high_pct / 100.0f);
+   for (i = 0; i < Y16_AGC_HIST_BINS; i++) {
+      sum += agc->hist[i];
+      if (lo < 0 && sum > low_count)
+         lo = i << Y16_AGC_HIST_SHIFT;
+      if (hi < 0 && sum >= high_count) {
+         hi = ((i + 1) << Y16_AGC_HIST_SHIFT) - 1;
+         break;
+      }
+   }
+   if (lo < 0)
+      lo = 0;
+   if (hi < 0)
+      hi = 65535;
+
+   agc->lo += agc->speed * (lo - agc->lo);
+   agc->hi += agc->speed * (hi - agc->hi);
+   agc_set_map(agc);
+
+   memset(agc->hist, 0, sizeof(agc->hist));
+   agc->hist_count = 0;
+}
+
+/*
+ * PISP_COMP1: a 64-bit block holds 8 pixels, its low 32 bits the even ones
+ * and its high 32 bits the odd ones. Each 32-bit sub-block is a 2-bit
+ * quantisation mode and 4 quantised values, delta coded in modes 0 to 2.
+ */
+static inline uint32_t comp1_dequantize(uint32_t q, uint32_t qmode)
+{
+   uint32_t v;
+
+   switch (qmode) {
+   case 0:
+      v = q < 320 ? 16 * q : 32 * (q - 160);
+      break;
+   case 1:
+      v = 64 * q;
+      break;
+   case 2:
+      v = 128 * q;
+      break;
+   default:
+      v = q < 94 ? 256 * q : 512 * (q - 47);
+      break;
+   }
+   return v > 0xffff ? 0xffff : v;
+}
+
+static inline void comp1_sub_block(uint32_t w, uint32_t d[4])
+{
+   uint32_t qmode = w & 3;
+   uint32_t q[4];
+   unsigned int i;
+
+   if (qmode < 3) {
+      uint32_t f0 = (w >> 2) & 511;
+      uint32_t f1 = (w >> 11) & 127;
+      uint32_t f2 = (w >> 18) & 127;
+      uint32_t f3 = (w >> 25) & 127;
+      uint32_t p1, p2;
+
+      if (qmode == 2 && f0 >= 384) {
+         q[1] = f0;
+         q[2] = f1 + 384;
+      } else {
+         q[1] = f1 >= 64 ? f0 : f0 + 64 - f1;
+         q[2] = f1 >= 64 ? f0 + f1 - 64 : f0;
+      }
+      p1 = q[1] > 64 ? q[1] - 64 : 0;
+      p2 = q[2] > 64 ? q[2] - 64 : 0;
+      if (qmode == 2) {
+         p1 = p1 < 384 ? p1 : 384;
+         p2 = p2 < 384 ? p2 : 384;
+      }
+      q[0] = p1 + f2;
+      q[3] = p2 + f3;
+   } else {
+      uint32_t pack0 = (w >> 2) & 32767;
+      uint32_t pack1 = (w >> 17) & 32767;
+
+      q[0] = (pack0 & 15) + 16 * ((pack0 >> 8) / 11);
+      q[1] = (pack1 & 15) + 16 * ((pack1 >> 8) / 11);
+      q[2] = (pack0 >> 4) % 176;
+      q[3] = (pack1 >> 4) % 176;
+   }
+
+   for (i = 0; i < 4; i++)
+      d[i] = comp1_dequantize(q[i], qmode);
+}
+
+/* Expansion of the simple (2) and combined (3) modes, then the offset */
+static inline uint16_t comp1_postprocess(uint32_t a, unsigned int mode,
+                                         unsigned int offset)
+{
+   if (mode & 2) {
+      if (mode == 3 && a < 0x4000)
+         a = a >> 2;
+      else if (a < 0x1000)
+         a = a >> 4;
+      else if (a < 0x1800)
+         a = (a - 0x800) >> 3;
+      else if (a < 0x3000)
+         a = (a - 0x1000) >> 2;
+      else if (a < 0x6000)
+         a = (a - 0x2000) >> 1;
+      else if (a < 0xc000)
+         a = a - 0x4000;
+      else
+         a = 2 * (a - 0x8000);
+   }
+   a += offset;
+   return a > 0xffff ? 0xffff : a;
+}
+
+static void comp1_block(const uint8_t *src, uint16_t *dst, unsigned int mode,
+                        unsigned int offset)
+{
+   uint32_t even[4], odd[4];
+   uint64_t w;
+   unsigned int i;
+
+   memcpy(&w, src, sizeof(w));
+   w = le64toh(w);
+   comp1_sub_block(w, even);
+   comp1_sub_block(w >> 32, odd);
+   for (i = 0; i < 4; i++) {
+      dst[2 * i] = comp1_postprocess(even[i], mode, offset);
+      dst[2 * i + 1] = comp1_postprocess(odd[i], mode, offset);
+   }
+}
+
+/* Blocks from @x to the end of the line */
+static void comp1_decode_tail(const uint8_t *src, uint16_t *dst, size_t x,
+                              size_t width, unsigned int mode, unsigned int offset)
+{
+   uint16_t last[Y16_COMP1_BLOCK];
+
+   for (; x + Y16_COMP1_BLOCK <= width; x += Y16_COMP1_BLOCK)
+      comp1_block(src + x, dst + x, mode, offset);
+   if (x < width) {
+      comp1_block(src + x, last, mode, offset);
+      memcpy(dst + x, last, (width - x) * sizeof(*dst));
+   }
+}
+
+void y16_comp1_decode_c(const uint8_t *src, uint16_t *dst, size_t width,
+                        unsigned int mode, unsigned int offset)
+{
+   comp1_decode_tail(src, dst, 0, width, mode, offset);
+}
+
+#ifdef __aarch64__
+static inline uint32x4_t comp1_select(uint32x4_t cond, uint32x4_t a, uint32x4_t b)
+{
+   return vbslq_u32(cond, a, b);
+}
+
+/* comp1_dequantize() of 4 sub-blocks */
+static inline uint32x4_t comp1_dequantize_neon(uint32x4_t q, uint32x4_t is0,
+                                               uint32x4_t is1, uint32x4_t is2)
+{
+   uint32x4_t v0, v3;
+
+   v0 = comp1_select(vcltq_u32(q, vdupq_n_u32(320)), vshlq_n_u32(q, 4),
+                     vshlq_n_u32(vsubq_u32(q, vdupq_n_u32(160)), 5));
+   v3 = comp1_select(vcltq_u32(q, vdupq_n_u32(94)), vshlq_n_u32(q, 8),
+                     vshlq_n_u32(vsubq_u32(q, vdupq_n_u32(47)), 9));
+   v3 = comp1_select(is2, vshlq_n_u32(q, 7), v3);
+   v3 = comp1_select(is1, vshlq_n_u32(q, 6), v3);
+   v3 = comp1_select(is0, v0, v3);
+   return vminq_u32(v3, vdupq_n_u32(0xffff));
+}
+
+/* comp1_sub_block() of 4 sub-blocks, one per lane */
+static inline void comp1_sub_block_neon(uint32x4_t w, uint32x4_t d[4])
+{
+   const uint32x4_t m127 = vdupq_n_u32(127);
+   const uint32x4_t c64 = vdupq_n_u32(64);
+   const uint32x4_t c384 = vdupq_n_u32(384);
+   uint32x4_t qmode = vandq_u32(w, vdupq_n_u32(3));
+   uint32x4_t is0 = vceqq_u32(qmode, vdupq_n_u32(0));
+   uint32x4_t is1 = vceqq_u32(qmode, vdupq_n_u32(1));
+   uint32x4_t is2 = vceqq_u32(qmode, vdupq_n_u32(2));
+   uint32x4_t is3 = vceqq_u32(qmode, vdupq_n_u32(3));
+   uint32x4_t f0, f1, f2, f3, ge64, big2, q1, q2, p1, p2;
+   uint32x4_t pack0, pack1, hi0, hi1, lo0, lo1, div;
+   uint32x4_t q[4];
+   unsigned int i;
+
+   /* Modes 0 to 2 */
+   f0 = vandq_u32(vshrq_n_u32(w, 2), vdupq_n_u32(511));
+   f1 = vandq_u32(vshrq_n_u32(w, 11), m127);
+   f2 = vandq_u32(vshrq_n_u32(w, 18), m127);
+   f3 = vshrq_n_u32(w, 25);
+   ge64 = vcgeq_u32(f1, c64);
+   big2 = vandq_u32(is2, vcgeq_u32(f0, c384));
+   q1 = comp1_select(ge64, f0, vsubq_u32(vaddq_u32(f0, c64), f1));
+   q2 = comp1_select(ge64, vsubq_u32(vaddq_u32(f0, f1), c64), f0);
+   q1 = comp1_select(big2, f0, q1);
+   q2 = comp1_select(big2, vaddq_u32(f1, c384), q2);
+   p1 = vqsubq_u32(q1, c64);
+   p2 = vqsubq_u32(q2, c64);
+   p1 = comp1_select(is2, vminq_u32(p1, c384), p1);
+   p2 = comp1_select(is2, vminq_u32(p2, c384), p2);
+   q[0] = vaddq_u32(p1, f2);
+   q[1] = q1;
+   q[2] = q2;
+   q[3] = vaddq_u32(p2, f3);
+
+   /*
+    * Mode 3: x / 11 for x < 128 is (x * 187) >> 11, x % 176 for x < 2048
+    * is x - 176 * ((x * 745) >> 17)
+    */
+   pack0 = vandq_u32(vshrq_n_u32(w, 2), vdupq_n_u32(32767));
+   pack1 = vshrq_n_u32(w, 17);
+   hi0 = vshrq_n_u32(vmulq_n_u32(vshrq_n_u32(pack0, 8), 187), 11);
+   hi1 = vshrq_n_u32(vmulq_n_u32(vshrq_n_u32(pack1, 8), 187), 11);
+   q[0] = comp1_select(is3, vaddq_u32(vandq_u32(pack0, vdupq_n_u32(15)),
+                                      vshlq_n_u32(hi0, 4)), q[0]);
+   q[1] = comp1_select(is3, vaddq_u32(vandq_u32(pack1, vdupq_n_u32(15)),
+                                      vshlq_n_u32(hi1, 4)), q[1]);
+   lo0 = vshrq_n_u32(pack0, 4);
+   lo1 = vshrq_n_u32(pack1, 4);
+   div = vshrq_n_u32(vmulq_n_u32(lo0, 745), 17);
+   q[2] = comp1_select(is3, vmlsq_n_u32(lo0, div, 176), q[2]);
+   div = vshrq_n_u32(vmulq_n_u32(lo1, 745), 17);
+   q[3] = comp1_select(is3, vmlsq_n_u32(lo1, div, 176), q[3]);
+
+   for (i = 0; i < 4; i++)
+      d[i] = comp1_dequantize_neon(q[i], is0, is1, is2);
+}
+
+/* comp1_postprocess() of 4 values */
+static inline uint32x4_t comp1_postprocess_neon(uint32x4_t a, unsigned int mode,
+                                                uint32x4_t offset)
+{
+   if (mode & 2) {
+      uint32x4_t r;
+
+      r = vshlq_n_u32(vsubq_u32(a, vdupq_n_u32(0x8000)), 1);
+      r = comp1_select(vcltq_u32(a, vdupq_n_u32(0xc000)),
+                       vsubq_u32(a, vdupq_n_u32(0x4000)), r);
+      r = comp1_select(vcltq_u32(a, vdupq_n_u32(0x6000)),
+                       vshrq_n_u32(vsubq_u32(a, vdupq_n_u32(0x2000)), 1), r);
+      r = comp1_select(vcltq_u32(a, vdupq_n_u32(0x3000)),
+                       vshrq_n_u32(vsubq_u32(a, vdupq_n_u32(0x1000)), 2), r);
+      r = comp1_select(vcltq_u32(a, vdupq_n_u32(0x1800)),
+                       vshrq_n_u32(vsubq_u32(a, vdupq_n_u32(0x800)), 3), r);
+      r = comp1_select(vcltq_u32(a, vdupq_n_u32(0x1000)), vshrq_n_u32(a, 4), r);
+      if (mode == 3)
+         r = comp1_select(vcltq_u32(a, vdupq_n_u32(0x4000)), vshrq_n_u32(a, 2), r);
+      a = r;
+   }
+   return vminq_u32(vaddq_u32(a, offset), vdupq_n_u32(0xffff));
+}
+#endif
+
+void y16_comp1_decode(const uint8_t *src, uint16_t *dst, size_t width,
+                      unsigned int mode, unsigned int offset)
+{
+   size_t x = 0;
+
+#ifdef __aarch64__
+   const uint32x4_t off = vdupq_n_u32(offset);
+
+   /* 4 blocks, 32 pixels per iteration */
+   for (; x + 4 * Y16_COMP1_BLOCK <= width; x += 4 * Y16_COMP1_BLOCK) {
+      uint32x4x2_t w = vld2q_u32((const uint32_t *)(src + x));
+      uint32x4_t even[4], odd[4];
+      uint32x4x4_t out;
+      unsigned int i;
+
+      comp1_sub_block_neon(w.val[0], even);
+      comp1_sub_block_neon(w.val[1], odd);
+      /* Lane b of out.val[i]: pixels 2i and 2i + 1 of block b */
+      for (i = 0; i < 4; i++)
+         out.val[i] = vorrq_u32(comp1_postprocess_neon(even[i], mode, off),
+                                vshlq_n_u32(comp1_postprocess_neon(odd[i], mode, off), 16));
+      vst4q_u32((uint32_t *)(dst + x), out);
+   }
+#endif
+   comp1_decode_tail(src, dst, x, width, mode, offset);
+}
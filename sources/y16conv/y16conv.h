@@ -0,0 +1,81 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+#ifndef Y16CONV_H
+#define Y16CONV_H
+
+/*
+ * Y16 big endian to native conversions.
+ *
+ * Unicam on the Pi 4 can't byte-swap RAW16, EngineCore Y16 and Microlynx
+ * Mono16 arrive as V4L2_PIX_FMT_Y16_BE. These helpers swap them in place or
+ * between buffers, and optionally reduce them to 8 bits with an automatic
+ * gain (histogram stretch), NEON accelerated on aarch64.
+ *
+ * Also the decompression of the Pi 5 PISP_COMP1 captures, see below.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Swap @n 16-bit pixels, @src and @dst may be the same buffer */
+void y16_swap(const uint16_t *src, uint16_t *dst, size_t n);
+
+#define Y16_AGC_HIST_SHIFT 6                           /* 1024 bins */
+#define Y16_AGC_HIST_BINS  (65536 >> Y16_AGC_HIST_SHIFT)
+
+/*
+ * 16 to 8-bit automatic gain. Each frame is mapped with the range found in
+ * the previous ones, its histogram being built in the same pass, so the
+ * conversion reads the frame once.
+ */
+struct y16_agc {
+   /* Settings, see y16_agc_init() */
+   float    low_pct;        /* Percentile mapped to 0 */
+   float    high_pct;       /* Percentile mapped to 255 */
+   float    speed;          /* 0..1, weight of the new range per frame */
+   /* State */
+   uint32_t hist[Y16_AGC_HIST_BINS];
+   uint32_t hist_count;
+   float    lo, hi;         /* Current range */
+   /* Mapping used by y16_agc_convert(): (v - lo) * scale >> shift */
+   uint16_t map_lo;
+   uint16_t map_range;
+   uint16_t map_scale;
+   uint16_t map_shift;
+};
+
+void y16_agc_init(struct y16_agc *agc, float low_pct, float high_pct, float speed);
+
+/*
+ * Convert one line of @n pixels to 8 bits, sampling the histogram.
+ * @big_endian: source is Y16_BE (otherwise native)
+ */
+void y16_agc_convert(struct y16_agc *agc, const uint16_t *src, uint8_t *dst,
+                     size_t n, int big_endian);
+
+/* End of frame: update the range from the histogram and reset it */
+void y16_agc_update(struct y16_agc *agc);
+
+/*
+ * PISP_COMP1 decompression (V4L2_PIX_FMT_PISP_COMP1_MONO, "PC1M").
+ *
+ * The Pi 5 CFE can compress Y16 (EngineCore, Dione, Microlynx Mono16) and
+ * Y14 (Microlynx Mono14) to 8 bits per pixel on its CSI2 channels: blocks of
+ * 8 pixels in 64 bits, lossy. @mode and @offset are the compression_mode and
+ * compression_offset parameters of the rp1-cfe module (1 delta, 2 simple,
+ * 3 combined; default 1 and 0).
+ */
+#define Y16_COMP1_BLOCK    8                           /* Pixels per 64-bit block */
+
+/* Decompress one line of @width pixels (@src: (@width + 7) / 8 blocks) */
+void y16_comp1_decode(const uint8_t *src, uint16_t *dst, size_t width,
+                      unsigned int mode, unsigned int offset);
+
+/* Same without NEON, reference for the validation */
+void y16_comp1_decode_c(const uint8_t *src, uint16_t *dst, size_t width,
+                        unsigned int mode, unsigned int offset);
+
+#endif /* Y16CONV_H */
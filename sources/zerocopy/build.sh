@@ -0,0 +1,25 @@
+#!/bin/bash
+
+if [[ x$2 == x ]]
+then
+   # Do it on target
+   if [[ x$1 == "xmake" ]]
+   then
+      make
+   elif [[ x$1 == "xinstall" ]]
+   then
+      sudo make install
+   elif [[ x$1 == "xclean" ]]
+   then
+      make clean
+   fi
+else
+   # Do it on host, userspace tools are only built (installed on target)
+   if [[ x$1 == "xmake" ]]
+   then
+      make CROSS_COMPILE=$CROSS_COMPILE
+   elif [[ x$1 == "xclean" ]]
+   then
+      make clean
+   fi
+fi
@@ -0,0 +1,477 @@
+/*
+ *
+ * Copyright (c) 2026, Xenics Exosens, All Rights Reserved.
+ *
+ */
+
+/*
+ * exo-zerocopy - zero-copy capture check and measurement.
+ *
+ * Captures from a unicam or CFE video node into MMAP buffers exported as
+ * DMABUF (VIDIOC_EXPBUF) and hands those DMABUFs to the V4L2 memory to
+ * memory H.264 encoder (bcm2835-codec, /dev/video11 on the Pi 4) without
+ * the CPU touching the pixels. Without an encoder, or when the encoder
+ * doesn't take the capture format, frames are only dequeued and requeued,
+ * which measures the capture path alone.
+ *
+ * Reports, per run, the capture to encoded frame latency (from the frame
+ * start timestamp of the receiver, CLOCK_MONOTONIC) and the CPU time used.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <linux/videodev2.h>
+
+#define MAX_BUFFERS    16
+#define ENC_BUFFERS    4
+#define ENC_SIZEIMAGE  (1024 * 1024)
+
+struct capture {
+   int      fd;
+   unsigned nbufs;
+   int      dmabuf[MAX_BUFFERS];
+   struct v4l2_pix_format pix;
+};
+
+struct encoder {
+   int      fd;
+   void    *map[ENC_BUFFERS];
+   size_t   len[ENC_BUFFERS];
+};
+
+struct stats {
+   unsigned frames;
+   unsigned dropped;         /* Sequence gaps on the capture side */
+   double   latency_sum_ms;
+   double   latency_max_ms;
+};
+
+static volatile sig_atomic_t quit;
+
+static void on_signal(int sig)
+{
+   (void)sig;
+   quit = 1;
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+   int ret;
+
+   do {
+      ret = ioctl(fd, req, arg);
+   } while (ret < 0 && errno == EINTR);
+   return ret < 0 ? -errno : 0;
+}
+
+static double mono_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static double cpu_s(void)
+{
+   struct rusage ru;
+
+   getrusage(RUSAGE_SELF, &ru);
+   return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+          (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+static const char *fourcc_str(uint32_t f, char *buf)
+{
+   if (f == V4L2_PIX_FMT_Y16_BE)
+      return "Y16_BE";
+   buf[0] = f & 0xff;
+   buf[1] = (f >> 8) & 0xff;
+   buf[2] = (f >> 16) & 0xff;
+   buf[3] = (f >> 24) & 0xff;
+   buf[4] = 0;
+   return buf;
+}
+
+static void account(struct stats *st, const struct v4l2_buffer *buf)
+{
+   double ts = buf->timestamp.tv_sec * 1e3 + buf->timestamp.tv_usec * 1e-3;
+   double latency = mono_ms() - ts;
+
+   st->frames++;
+   st->latency_sum_ms += latency;
+   if (latency > st->latency_max_ms)
+      st->latency_max_ms = latency;
+}
+
+/* ---- Capture ---------------------------------------------------------- */
+
+static int capture_open(struct capture *cap, const char *dev, uint32_t fourcc,
+                        unsigned nbufs)
+{
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_requestbuffers req = {
+      .count = nbufs,
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   unsigned i;
+   int ret;
+
+   cap->fd = open(dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (cap->fd < 0)
+      return -errno;
+
+   ret = xioctl(cap->fd, VIDIOC_G_FMT, &fmt);
+   if (ret)
+      goto err_close;
+   if (fourcc && fmt.fmt.pix.pixelformat != fourcc) {
+      fmt.fmt.pix.pixelformat = fourcc;
+      ret = xioctl(cap->fd, VIDIOC_S_FMT, &fmt);
+      if (ret)
+         goto err_close;
+      if (fmt.fmt.pix.pixelformat != fourcc) {
+         ret = -EINVAL;
+         goto err_close;
+      }
+   }
+   cap->pix = fmt.fmt.pix;
+
+   ret = xioctl(cap->fd, VIDIOC_REQBUFS, &req);
+   if (ret)
+      goto err_close;
+   cap->nbufs = req.count < MAX_BUFFERS ? req.count : MAX_BUFFERS;
+
+   /* Buffers are only ever seen as DMABUFs, never mapped */
+   for (i = 0; i < cap->nbufs; i++) {
+      struct v4l2_exportbuffer exp = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .index = i,
+         .flags = O_RDWR | O_CLOEXEC,
+      };
+
+      ret = xioctl(cap->fd, VIDIOC_EXPBUF, &exp);
+      if (ret)
+         goto err_unexport;
+      cap->dmabuf[i] = exp.fd;
+   }
+   return 0;
+
+err_unexport:
+   while (i--)
+      close(cap->dmabuf[i]);
+   cap->nbufs = 0;
+err_close:
+   close(cap->fd);
+   cap->fd = -1;
+   return ret;
+}
+
+static int capture_queue(struct capture *cap, unsigned index)
+{
+   struct v4l2_buffer buf = {
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+      .index = index,
+   };
+
+   return xioctl(cap->fd, VIDIOC_QBUF, &buf);
+}
+
+/* ---- Encoder ---------------------------------------------------------- */
+
+static int encoder_open(struct encoder *enc, const char *dev, const struct capture *cap)
+{
+   struct v4l2_format out = { .type = V4L2_BUF_TYPE_VIDEO_OUTPUT };
+   struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+   struct v4l2_requestbuffers req_out = {
+      .count = cap->nbufs,
+      .type = V4L2_BUF_TYPE_VIDEO_OUTPUT,
+      .memory = V4L2_MEMORY_DMABUF,
+   };
+   struct v4l2_requestbuffers req_cap = {
+      .count = ENC_BUFFERS,
+      .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+      .memory = V4L2_MEMORY_MMAP,
+   };
+   unsigned i;
+   int ret;
+
+   enc->fd = open(dev, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+   if (enc->fd < 0)
+      return -errno;
+
+   /* The encoder reads the capture buffers as they are, stride included */
+   out.fmt.pix = cap->pix;
+   ret = xioctl(enc->fd, VIDIOC_S_FMT, &out);
+   if (ret)
+      return ret;
+   if (out.fmt.pix.pixelformat != cap->pix.pixelformat ||
+       out.fmt.pix.bytesperline != cap->pix.bytesperline)
+      return -EINVAL;
+
+   fmt.fmt.pix.width = cap->pix.width;
+   fmt.fmt.pix.height = cap->pix.height;
+   fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_H264;
+   fmt.fmt.pix.sizeimage = ENC_SIZEIMAGE;
+   ret = xioctl(enc->fd, VIDIOC_S_FMT, &fmt);
+   if (ret)
+      return ret;
+
+   ret = xioctl(enc->fd, VIDIOC_REQBUFS, &req_out);
+   if (ret)
+      return ret;
+   if (req_out.count < cap->nbufs)
+      return -ENOMEM;
+
+   ret = xioctl(enc->fd, VIDIOC_REQBUFS, &req_cap);
+   if (ret)
+      return ret;
+
+   for (i = 0; i < ENC_BUFFERS && i < req_cap.count; i++) {
+      struct v4l2_buffer buf = {
+         .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+         .memory = V4L2_MEMORY_MMAP,
+         .index = i,
+      };
+
+      ret = xioctl(enc->fd, VIDIOC_QUERYBUF, &buf);
+      if (ret)
+         return ret;
+      enc->map[i] = mmap(NULL, buf.length, PROT_READ, MAP_SHARED, enc->fd, buf.m.offset);
+      if (enc->map[i] == MAP_FAILED)
+         return -errno;
+      enc->len[i] = buf.length;
+      ret = xioctl(enc->fd, VIDIOC_QBUF, &buf);
+      if (ret)
+         return ret;
+   }
+   return 0;
+}
+
+static int stream(int fd, enum v4l2_buf_type type, int on)
+{
+   return xioctl(fd, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type);
+}
+
+/* ---- Main loop -------------------------------------------------------- */
+
+static void usage(void)
+{
+   fprintf(stderr,
+      "Usage: exo-zerocopy [-d VIDEO] [-e ENCODER] [-f FOURCC] [-n NBUFS] [-t SECONDS] [-o FILE]\n"
+      "  -d VIDEO    capture node (default: /dev/video0)\n"
+      "  -e ENCODER  V4L2 M2M H.264 encoder, 'none' to measure capture only\n"
+      "              (default: /dev/video11)\n"
+      "  -f FOURCC   capture pixel format, e.g. UYVY, RGB3, BGR3, Y16_BE (default: current)\n"
+      "  -n NBUFS    capture buffers (default: 6)\n"
+      "  -t SECONDS  run time (default: 10)\n"
+      "  -o FILE     write the H.264 elementary stream\n");
+}
+
+int main(int argc, char **argv)
+{
+   const char *video = "/dev/video0";
+   const char *encdev = "/dev/video11";
+   const char *output = NULL;
+   struct capture cap = { .fd = -1 };
+   struct encoder enc = { .fd = -1 };
+   struct stats st = { 0 };
+   uint32_t fourcc = 0;
+   unsigned nbufs = 6;
+   int seconds = 10;
+   int out_fd = -1;
+   int have_seq = 0;
+   uint32_t last_seq = 0;
+   double t0, cpu0, elapsed;
+   char fcc[5];
+   unsigned i;
+   int ret;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "d:e:f:n:t:o:h")) != -1) {
+      switch (opt) {
+      case 'd':
+         video = optarg;
+         break;
+      case 'e':
+         encdev = strcmp(optarg, "none") ? optarg : NULL;
+         break;
+      case 'f':
+         /* Big endian formats as printed by v4l2-ctl, e.g. "Y16 -BE" */
+         if (!strcmp(optarg, "Y16 -BE") || !strcmp(optarg, "Y16_BE")) {
+            fourcc = V4L2_PIX_FMT_Y16_BE;
+            break;
+         }
+         if (strlen(optarg) > 4) {
+            usage();
+            return 1;
+         }
+         memcpy(fcc, "    ", 4);
+         memcpy(fcc, optarg, strlen(optarg));
+         fourcc = v4l2_fourcc(fcc[0], fcc[1], fcc[2], fcc[3]);
+         break;
+      case 'n':
+         nbufs = strtoul(optarg, NULL, 0);
+         break;
+      case 't':
+         seconds = strtol(optarg, NULL, 0);
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   ret = capture_open(&cap, video, fourcc, nbufs);
+   if (ret) {
+      fprintf(stderr, "exo-zerocopy: %s: %s\n", video, strerror(-ret));
+      return 1;
+   }
+
+   if (encdev) {
+      ret = encoder_open(&enc, encdev, &cap);
+      if (ret) {
+         fprintf(stderr, "exo-zerocopy: %s: %s %ux%u not encodable (%s), capture only\n",
+                 encdev, fourcc_str(cap.pix.pixelformat, fcc), cap.pix.width,
+                 cap.pix.height, strerror(-ret));
+         if (enc.fd >= 0)
+            close(enc.fd);
+         enc.fd = -1;
+      }
+   }
+
+   if (output && enc.fd >= 0) {
+      out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (out_fd < 0) {
+         perror(output);
+         return 1;
+      }
+   }
+
+   signal(SIGINT, on_signal);
+   signal(SIGTERM, on_signal);
+
+   for (i = 0; i < cap.nbufs; i++)
+      capture_queue(&cap, i);
+   if (enc.fd >= 0 &&
+       (stream(enc.fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, 1) ||
+        stream(enc.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1))) {
+      fprintf(stderr, "exo-zerocopy: encoder stream on failed\n");
+      return 1;
+   }
+   ret = stream(cap.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 1);
+   if (ret) {
+      fprintf(stderr, "exo-zerocopy: %s: stream on: %s\n", video, strerror(-ret));
+      return 1;
+   }
+
+   t0 = mono_ms();
+   cpu0 = cpu_s();
+   while (!quit && mono_ms() - t0 < seconds * 1e3) {
+      struct pollfd pfd[2] = {
+         { .fd = cap.fd, .events = POLLIN },
+         { .fd = enc.fd, .events = POLLIN | POLLOUT },
+      };
+      struct v4l2_buffer buf;
+
+      if (poll(pfd, enc.fd >= 0 ? 2 : 1, 1000) <= 0)
+         continue;
+
+      if (pfd[0].revents & POLLIN) {
+         memset(&buf, 0, sizeof(buf));
+         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+         buf.memory = V4L2_MEMORY_MMAP;
+         if (!xioctl(cap.fd, VIDIOC_DQBUF, &buf)) {
+            if (have_seq && buf.sequence != last_seq + 1)
+               st.dropped += buf.sequence - last_seq - 1;
+            have_seq = 1;
+            last_seq = buf.sequence;
+
+            if (enc.fd >= 0) {
+               /* Same DMABUF, same index: the capture timestamp is copied */
+               struct v4l2_buffer out = {
+                  .type = V4L2_BUF_TYPE_VIDEO_OUTPUT,
+                  .memory = V4L2_MEMORY_DMABUF,
+                  .index = buf.index,
+                  .bytesused = buf.bytesused,
+                  .length = cap.pix.sizeimage,
+                  .timestamp = buf.timestamp,
+                  .m.fd = cap.dmabuf[buf.index],
+               };
+
+               if (xioctl(enc.fd, VIDIOC_QBUF, &out))
+                  capture_queue(&cap, buf.index);
+            } else {
+               account(&st, &buf);
+               capture_queue(&cap, buf.index);
+            }
+         }
+      }
+
+      if (enc.fd < 0)
+         continue;
+
+      /* Encoder done reading a capture buffer: give it back to the receiver */
+      if (pfd[1].revents & POLLOUT) {
+         memset(&buf, 0, sizeof(buf));
+         buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+         buf.memory = V4L2_MEMORY_DMABUF;
+         if (!xioctl(enc.fd, VIDIOC_DQBUF, &buf))
+            capture_queue(&cap, buf.index);
+      }
+
+      if (pfd[1].revents & POLLIN) {
+         memset(&buf, 0, sizeof(buf));
+         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+         buf.memory = V4L2_MEMORY_MMAP;
+         if (!xioctl(enc.fd, VIDIOC_DQBUF, &buf)) {
+            account(&st, &buf);
+            if (out_fd >= 0 && write(out_fd, enc.map[buf.index], buf.bytesused) < 0)
+               perror("exo-zerocopy: write");
+            xioctl(enc.fd, VIDIOC_QBUF, &buf);
+         }
+      }
+   }
+   elapsed = (mono_ms() - t0) * 1e-3;
+
+   stream(cap.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+   if (enc.fd >= 0) {
+      stream(enc.fd, V4L2_BUF_TYPE_VIDEO_OUTPUT, 0);
+      stream(enc.fd, V4L2_BUF_TYPE_VIDEO_CAPTURE, 0);
+   }
+
+   /* One line per run, collected by zerocopy-report.sh */
+   printf("%s %ux%u %s frames %u fps %.1f dropped %u latency avg %.2f max %.2f ms cpu %.1f %%\n",
+          fourcc_str(cap.pix.pixelformat, fcc), cap.pix.width, cap.pix.height,
+          enc.fd >= 0 ? "h264" : "capture", st.frames, st.frames / elapsed, st.dropped,
+          st.frames ? st.latency_sum_ms / st.frames : 0, st.latency_max_ms,
+          (cpu_s() - cpu0) / elapsed * 100);
+
+   for (i = 0; i < ENC_BUFFERS; i++)
+      if (enc.map[i] && enc.map[i] != MAP_FAILED)
+         munmap(enc.map[i], enc.len[i]);
+   for (i = 0; i < cap.nbufs; i++)
+      close(cap.dmabuf[i]);
+   if (enc.fd >= 0)
+      close(enc.fd);
+   close(cap.fd);
+   if (out_fd >= 0)
+      close(out_fd);
+   return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Zero-copy capture report: latency and CPU usage per capture format.
+#
+# Usage: zerocopy-report.sh [VIDEO] [ENCODER] [SECONDS] [FORMATS...]
+#   VIDEO    capture node (default: /dev/video0)
+#   ENCODER  V4L2 M2M H.264 encoder, 'none' on the Pi 5 (default: /dev/video11)
+#   FORMATS  default: UYVY RGB3 BGR3 "Y16 -BE" (formats the sensor can't
+#            produce fail and are reported as such)
+#
+# On the Pi 5 the CFE pipeline must be configured first
+# (/etc/init.d/eg-media-configure-rp1-cfe), VIDEO being the rp1-cfe-csi2_ch0
+# node.
+
+VIDEO=${1:-/dev/video0}
+ENCODER=${2:-/dev/video11}
+SECONDS_RUN=${3:-10}
+shift $(( $# < 3 ? $# : 3 ))
+FORMATS=("$@")
+if [[ ${#FORMATS[@]} -eq 0 ]]
+then
+   FORMATS=(UYVY RGB3 BGR3 "Y16 -BE")
+fi
+
+[[ -e $ENCODER ]] || ENCODER=none
+
+for f in "${FORMATS[@]}"
+do
+   line=$(exo-zerocopy -d $VIDEO -e $ENCODER -f "$f" -t $SECONDS_RUN 2>&1 | tail -1)
+   echo "$f: $line"
+done